@@ -0,0 +1,282 @@
+#include "Benchmarks.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Scene.h"
+#include "TextureCompression.h"
+
+struct BenchmarkObject {
+	glm::vec3 position;
+	glm::vec3 rotationAxis;
+	float angle;
+	float scale;
+	glm::vec4 localSphere;
+	uint32_t meshIndex;
+};
+
+struct BenchmarkOutput {
+	glm::mat4 model;
+	glm::vec4 worldSphere;
+	uint64_t sortKey;
+};
+
+// the same work the renderer does per object each frame
+static void updateObjects(const std::vector<BenchmarkObject>& objects, std::vector<BenchmarkOutput>& outputs, const glm::mat4& view,
+	float time, uint32_t start, uint32_t end)
+{
+	for (uint32_t i = start; i < end; i++)
+	{
+		const BenchmarkObject& object = objects[i];
+
+		glm::mat4 model = glm::translate(glm::mat4(1.f), object.position);
+		model = glm::rotate(model, object.angle + time, object.rotationAxis);
+		model = glm::scale(model, glm::vec3(object.scale));
+
+		glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(object.localSphere), 1.f));
+		float radius = object.localSphere.w * object.scale;
+
+		// mesh in the high bits, then front to back by view depth
+		float viewDepth = glm::clamp(-(view * glm::vec4(centre, 1.f)).z / 1000.f, 0.f, 1.f);
+		uint32_t depthKey = static_cast<uint32_t>(viewDepth * 4294967295.0);
+
+		outputs[i].model = model;
+		outputs[i].worldSphere = glm::vec4(centre, radius);
+		outputs[i].sortKey = (static_cast<uint64_t>(object.meshIndex) << 32) | depthKey;
+	}
+}
+
+void runJobSystemBenchmark(uint32_t maxThreads, uint32_t objectCount)
+{
+	const uint32_t iterations = 20;
+
+	if (maxThreads == 0)
+	{
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// fixed seed so every run measures the same scene
+	std::vector<BenchmarkObject> objects(objectCount);
+	uint32_t seed = 12345;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / 16777216.f;
+	};
+	for (BenchmarkObject& object : objects)
+	{
+		object.position = glm::vec3(random(), random(), random()) * 500.f - 250.f;
+		object.rotationAxis = glm::normalize(glm::vec3(random(), random(), random()) + 0.01f);
+		object.angle = random() * 6.28f;
+		object.scale = 0.5f + random();
+		object.localSphere = glm::vec4(0.f, 0.f, 0.f, 1.f);
+		object.meshIndex = static_cast<uint32_t>(random() * 64.f);
+	}
+
+	std::vector<BenchmarkOutput> outputs(objectCount);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 300.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+
+	printf("Job system benchmark: %u objects, %u iterations\n", objectCount, iterations);
+	printf("%8s %12s %10s %11s\n", "threads", "ms/update", "speedup", "efficiency");
+
+	double singleThreadMs = 0.0;
+	for (uint32_t threads = 1; threads <= maxThreads; threads++)
+	{
+		JobSystem jobSystem;
+		jobSystem.init(threads);
+
+		// warm up, so thread start up and first touch page faults aren't measured
+		jobSystem.parallelFor(objectCount, 0, [&](uint32_t start, uint32_t end) {
+			updateObjects(objects, outputs, view, 0.f, start, end);
+		});
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			float time = static_cast<float>(i) * 0.016f;
+			jobSystem.parallelFor(objectCount, 0, [&](uint32_t start, uint32_t end) {
+				updateObjects(objects, outputs, view, time, start, end);
+			});
+		}
+		auto finish = std::chrono::high_resolution_clock::now();
+
+		jobSystem.shutdown();
+
+		double ms = std::chrono::duration<double, std::milli>(finish - begin).count() / iterations;
+		if (threads == 1)
+		{
+			singleThreadMs = ms;
+		}
+
+		double speedup = singleThreadMs / ms;
+		printf("%8u %12.3f %9.2fx %10.0f%%\n", threads, ms, speedup, 100.0 * speedup / threads);
+	}
+}
+
+void runSceneBenchmark(uint32_t nodeCount)
+{
+	const uint32_t iterations = 20;
+	const uint32_t nodesPerRoot = 16;
+
+	JobSystem jobSystem;
+	jobSystem.init();
+
+	// shallow hierarchies, like props parented to a moving object: a root, children, and one grandchild each
+	Scene scene;
+	std::vector<uint32_t> roots;
+	uint32_t seed = 12345;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<float>(seed >> 8) / 16777216.f;
+	};
+	while (scene.getNodeCount() < nodeCount)
+	{
+		uint32_t root = scene.addNode(SCENE_NO_PARENT, glm::vec3(random(), random(), random()) * 500.f - 250.f,
+			glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f), 0, glm::vec4(0.f, 0.f, 0.f, 1.f));
+		roots.push_back(root);
+
+		for (uint32_t i = 0; i < nodesPerRoot && scene.getNodeCount() + 1 < nodeCount; i += 2)
+		{
+			uint32_t child = scene.addNode(root, glm::vec3(random(), random(), random()) * 4.f, glm::quat(1.f, 0.f, 0.f, 0.f),
+				glm::vec3(0.5f), 0, glm::vec4(0.f, 0.f, 0.f, 1.f));
+			scene.addNode(child, glm::vec3(0.f, 1.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(0.5f), 0,
+				glm::vec4(0.f, 0.f, 0.f, 1.f));
+		}
+	}
+	scene.updateTransforms(jobSystem);
+
+	printf("Scene benchmark: %u nodes, %u threads\n", scene.getNodeCount(), jobSystem.getThreadCount());
+
+	// worst case: every root moves, so every node recomputes
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		glm::quat rotation = glm::angleAxis(static_cast<float>(i) * 0.01f, glm::vec3(0.f, 1.f, 0.f));
+		for (const uint32_t root : roots)
+		{
+			scene.setLocalRotation(root, rotation);
+		}
+		scene.updateTransforms(jobSystem);
+	}
+	auto finish = std::chrono::high_resolution_clock::now();
+	printf("all dirty: %.3f ms/update\n", std::chrono::duration<double, std::milli>(finish - begin).count() / iterations);
+
+	// typical case: a few percent of the roots move
+	begin = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		glm::quat rotation = glm::angleAxis(static_cast<float>(i) * 0.01f, glm::vec3(0.f, 1.f, 0.f));
+		for (size_t j = i; j < roots.size(); j += 32)
+		{
+			scene.setLocalRotation(roots[j], rotation);
+		}
+		scene.updateTransforms(jobSystem);
+	}
+	finish = std::chrono::high_resolution_clock::now();
+	printf("1/32 dirty: %.3f ms/update\n", std::chrono::duration<double, std::milli>(finish - begin).count() / iterations);
+
+	jobSystem.shutdown();
+}
+
+void runTextureCompressionBenchmark(uint32_t size, uint32_t textureCount)
+{
+	// smooth gradients with noise, so blocks aren't flat and the endpoint fit does real work
+	std::vector<std::vector<TextureLevel>> sources(textureCount);
+	std::vector<VkFormat> formats(textureCount);
+	uint32_t seed = 12345;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 24;
+	};
+	for (uint32_t i = 0; i < textureCount; i++)
+	{
+		bool alpha = i % 2 == 1;
+		TextureLevel level = {};
+		level.width = size;
+		level.height = size;
+		level.data.resize(static_cast<size_t>(size) * size * 4);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint8_t* pixel = &level.data[(static_cast<size_t>(y) * size + x) * 4];
+				pixel[0] = static_cast<uint8_t>((x * 255 / size + random() / 8) & 255);
+				pixel[1] = static_cast<uint8_t>((y * 255 / size + random() / 8) & 255);
+				pixel[2] = static_cast<uint8_t>(((x + y) * 127 / size + i * 32) & 255);
+				pixel[3] = alpha ? static_cast<uint8_t>((x ^ y) & 255) : 255;
+			}
+		}
+		sources[i].push_back(std::move(level));
+		generateMipChain(sources[i]);
+		formats[i] = alpha ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	}
+
+	size_t sourceBytes = 0;
+	size_t pixelCount = 0;
+	for (const std::vector<TextureLevel>& levels : sources)
+	{
+		for (const TextureLevel& level : levels)
+		{
+			sourceBytes += level.data.size();
+			pixelCount += static_cast<size_t>(level.width) * level.height;
+		}
+	}
+
+	printf("Texture compression benchmark: %u %ux%u mip chains, %.1f MB of RGBA8\n", textureCount, size, size,
+		sourceBytes / (1024.0 * 1024.0));
+	printf("%8s %12s %10s %12s %9s\n", "threads", "ms", "MB/s", "Mpixels/s", "speedup");
+
+	uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> threadCounts = { 1 };
+	if (maxThreads > 1)
+	{
+		threadCounts.push_back(maxThreads);
+	}
+
+	double singleThreadMs = 0.0;
+	size_t compressedBytes = 0;
+	for (const uint32_t threads : threadCounts)
+	{
+		JobSystem jobSystem;
+		jobSystem.init(threads);
+
+		// a copy per run, the compression replaces the levels
+		std::vector<std::vector<TextureLevel>> chains = sources;
+
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < textureCount; i++)
+		{
+			compressMipChain(jobSystem, formats[i], chains[i]);
+		}
+		auto finish = std::chrono::high_resolution_clock::now();
+
+		jobSystem.shutdown();
+
+		compressedBytes = 0;
+		for (const std::vector<TextureLevel>& levels : chains)
+		{
+			for (const TextureLevel& level : levels)
+			{
+				compressedBytes += level.data.size();
+			}
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(finish - begin).count();
+		if (threads == 1)
+		{
+			singleThreadMs = ms;
+		}
+		printf("%8u %12.1f %10.0f %12.1f %8.2fx\n", threads, ms, sourceBytes / (1024.0 * 1024.0) / (ms / 1000.0),
+			pixelCount / 1000000.0 / (ms / 1000.0), singleThreadMs / ms);
+	}
+
+	printf("%.1f MB compressed to %.1f MB, %.1f MB saved (%.1f:1)\n", sourceBytes / (1024.0 * 1024.0),
+		compressedBytes / (1024.0 * 1024.0), (sourceBytes - compressedBytes) / (1024.0 * 1024.0),
+		static_cast<double>(sourceBytes) / compressedBytes);
+}
\ No newline at end of file
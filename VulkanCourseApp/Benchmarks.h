@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// Standalone measurements that don't need a window or a device, run from the command line (see main.cpp)
+
+// times a scene update (transforms, bounds and sort keys) on 1 to maxThreads threads, 0 uses every hardware thread
+void runJobSystemBenchmark(uint32_t maxThreads = 0, uint32_t objectCount = 1000000);
+
+// times hierarchical transform updates of a nodeCount node scene on every hardware thread
+void runSceneBenchmark(uint32_t nodeCount = 1000000);
+
+// times block compression of textureCount size x size RGBA8 mip chains (half with alpha, BC3, half opaque, BC1) on one
+// thread and on every hardware thread
+void runTextureCompressionBenchmark(uint32_t size = 2048, uint32_t textureCount = 8);
\ No newline at end of file
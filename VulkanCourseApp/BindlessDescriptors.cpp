@@ -0,0 +1,209 @@
+#include "BindlessDescriptors.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+BindlessDescriptors::BindlessDescriptors()
+{
+}
+
+BindlessDescriptors::~BindlessDescriptors()
+{
+}
+
+void BindlessDescriptors::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+{
+	this->logicalDevice = logicalDevice;
+
+	// clamp the array sizes to what the device allows for update-after-bind descriptors
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties = {};
+	vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &vulkan12Properties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	storageBufferSlots.capacity = std::min({ MAX_BINDLESS_STORAGE_BUFFERS,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+	sampledImageSlots.capacity = std::min({ MAX_BINDLESS_SAMPLED_IMAGES,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers });
+	storageImageSlots.capacity = std::min({ MAX_BINDLESS_STORAGE_IMAGES,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageImages,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageImages });
+
+	std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings = {};
+	layoutBindings[0].binding = BINDLESS_STORAGE_BUFFER_BINDING;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[0].descriptorCount = storageBufferSlots.capacity;
+	layoutBindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	layoutBindings[0].pImmutableSamplers = nullptr;
+
+	layoutBindings[1].binding = BINDLESS_SAMPLED_IMAGE_BINDING;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layoutBindings[1].descriptorCount = sampledImageSlots.capacity;
+	layoutBindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+	layoutBindings[1].pImmutableSamplers = nullptr;
+
+	layoutBindings[2].binding = BINDLESS_STORAGE_IMAGE_BINDING;
+	layoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	layoutBindings[2].descriptorCount = storageImageSlots.capacity;
+	layoutBindings[2].stageFlags = VK_SHADER_STAGE_ALL;
+	layoutBindings[2].pImmutableSamplers = nullptr;
+
+	// partially bound: unregistered slots are never touched, so they don't need valid descriptors
+	// update after bind / unused while pending: new resources can be registered while frames are in flight
+	VkDescriptorBindingFlags bindingFlag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::array<VkDescriptorBindingFlags, 3> bindingFlags = { bindingFlag, bindingFlag, bindingFlag };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+	bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+	layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	layoutCreateInfo.pBindings = layoutBindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(logicalDevice, &layoutCreateInfo, nullptr, &layout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = storageBufferSlots.capacity;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = sampledImageSlots.capacity;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[2].descriptorCount = storageImageSlots.capacity;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(logicalDevice, &poolCreateInfo, nullptr, &pool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = pool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	result = vkAllocateDescriptorSets(logicalDevice, &setAllocInfo, &set);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate bindless descriptor set!");
+	}
+}
+
+void BindlessDescriptors::destroy()
+{
+	vkDestroyDescriptorPool(logicalDevice, pool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, layout, nullptr);
+}
+
+uint32_t BindlessDescriptors::registerStorageBuffer(VkBuffer buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t index = allocateSlot(storageBufferSlots, "storage buffer");
+	writeDescriptor(BINDLESS_STORAGE_BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessDescriptors::registerSampledImage(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = imageLayout;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t index = allocateSlot(sampledImageSlots, "sampled image");
+	writeDescriptor(BINDLESS_SAMPLED_IMAGE_BINDING, index, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &imageInfo);
+	return index;
+}
+
+uint32_t BindlessDescriptors::registerStorageImage(VkImageView imageView)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = imageView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t index = allocateSlot(storageImageSlots, "storage image");
+	writeDescriptor(BINDLESS_STORAGE_IMAGE_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, nullptr, &imageInfo);
+	return index;
+}
+
+void BindlessDescriptors::releaseStorageBuffer(uint32_t index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	storageBufferSlots.freed.push_back(index);
+}
+
+void BindlessDescriptors::releaseSampledImage(uint32_t index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	sampledImageSlots.freed.push_back(index);
+}
+
+void BindlessDescriptors::releaseStorageImage(uint32_t index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	storageImageSlots.freed.push_back(index);
+}
+
+uint32_t BindlessDescriptors::allocateSlot(Slots& slots, const char* kind)
+{
+	if (!slots.freed.empty())
+	{
+		uint32_t index = slots.freed.back();
+		slots.freed.pop_back();
+		return index;
+	}
+
+	if (slots.next >= slots.capacity)
+	{
+		throw std::runtime_error(std::string("Out of bindless ") + kind + " descriptors!");
+	}
+	return slots.next++;
+}
+
+void BindlessDescriptors::writeDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo,
+	const VkDescriptorImageInfo* imageInfo)
+{
+	VkWriteDescriptorSet setWrite = {};
+	setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrite.dstSet = set;
+	setWrite.dstBinding = binding;
+	setWrite.dstArrayElement = index;
+	setWrite.descriptorType = type;
+	setWrite.descriptorCount = 1;
+	setWrite.pBufferInfo = bufferInfo;
+	setWrite.pImageInfo = imageInfo;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &setWrite, 0, nullptr);
+}
\ No newline at end of file
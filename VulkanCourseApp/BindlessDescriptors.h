@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// binding numbers of the bindless set, must match the shaders
+const uint32_t BINDLESS_STORAGE_BUFFER_BINDING = 0;
+const uint32_t BINDLESS_SAMPLED_IMAGE_BINDING = 1;
+const uint32_t BINDLESS_STORAGE_IMAGE_BINDING = 2;
+
+const uint32_t MAX_BINDLESS_STORAGE_BUFFERS = 16384;
+const uint32_t MAX_BINDLESS_SAMPLED_IMAGES = 16384;
+const uint32_t MAX_BINDLESS_STORAGE_IMAGES = 256;
+
+// A single descriptor set holding large, partially bound, update-after-bind arrays of every buffer and image the renderer
+// uses. Resources are registered once and referenced by index (through push constants or object data), so a frame binds
+// this set once and never allocates descriptors per draw
+class BindlessDescriptors
+{
+public:
+	BindlessDescriptors();
+	~BindlessDescriptors();
+
+	void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+	void destroy();
+
+	uint32_t registerStorageBuffer(VkBuffer buffer);
+	uint32_t registerSampledImage(VkImageView imageView, VkSampler sampler, VkImageLayout imageLayout);
+	uint32_t registerStorageImage(VkImageView imageView);
+
+	// the slot can be reused as soon as no pending command buffer still reads it
+	void releaseStorageBuffer(uint32_t index);
+	void releaseSampledImage(uint32_t index);
+	void releaseStorageImage(uint32_t index);
+
+	VkDescriptorSetLayout getLayout() const { return layout; }
+	VkDescriptorSet getSet() const { return set; }
+
+private:
+	struct Slots {
+		uint32_t capacity = 0;
+		uint32_t next = 0;
+		std::vector<uint32_t> freed;
+	};
+
+	VkDevice logicalDevice;
+
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+
+	Slots storageBufferSlots;
+	Slots sampledImageSlots;
+	Slots storageImageSlots;
+
+	std::mutex mutex;		// registration can happen from loader threads, and updates to the set must be synchronised
+
+	uint32_t allocateSlot(Slots& slots, const char* kind);
+	void writeDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo,
+		const VkDescriptorImageInfo* imageInfo);
+};
@@ -0,0 +1,85 @@
+#include "DeletionQueue.h"
+
+#include "Profiler.h"
+
+DeletionQueue::DeletionQueue()
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+}
+
+void DeletionQueue::create(const std::vector<QueueTimeline*>& timelines)
+{
+	this->timelines = timelines;
+}
+
+void DeletionQueue::destroy()
+{
+	std::deque<Entry> remaining;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		remaining.swap(entries);
+	}
+
+	for (Entry& entry : remaining)
+	{
+		entry.destroy();
+	}
+}
+
+void DeletionQueue::push(std::function<void()> destroy)
+{
+	Entry entry = {};
+	entry.timelineValues.resize(timelines.size());
+	entry.destroy = std::move(destroy);
+
+	// values are read under the lock, so a later entry never has lower values than one in front of it
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < timelines.size(); i++)
+	{
+		entry.timelineValues[i] = timelines[i]->getLastSubmittedValue();
+	}
+	entries.push_back(std::move(entry));
+}
+
+uint32_t DeletionQueue::collect()
+{
+	PROFILE_FUNCTION();
+
+	// destructions run outside the lock, so they can queue further destructions
+	std::vector<std::function<void()>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!entries.empty() && isComplete(entries.front()))
+		{
+			ready.push_back(std::move(entries.front().destroy));
+			entries.pop_front();
+		}
+	}
+
+	for (const std::function<void()>& destroy : ready)
+	{
+		destroy();
+	}
+	return static_cast<uint32_t>(ready.size());
+}
+
+size_t DeletionQueue::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+bool DeletionQueue::isComplete(const Entry& entry)
+{
+	for (size_t i = 0; i < timelines.size(); i++)
+	{
+		if (!timelines[i]->isComplete(entry.timelineValues[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
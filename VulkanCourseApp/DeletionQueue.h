@@ -0,0 +1,45 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "QueueTimeline.h"
+
+// Destroys resources once the GPU has finished with them, without waiting for it. Each destruction is tagged with the
+// values the timelines have been submitted up to, so it runs once every submission that could still use the resource has
+// finished. Entries are tagged in order, so they're freed in batches from the front, whenever the frame collects them
+class DeletionQueue
+{
+public:
+	DeletionQueue();
+	~DeletionQueue();
+
+	// timelines whose submissions can use the resources, e.g. the graphics and the async compute queue
+	void create(const std::vector<QueueTimeline*>& timelines);
+	// runs everything still queued, call once the device is idle
+	void destroy();
+
+	// destroy runs after everything submitted so far finishes. The resource mustn't be used by anything recorded or
+	// submitted after this. Thread safe
+	void push(std::function<void()> destroy);
+
+	// runs the destructions whose submissions have finished, never blocks. Returns how many ran
+	uint32_t collect();
+
+	size_t getPendingCount();
+
+private:
+	struct Entry {
+		std::vector<uint64_t> timelineValues;		// one per timeline
+		std::function<void()> destroy;
+	};
+
+	std::vector<QueueTimeline*> timelines;
+
+	std::mutex mutex;
+	std::deque<Entry> entries;		// oldest first
+
+	bool isComplete(const Entry& entry);
+};
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "DeviceCapabilities.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+bool DeviceCapabilities::hasRequiredFeatures() const
+{
+	return multiDrawIndirect && drawIndirectFirstInstance && drawIndirectCount && timelineSemaphore && descriptorIndexing &&
+		dynamicRendering && synchronization2 && multiview;
+}
+
+uint32_t DeviceCapabilities::getOptionalFeatureCount() const
+{
+	bool optionalFeatures[] = {
+		memoryBudget, samplerAnisotropy, textureCompressionBC, bufferDeviceAddress, shaderDrawParameters, pipelineStatisticsQuery
+	};
+	return static_cast<uint32_t>(std::count(std::begin(optionalFeatures), std::end(optionalFeatures), true));
+}
+
+DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice physicalDevice)
+{
+	DeviceCapabilities capabilities;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	capabilities.name = properties.deviceName;
+	capabilities.type = properties.deviceType;
+	capabilities.vendorId = properties.vendorID;
+	capabilities.deviceId = properties.deviceID;
+	capabilities.apiVersion = properties.apiVersion;
+	capabilities.timestampPeriod = properties.limits.timestampPeriod;
+
+	VkPhysicalDeviceIDProperties idProperties = {};
+	idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &idProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	memcpy(capabilities.uuid, idProperties.deviceUUID, VK_UUID_SIZE);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0)
+		{
+			capabilities.deviceLocalMemory = std::max(capabilities.deviceLocalMemory, memoryProperties.memoryHeaps[i].size);
+		}
+	}
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	bool foundGraphics = false;
+	for (uint32_t i = 0; i < queueFamilyCount; i++)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (queueFamilies[i].queueCount == 0)
+		{
+			continue;
+		}
+
+		if ((flags & VK_QUEUE_GRAPHICS_BIT) != 0 && !foundGraphics)
+		{
+			capabilities.timestampValidBits = queueFamilies[i].timestampValidBits;
+			foundGraphics = true;
+		}
+		if ((flags & VK_QUEUE_COMPUTE_BIT) != 0 && (flags & VK_QUEUE_GRAPHICS_BIT) == 0 && capabilities.asyncComputeFamily < 0)
+		{
+			capabilities.asyncComputeFamily = static_cast<int>(i);
+			capabilities.asyncComputeTimestampValidBits = queueFamilies[i].timestampValidBits;
+		}
+		if ((flags & VK_QUEUE_TRANSFER_BIT) != 0 && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 &&
+			capabilities.transferFamily < 0)
+		{
+			capabilities.transferFamily = static_cast<int>(i);
+		}
+	}
+
+	// features
+	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.pNext = &vulkan13Features;
+
+	VkPhysicalDeviceVulkan11Features vulkan11Features = {};
+	vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+	vulkan11Features.pNext = &vulkan12Features;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan11Features;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	capabilities.multiDrawIndirect = features.features.multiDrawIndirect == VK_TRUE;
+	capabilities.drawIndirectFirstInstance = features.features.drawIndirectFirstInstance == VK_TRUE;
+	capabilities.drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+	capabilities.timelineSemaphore = vulkan12Features.timelineSemaphore == VK_TRUE;
+	capabilities.descriptorIndexing = vulkan12Features.descriptorIndexing && vulkan12Features.runtimeDescriptorArray &&
+		vulkan12Features.descriptorBindingPartiallyBound && vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+		vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind && vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+		vulkan12Features.descriptorBindingStorageImageUpdateAfterBind && vulkan12Features.shaderStorageBufferArrayNonUniformIndexing &&
+		vulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+	capabilities.dynamicRendering = vulkan13Features.dynamicRendering == VK_TRUE;
+	capabilities.synchronization2 = vulkan13Features.synchronization2 == VK_TRUE;
+
+	capabilities.samplerAnisotropy = features.features.samplerAnisotropy == VK_TRUE;
+	capabilities.textureCompressionBC = features.features.textureCompressionBC == VK_TRUE;
+	capabilities.pipelineStatisticsQuery = features.features.pipelineStatisticsQuery == VK_TRUE;
+	capabilities.bufferDeviceAddress = vulkan12Features.bufferDeviceAddress == VK_TRUE;
+	capabilities.multiview = vulkan11Features.multiview == VK_TRUE;
+	capabilities.shaderDrawParameters = vulkan11Features.shaderDrawParameters == VK_TRUE;
+
+	// extensions
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	for (const VkExtensionProperties& extension : extensions)
+	{
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+		{
+			capabilities.memoryBudget = true;
+		}
+	}
+
+	return capabilities;
+}
+
+uint64_t scoreDeviceCapabilities(const DeviceCapabilities& capabilities)
+{
+	uint64_t score = 0;
+	switch (capabilities.type)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		score = 1000000000ull;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		score = 100000000ull;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		score = 10000000ull;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		score = 0;
+		break;
+	default:
+		score = 1000000ull;
+		break;
+	}
+
+	// then a point per MiB of device local memory, capped so it never makes up a type step
+	score += std::min<uint64_t>(capabilities.deviceLocalMemory / (1024 * 1024), 900000ull);
+
+	// queues and features are worth a few hundred MiB, so they decide between devices with similar memory
+	score += capabilities.asyncComputeFamily >= 0 ? 512 : 0;
+	score += capabilities.transferFamily >= 0 ? 256 : 0;
+	score += capabilities.timestampValidBits > 0 ? 256 : 0;
+	score += capabilities.getOptionalFeatureCount() * 128;
+
+	return score;
+}
+
+bool matchesDeviceOverride(const DeviceCapabilities& capabilities, const std::string& deviceOverride)
+{
+	std::string lowerOverride;
+	std::string hexOverride;
+	for (char c : deviceOverride)
+	{
+		char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		lowerOverride.push_back(lower);
+		if (c != '-')
+		{
+			hexOverride.push_back(lower);
+		}
+	}
+
+	if (lowerOverride.empty())
+	{
+		return false;
+	}
+
+	std::string uuid = formatDeviceUuid(capabilities.uuid);
+	uuid.erase(std::remove(uuid.begin(), uuid.end(), '-'), uuid.end());
+	if (hexOverride == uuid)
+	{
+		return true;
+	}
+
+	std::string lowerName;
+	for (char c : capabilities.name)
+	{
+		lowerName.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+	}
+	return lowerName.find(lowerOverride) != std::string::npos;
+}
+
+std::string formatDeviceUuid(const uint8_t uuid[VK_UUID_SIZE])
+{
+	// 8-4-4-4-12, like everything else prints them
+	const char* digits = "0123456789abcdef";
+	std::string text;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+	{
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+		{
+			text.push_back('-');
+		}
+		text.push_back(digits[uuid[i] >> 4]);
+		text.push_back(digits[uuid[i] & 0xf]);
+	}
+	return text;
+}
+
+const char* getDeviceTypeName(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return "CPU";
+	default:
+		return "other";
+	}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+// What a physical device offers. Device selection scores devices from this, and the one for the selected device is kept as
+// the renderer's capability profile: optional features are enabled when present and checked here before they're used
+struct DeviceCapabilities {
+	std::string name;
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	uint32_t vendorId = 0;
+	uint32_t deviceId = 0;
+	uint8_t uuid[VK_UUID_SIZE] = {};
+	uint32_t apiVersion = 0;
+	VkDeviceSize deviceLocalMemory = 0;			// largest device local heap
+
+	// queue families, -1 if there isn't one
+	int asyncComputeFamily = -1;				// compute without graphics
+	int transferFamily = -1;					// transfer only, usually a DMA engine
+	uint32_t timestampValidBits = 0;			// of the first graphics family, 0 if it can't write timestamps
+	uint32_t asyncComputeTimestampValidBits = 0;
+	float timestampPeriod = 0.f;				// nanoseconds per tick
+
+	// required by the renderer
+	bool multiDrawIndirect = false;
+	bool drawIndirectFirstInstance = false;
+	bool drawIndirectCount = false;
+	bool timelineSemaphore = false;
+	bool descriptorIndexing = false;			// every feature the bindless descriptor set needs
+	bool dynamicRendering = false;
+	bool synchronization2 = false;
+	bool multiview = false;						// the vertex shaders index their camera with gl_ViewIndex
+
+	// optional
+	bool memoryBudget = false;					// VK_EXT_memory_budget
+	bool samplerAnisotropy = false;
+	bool textureCompressionBC = false;
+	bool bufferDeviceAddress = false;
+	bool shaderDrawParameters = false;
+	bool pipelineStatisticsQuery = false;
+
+	bool hasRequiredFeatures() const;
+	uint32_t getOptionalFeatureCount() const;
+};
+
+DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice physicalDevice);
+
+// higher is better. Device type dominates (a discrete GPU always beats an integrated one, and a software rasteriser is the
+// last resort), then device local memory, queues and optional features
+uint64_t scoreDeviceCapabilities(const DeviceCapabilities& capabilities);
+
+// the override is either a UUID (hex, dashes optional) or part of the device name, case insensitive
+bool matchesDeviceOverride(const DeviceCapabilities& capabilities, const std::string& deviceOverride);
+
+std::string formatDeviceUuid(const uint8_t uuid[VK_UUID_SIZE]);
+const char* getDeviceTypeName(VkPhysicalDeviceType type);
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+DynamicResolution::DynamicResolution()
+{
+}
+
+DynamicResolution::~DynamicResolution()
+{
+}
+
+void DynamicResolution::init(const DynamicResolutionSettings& settings)
+{
+	if (settings.minScale <= 0.f || settings.minScale > settings.maxScale || settings.targetFrameTime <= 0.f || settings.scaleStep <= 0.f)
+	{
+		throw std::runtime_error("Invalid dynamic resolution settings!");
+	}
+
+	this->settings = settings;
+	scale = settings.maxScale;
+	smoothedFrameTime = 0.f;
+}
+
+bool DynamicResolution::update(float gpuFrameTime)
+{
+	if (gpuFrameTime <= 0.f)
+	{
+		return false;
+	}
+
+	// exponential moving average, follows a sustained change within a few frames
+	smoothedFrameTime = smoothedFrameTime == 0.f ? gpuFrameTime : smoothedFrameTime + (gpuFrameTime - smoothedFrameTime) * 0.1f;
+
+	// steps are compared as whole numbers, multiples of the step don't survive the round trip through a float exactly. An
+	// ideal scale a rounding error short of a step still reaches it
+	float idealScale = scale * std::sqrt(settings.targetFrameTime / smoothedFrameTime);
+	long idealStep = static_cast<long>(std::floor(idealScale / settings.scaleStep + 0.001f));
+	long currentStep = std::lround(scale / settings.scaleStep);
+	float newScale = std::min(std::max(idealStep * settings.scaleStep, settings.minScale), settings.maxScale);
+
+	// drop as soon as the budget is exceeded, but rounding down means going back up needs a whole step of headroom
+	bool overBudget = smoothedFrameTime > settings.targetFrameTime;
+	if (newScale != scale && ((overBudget && idealStep < currentStep) || (!overBudget && idealStep > currentStep)))
+	{
+		// the smoothed time was measured at the old scale, estimate it at the new one so the next frames don't overshoot
+		smoothedFrameTime *= (newScale * newScale) / (scale * scale);
+		scale = newScale;
+		return true;
+	}
+
+	return false;
+}
+
+VkExtent2D DynamicResolution::scaleExtent(VkExtent2D extent, float scale)
+{
+	VkExtent2D scaled = {};
+	scaled.width = std::max(static_cast<uint32_t>(std::lround(extent.width * scale)), 1u);
+	scaled.height = std::max(static_cast<uint32_t>(std::lround(extent.height * scale)), 1u);
+	return scaled;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct DynamicResolutionSettings {
+	float minScale = 0.5f;
+	float maxScale = 1.f;						// above 1 renders more pixels than the swapchain has and downscales
+	float targetFrameTime = 1000.f / 60.f;		// GPU milliseconds
+	float scaleStep = 0.05f;					// scales are rounded down to a multiple of this
+};
+
+// Picks the render scale (of each swapchain dimension) from measured GPU frame times. GPU time is roughly proportional to
+// the pixel count, so the scale that hits the target is scale * sqrt(target / time). Times are smoothed and scales are
+// stepped, so timing noise doesn't make the resolution flicker or the renderer re-record every frame
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+	~DynamicResolution();
+
+	void init(const DynamicResolutionSettings& settings);
+
+	// returns true if the scale changed
+	bool update(float gpuFrameTime);
+
+	float getScale() const { return scale; }
+	float getSmoothedFrameTime() const { return smoothedFrameTime; }
+	const DynamicResolutionSettings& getSettings() const { return settings; }
+
+	static VkExtent2D scaleExtent(VkExtent2D extent, float scale);
+
+private:
+	DynamicResolutionSettings settings;
+	float scale = 1.f;
+	float smoothedFrameTime = 0.f;
+};
\ No newline at end of file
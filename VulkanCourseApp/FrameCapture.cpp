@@ -0,0 +1,391 @@
+#include "FrameCapture.h"
+
+#include <cstdio>
+#include <limits>
+
+#include "Utilities.h"
+
+FrameCapture::FrameCapture()
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+}
+
+void FrameCapture::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamily, VkFormat format,
+	VkExtent2D extent, uint32_t ringSize, FrameCaptureOutput output, const std::string& filePrefix,
+	std::function<void(const CapturedFrame&)> consumer)
+{
+	// only 4 byte formats the PPM writer knows the channel order of
+	if (format != VK_FORMAT_B8G8R8A8_UNORM && format != VK_FORMAT_B8G8R8A8_SRGB &&
+		format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+	{
+		throw std::runtime_error("Unsupported frame capture format!");
+	}
+	if (ringSize == 0 || (output == FrameCaptureOutput::Callback && !consumer))
+	{
+		throw std::runtime_error("Invalid frame capture settings!");
+	}
+
+	this->logicalDevice = logicalDevice;
+	this->format = format;
+	this->extent = extent;
+	this->output = output;
+	this->filePrefix = filePrefix;
+	this->consumer = consumer;
+	frameSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	// cached memory makes the CPU reads fast, not all devices have it for buffers though
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		VkMemoryPropertyFlags cachedFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		if ((memoryProperties.memoryTypes[i].propertyFlags & cachedFlags) == cachedFlags)
+		{
+			memoryFlags = cachedFlags;
+			break;
+		}
+	}
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamily;
+
+	VkResult result = vkCreateCommandPool(logicalDevice, &commandPoolCreateInfo, nullptr, &commandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create frame capture command pool!");
+	}
+
+	slots.resize(ringSize);
+	for (Slot& slot : slots)
+	{
+		createBuffer(physicalDevice, logicalDevice, frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryFlags, &slot.buffer,
+			&slot.memory);
+
+		result = vkMapMemory(logicalDevice, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to map frame capture buffer!");
+		}
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.commandPool = commandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = 1;
+
+		result = vkAllocateCommandBuffers(logicalDevice, &commandBufferAllocateInfo, &slot.commandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate frame capture command buffer!");
+		}
+	}
+
+	printf("Frame capture: %ux%u, %u buffers (%.1f MB)%s\n", extent.width, extent.height, ringSize,
+		static_cast<double>(frameSize * ringSize) / (1024.0 * 1024.0),
+		(memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? ", host cached" : "");
+
+	stopping = false;
+	writerThread = std::thread(&FrameCapture::writerLoop, this);
+	enabled = true;
+}
+
+void FrameCapture::destroy()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// the device is idle, so every submitted copy has finished
+	collect(std::numeric_limits<uint64_t>::max());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	writerThread.join();
+
+	FrameCaptureStats finalStats = getStats();
+	printf("Frame capture: %llu frames written, %llu dropped, %.1f frames/s, %.1f MB/s\n",
+		static_cast<unsigned long long>(finalStats.framesWritten), static_cast<unsigned long long>(finalStats.framesDropped),
+		finalStats.seconds > 0.0 ? finalStats.framesWritten / finalStats.seconds : 0.0,
+		finalStats.seconds > 0.0 ? finalStats.bytesWritten / (1024.0 * 1024.0) / finalStats.seconds : 0.0);
+
+	for (Slot& slot : slots)
+	{
+		vkUnmapMemory(logicalDevice, slot.memory);
+		vkDestroyBuffer(logicalDevice, slot.buffer, nullptr);
+		MemoryTelemetry::get().release(logicalDevice, slot.memory);
+	}
+	slots.clear();
+	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+
+	enabled = false;
+}
+
+VkCommandBuffer FrameCapture::recordCapture(VkImage image, uint64_t frameNumber)
+{
+	Slot* slot = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!started)
+		{
+			startTime = std::chrono::steady_clock::now();
+			started = true;
+		}
+
+		for (Slot& candidate : slots)
+		{
+			if (candidate.state == SlotState::Free)
+			{
+				slot = &candidate;
+				break;
+			}
+		}
+
+		if (slot == nullptr)
+		{
+			stats.framesDropped++;
+			return VK_NULL_HANDLE;
+		}
+		slot->state = SlotState::InFlight;
+		slot->frameNumber = frameNumber;
+	}
+
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(slot->commandBuffer, &commandBufferBeginInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording frame capture command buffer!");
+	}
+
+	// the frame's last access is the render graph's transition to present, which is in the colour attachment output stage
+	VkImageMemoryBarrier2 imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.levelCount = 1;
+	imageBarrier.subresourceRange.layerCount = 1;
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+	vkCmdPipelineBarrier2(slot->commandBuffer, &dependencyInfo);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;		// tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { extent.width, extent.height, 1 };
+	vkCmdCopyImageToBuffer(slot->commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+	// back to present for the presentation engine, and make the copy visible to the host once the frame's submission completes
+	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+	imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkBufferMemoryBarrier2 bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot->buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	dependencyInfo.bufferMemoryBarrierCount = 1;
+	dependencyInfo.pBufferMemoryBarriers = &bufferBarrier;
+	vkCmdPipelineBarrier2(slot->commandBuffer, &dependencyInfo);
+
+	result = vkEndCommandBuffer(slot->commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end recording frame capture command buffer!");
+	}
+
+	return slot->commandBuffer;
+}
+
+void FrameCapture::collect(uint64_t completedFrames)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i].state == SlotState::InFlight && slots[i].frameNumber < completedFrames)
+			{
+				slots[i].state = SlotState::Writing;
+				writeQueue.push_back(i);
+				queued = true;
+			}
+		}
+	}
+
+	if (queued)
+	{
+		condition.notify_one();
+	}
+}
+
+FrameCaptureStats FrameCapture::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FrameCaptureStats current = stats;
+	if (started)
+	{
+		current.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+	return current;
+}
+
+void FrameCapture::writerLoop()
+{
+	PROFILE_THREAD_NAME("Frame capture writer");
+
+	while (true)
+	{
+		uint32_t slotIndex;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stopping || !writeQueue.empty(); });
+			if (writeQueue.empty())
+			{
+				return;		// only stops once everything queued is written
+			}
+			slotIndex = writeQueue.front();
+			writeQueue.pop_front();
+		}
+
+		Slot& slot = slots[slotIndex];
+
+		// no-op for coherent memory, needed for cached memory that isn't
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(logicalDevice, 1, &range);
+
+		try
+		{
+			PROFILE_ZONE("Write captured frame");
+			writeFrame(slot);
+		}
+		catch (const std::exception& e)
+		{
+			// a failed write loses the frame, it mustn't take the renderer down
+			printf("Frame capture failed for frame %llu: %s\n", static_cast<unsigned long long>(slot.frameNumber), e.what());
+		}
+
+		FrameCaptureStats report;
+		bool shouldReport = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.state = SlotState::Free;
+			stats.framesWritten++;
+			stats.bytesWritten += frameSize;
+
+			// sustained throughput every couple of seconds of capturing
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			if (seconds >= 2.0 * (reportCount + 1))
+			{
+				reportCount++;
+				report = stats;
+				report.seconds = seconds;
+				shouldReport = true;
+			}
+		}
+
+		if (shouldReport)
+		{
+			printf("Frame capture: %.1f frames/s, %.1f MB/s, %llu dropped\n", report.framesWritten / report.seconds,
+				report.bytesWritten / (1024.0 * 1024.0) / report.seconds, static_cast<unsigned long long>(report.framesDropped));
+		}
+	}
+}
+
+void FrameCapture::writeFrame(const Slot& slot)
+{
+	const uint8_t* pixels = static_cast<const uint8_t*>(slot.mapped);
+
+	if (output == FrameCaptureOutput::Callback)
+	{
+		CapturedFrame frame = {};
+		frame.pixels = pixels;
+		frame.width = extent.width;
+		frame.height = extent.height;
+		frame.rowPitch = extent.width * 4;
+		frame.format = format;
+		frame.frameNumber = slot.frameNumber;
+		consumer(frame);
+		return;
+	}
+
+	std::string path = filePrefix + std::to_string(slot.frameNumber) + (output == FrameCaptureOutput::Ppm ? ".ppm" : ".raw");
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	if (output == FrameCaptureOutput::Raw)
+	{
+		file.write(reinterpret_cast<const char*>(pixels), frameSize);
+	}
+	else
+	{
+		file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+		// drop alpha and swizzle a row at a time, so the file is written in a few large writes
+		bool bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+		std::vector<char> row(extent.width * 3);
+		for (uint32_t y = 0; y < extent.height; y++)
+		{
+			const uint8_t* source = pixels + static_cast<size_t>(y) * extent.width * 4;
+			for (uint32_t x = 0; x < extent.width; x++)
+			{
+				row[x * 3 + 0] = source[x * 4 + (bgra ? 2 : 0)];
+				row[x * 3 + 1] = source[x * 4 + 1];
+				row[x * 3 + 2] = source[x * 4 + (bgra ? 0 : 2)];
+			}
+			file.write(row.data(), row.size());
+		}
+	}
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// what the writer thread does with each captured frame
+enum class FrameCaptureOutput {
+	Callback,		// hand the pixels to the consumer callback
+	Raw,			// write the pixels as they are, tightly packed 4 bytes per pixel
+	Ppm				// write binary 8 bit RGB PPM files
+};
+
+// pixels are only valid for the duration of the consumer callback
+struct CapturedFrame {
+	const uint8_t* pixels;
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;			// bytes
+	VkFormat format;
+	uint64_t frameNumber;
+};
+
+struct FrameCaptureStats {
+	uint64_t framesWritten = 0;
+	uint64_t framesDropped = 0;		// frames where every buffer in the ring was still busy
+	uint64_t bytesWritten = 0;
+	double seconds = 0.0;			// since the first frame was captured
+};
+
+// Copies presented images into a ring of host-visible (and host-cached where available, as they're only read by the CPU)
+// buffers. A small command buffer is recorded per capture and submitted straight after the frame's own, so the
+// pre-recorded frame command buffers don't change. Once the frame is known to have finished its buffer is handed to a
+// writer thread, which calls the consumer or writes a file and then returns the buffer to the ring. draw() never waits for
+// the writer: if the ring is full, the frame isn't captured
+class FrameCapture
+{
+public:
+	FrameCapture();
+	~FrameCapture();
+
+	// filePrefix is used by the file outputs, frames are written to <prefix><frame number>.raw/.ppm
+	void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamily, VkFormat format, VkExtent2D extent,
+		uint32_t ringSize, FrameCaptureOutput output, const std::string& filePrefix,
+		std::function<void(const CapturedFrame&)> consumer = nullptr);
+	// writes out every captured frame still queued, the device must be idle
+	void destroy();
+
+	// records a copy of image (in present layout, which it's left in) into a free buffer of the ring. Returns the command
+	// buffer to submit after the frame's, or VK_NULL_HANDLE if the ring is full
+	VkCommandBuffer recordCapture(VkImage image, uint64_t frameNumber);
+
+	// hands the buffers of every frame before completedFrames to the writer thread
+	void collect(uint64_t completedFrames);
+
+	bool isEnabled() const { return enabled; }
+	FrameCaptureStats getStats();
+
+private:
+	enum class SlotState {
+		Free,
+		InFlight,		// copy submitted, frame not known to be finished
+		Writing			// owned by the writer thread
+	};
+
+	struct Slot {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		void* mapped;
+		VkCommandBuffer commandBuffer;
+		SlotState state = SlotState::Free;
+		uint64_t frameNumber;
+	};
+
+	bool enabled = false;
+
+	VkDevice logicalDevice;
+	VkFormat format;
+	VkExtent2D extent;
+	VkDeviceSize frameSize;
+	FrameCaptureOutput output;
+	std::string filePrefix;
+	std::function<void(const CapturedFrame&)> consumer;
+
+	VkCommandPool commandPool;
+	std::vector<Slot> slots;
+
+	// slots move Free -> InFlight -> Writing on the render thread and back to Free on the writer thread, states and the
+	// queue are guarded by the mutex
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<uint32_t> writeQueue;
+	bool stopping = false;
+	std::thread writerThread;
+
+	FrameCaptureStats stats;
+	bool started = false;
+	std::chrono::steady_clock::time_point startTime;
+	uint32_t reportCount = 0;
+
+	void writerLoop();
+	void writeFrame(const Slot& slot);
+};
\ No newline at end of file
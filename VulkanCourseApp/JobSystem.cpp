@@ -0,0 +1,378 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+static_assert((MAX_QUEUED_JOBS_PER_THREAD & (MAX_QUEUED_JOBS_PER_THREAD - 1)) == 0, "Job deque size must be a power of two");
+
+// which deque the current thread owns
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local uint32_t currentThreadIndex = 0;
+
+static bool isReady(const JobCounter* dependency)
+{
+	return dependency == nullptr || dependency->done();
+}
+
+JobSystem::JobSystem()
+{
+}
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+void JobSystem::init(uint32_t threadCount)
+{
+	if (running.load())
+	{
+		throw std::runtime_error("Job system is already running!");
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		deques.push_back(std::unique_ptr<WorkStealingDeque>(new WorkStealingDeque()));
+	}
+
+	currentJobSystem = this;
+	currentThreadIndex = 0;
+
+	running.store(true);
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::shutdown()
+{
+	if (!running.exchange(false))
+	{
+		return;
+	}
+
+	wakeCondition.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	// finish anything still queued, nothing else can touch the deques now
+	while (runPendingJob(0))
+	{
+	}
+	deques.clear();
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter* counter, const JobCounter* dependency)
+{
+	if (deques.empty())
+	{
+		throw std::runtime_error("Job system is not initialised!");
+	}
+
+	if (counter != nullptr)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job* job = new Job{ std::move(function), counter, dependency };
+
+	// only the owner may push to a deque
+	if (!isJobThread())
+	{
+		injectJob(job);
+		return;
+	}
+
+	if (!deques[getThreadIndex()]->push(job))
+	{
+		// queue is full, make progress on our own instead
+		wait(dependency);
+		execute(job);
+		return;
+	}
+
+	if (sleepingWorkers.load(std::memory_order_relaxed) > 0)
+	{
+		wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::wait(const JobCounter* counter)
+{
+	uint32_t threadIndex = getThreadIndex();
+	while (!isReady(counter))
+	{
+		if (!runPendingJob(threadIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t start, uint32_t end)>& function,
+	const JobCounter* dependency)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// 0 gives each thread a few batches, enough for stealing to even out uneven batches
+	if (batchSize == 0)
+	{
+		uint32_t batchCount = getThreadCount() * 4;
+		batchSize = (count + batchCount - 1) / batchCount;
+	}
+
+	// the first exception thrown by a batch is rethrown on the calling thread once every batch has finished
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	JobCounter counter;
+	for (uint32_t start = 0; start < count; start += batchSize)
+	{
+		uint32_t end = count - start > batchSize ? start + batchSize : count;
+		run([&function, &error, &errorMutex, start, end]() {
+			try
+			{
+				function(start, end);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+			}
+		}, &counter, dependency);
+
+		if (end == count)
+		{
+			break;
+		}
+	}
+
+	wait(&counter);
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+uint32_t JobSystem::getThreadIndex() const
+{
+	return currentJobSystem == this ? currentThreadIndex : 0;
+}
+
+bool JobSystem::isJobThread() const
+{
+	return currentJobSystem == this;
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex)
+{
+	currentJobSystem = this;
+	currentThreadIndex = threadIndex;
+	PROFILE_THREAD_NAME("Job worker");
+
+	uint32_t idleSpins = 0;
+	while (running.load(std::memory_order_acquire))
+	{
+		if (runPendingJob(threadIndex))
+		{
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// nothing to do for a while, sleep until new work is queued. The timeout covers a wake up sent just before we
+		// started waiting
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		sleepingWorkers++;
+		wakeCondition.wait_for(lock, std::chrono::milliseconds(1));
+		sleepingWorkers--;
+		idleSpins = 0;
+	}
+}
+
+bool JobSystem::runPendingJob(uint32_t threadIndex)
+{
+	// threads outside the system waiting on a counter don't own a deque, they only take injected jobs and steal
+	WorkStealingDeque* ownDeque = isJobThread() ? deques[threadIndex].get() : nullptr;
+
+	Job* job = nullptr;
+	if (ownDeque != nullptr)
+	{
+		job = ownDeque->pop();
+		if (job != nullptr && !isReady(job->dependency))
+		{
+			ownDeque->push(job);		// can't fail, we just popped from it
+			job = nullptr;
+		}
+	}
+
+	if (job == nullptr)
+	{
+		job = takeInjectedJob();
+	}
+
+	// steal, starting with the top of our own deque: the newest job can be waiting on older ones queued beneath it
+	uint32_t threadCount = getThreadCount();
+	for (uint32_t i = 0; i < threadCount && job == nullptr; i++)
+	{
+		job = deques[(threadIndex + i) % threadCount]->steal();
+		if (job != nullptr && !isReady(job->dependency))
+		{
+			if (ownDeque == nullptr)
+			{
+				injectJob(job);
+			}
+			else if (!ownDeque->push(job))
+			{
+				wait(job->dependency);
+				break;
+			}
+			job = nullptr;
+		}
+	}
+
+	if (job == nullptr)
+	{
+		return false;
+	}
+
+	execute(job);
+	return true;
+}
+
+void JobSystem::injectJob(Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(injectionMutex);
+		injectedJobs.push_back(job);
+		injectedJobCount.fetch_add(1, std::memory_order_release);
+	}
+
+	if (sleepingWorkers.load(std::memory_order_relaxed) > 0)
+	{
+		wakeCondition.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::takeInjectedJob()
+{
+	if (injectedJobCount.load(std::memory_order_acquire) == 0)
+	{
+		return nullptr;
+	}
+
+	// a job whose dependency isn't done goes to the back, behind the ones that may be ready
+	std::lock_guard<std::mutex> lock(injectionMutex);
+	for (size_t i = 0; i < injectedJobs.size(); i++)
+	{
+		Job* job = injectedJobs.front();
+		injectedJobs.pop_front();
+		if (isReady(job->dependency))
+		{
+			injectedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+		injectedJobs.push_back(job);
+	}
+	return nullptr;
+}
+
+void JobSystem::execute(Job* job)
+{
+	{
+		PROFILE_ZONE("Job");
+		job->function();
+	}
+
+	JobCounter* counter = job->counter;
+	delete job;
+
+	if (counter != nullptr)
+	{
+		counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+
+bool JobSystem::WorkStealingDeque::push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= static_cast<int64_t>(MAX_QUEUED_JOBS_PER_THREAD))
+	{
+		return false;
+	}
+
+	buffer[b & (MAX_QUEUED_JOBS_PER_THREAD - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkStealingDeque::pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = buffer[b & (MAX_QUEUED_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last job, race any thief for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkStealingDeque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	Job* job = buffer[t & (MAX_QUEUED_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+
+	return job;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+// number of jobs a single thread can have queued before run() starts executing new jobs inline
+const uint32_t MAX_QUEUED_JOBS_PER_THREAD = 4096;
+
+// counts outstanding jobs. A job can be made to wait for a counter, which is how dependencies between jobs are expressed
+struct JobCounter {
+	std::atomic<uint32_t> pending{ 0 };
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Work-stealing scheduler. Each thread (the one that called init() plus the workers) owns a deque: it pushes and pops
+// its own jobs from the bottom, while idle threads steal from the top of the others. Other threads don't own a deque, the
+// jobs they submit go into a locked injection queue that every thread takes from
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// threadCount includes the calling thread, 0 uses every hardware thread
+	void init(uint32_t threadCount = 0);
+	void shutdown();
+
+	// counter (optional) is incremented now and decremented once the job has run. The job won't start before
+	// dependency (optional) reaches zero. The job must not throw
+	void run(std::function<void()> function, JobCounter* counter = nullptr, const JobCounter* dependency = nullptr);
+
+	// runs other jobs until counter reaches zero, so waiting from inside a job doesn't block a thread
+	void wait(const JobCounter* counter);
+
+	// splits [0, count) into batches of batchSize (0 picks one) and waits for all of them, rethrowing the first exception
+	void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t start, uint32_t end)>& function,
+		const JobCounter* dependency = nullptr);
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(deques.size()); }
+	// 0 for the thread that called init() and for threads outside the system, 1 to getThreadCount() - 1 for the workers
+	uint32_t getThreadIndex() const;
+	// the thread that called init() or a worker, i.e. one that owns a deque
+	bool isJobThread() const;
+
+private:
+	struct Job {
+		std::function<void()> function;
+		JobCounter* counter;
+		const JobCounter* dependency;
+	};
+
+	// Chase-Lev deque with a fixed size ring buffer
+	class WorkStealingDeque
+	{
+	public:
+		bool push(Job* job);
+		Job* pop();
+		Job* steal();
+
+	private:
+		std::atomic<int64_t> top{ 0 };
+		std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Job*> buffer[MAX_QUEUED_JOBS_PER_THREAD];
+	};
+
+	std::vector<std::unique_ptr<WorkStealingDeque>> deques;		// index 0 belongs to the thread that called init()
+
+	// jobs submitted from threads outside the system, and jobs those threads stole before their dependency was done
+	std::mutex injectionMutex;
+	std::deque<Job*> injectedJobs;
+	std::atomic<size_t> injectedJobCount{ 0 };		// saves taking the lock when there's nothing to take
+	std::vector<std::thread> workers;
+
+	std::atomic<bool> running{ false };
+	std::atomic<uint32_t> sleepingWorkers{ 0 };
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+
+	void workerLoop(uint32_t threadIndex);
+	bool runPendingJob(uint32_t threadIndex);
+	void injectJob(Job* job);
+	Job* takeInjectedJob();
+	void execute(Job* job);
+};
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static const double MEGABYTE = 1024.0 * 1024.0;
+static const float WARNING_INTERVAL = 1.f;		// seconds, allocations over budget come in bursts
+
+const char* getMemoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Vertex:
+		return "vertex";
+	case MemoryCategory::Index:
+		return "index";
+	case MemoryCategory::Uniform:
+		return "uniform";
+	case MemoryCategory::Storage:
+		return "storage";
+	case MemoryCategory::Staging:
+		return "staging";
+	case MemoryCategory::Readback:
+		return "readback";
+	case MemoryCategory::Image:
+		return "image";
+	case MemoryCategory::RenderTarget:
+		return "render target";
+	default:
+		return "unknown";
+	}
+}
+
+MemoryTelemetry& MemoryTelemetry::get()
+{
+	static MemoryTelemetry telemetry;
+	return telemetry;
+}
+
+MemoryTelemetry::MemoryTelemetry()
+{
+}
+
+MemoryTelemetry::~MemoryTelemetry()
+{
+}
+
+void MemoryTelemetry::init(VkPhysicalDevice physicalDevice, bool budgetSupported)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	this->physicalDevice = physicalDevice;
+	this->budgetSupported = budgetSupported;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	allocations.clear();
+	typeUsage.assign(memoryProperties.memoryTypeCount, MemoryUsageStats());
+	heapUsage.assign(memoryProperties.memoryHeapCount, MemoryUsageStats());
+	for (MemoryUsageStats& stats : categoryUsage)
+	{
+		stats = MemoryUsageStats();
+	}
+	totalUsage = MemoryUsageStats();
+
+	lastLog = std::chrono::steady_clock::now();
+	initialised = true;
+
+	printf("Memory telemetry: %u heaps, %u types, budget %s\n", memoryProperties.memoryHeapCount, memoryProperties.memoryTypeCount,
+		budgetSupported ? "from VK_EXT_memory_budget" : "is the heap size");
+}
+
+void MemoryTelemetry::shutdown()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!initialised)
+	{
+		return;
+	}
+
+	if (!allocations.empty())
+	{
+		printf("Memory telemetry: %zu allocations (%.2f MB) still live at shutdown\n", allocations.size(),
+			totalUsage.liveBytes / MEGABYTE);
+		for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++)
+		{
+			if (categoryUsage[i].allocationCount > 0)
+			{
+				printf("  %s: %u allocations, %.2f MB\n", getMemoryCategoryName(static_cast<MemoryCategory>(i)),
+					categoryUsage[i].allocationCount, categoryUsage[i].liveBytes / MEGABYTE);
+			}
+		}
+	}
+	printf("Memory telemetry: peak %.1f MB\n", totalUsage.peakBytes / MEGABYTE);
+
+	allocations.clear();
+	evictionHandlers.clear();
+	initialised = false;
+}
+
+VkResult MemoryTelemetry::allocate(VkDevice logicalDevice, const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category,
+	VkDeviceMemory* memory)
+{
+	if (!initialised)
+	{
+		return vkAllocateMemory(logicalDevice, &allocateInfo, nullptr, memory);
+	}
+
+	uint32_t heapIndex = memoryProperties.memoryTypes[allocateInfo.memoryTypeIndex].heapIndex;
+
+	// make room before going over budget, going over is allowed but may page or fail
+	std::vector<VkDeviceSize> budgets;
+	std::vector<VkDeviceSize> usages;
+	queryBudget(budgets, usages);
+	if (usages[heapIndex] + allocateInfo.allocationSize > budgets[heapIndex])
+	{
+		VkDeviceSize excess = usages[heapIndex] + allocateInfo.allocationSize - budgets[heapIndex];
+		VkDeviceSize evicted = evict(heapIndex, excess);
+		uint32_t suppressed;
+		if (shouldWarn(&suppressed))
+		{
+			printf("WARNING: %.2f MB %s allocation goes %.2f MB over heap %u's %.1f MB budget, %.2f MB evicted (%u warnings "
+				"suppressed)\n", allocateInfo.allocationSize / MEGABYTE, getMemoryCategoryName(category), excess / MEGABYTE, heapIndex,
+				budgets[heapIndex] / MEGABYTE, evicted / MEGABYTE, suppressed);
+		}
+	}
+
+	// handlers free their memory once the GPU is done with it, so retrying straight away would fail the same way. The
+	// eviction makes room for the allocations after this one
+	VkResult result = vkAllocateMemory(logicalDevice, &allocateInfo, nullptr, memory);
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+	{
+		VkDeviceSize evicted = evict(heapIndex, allocateInfo.allocationSize);
+		uint32_t suppressed;
+		if (shouldWarn(&suppressed))
+		{
+			printf("WARNING: %.2f MB %s allocation failed in heap %u, %.2f MB evicted (%u warnings suppressed)\n",
+				allocateInfo.allocationSize / MEGABYTE, getMemoryCategoryName(category), heapIndex, evicted / MEGABYTE, suppressed);
+		}
+	}
+	if (result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Allocation allocation = {};
+	allocation.size = allocateInfo.allocationSize;
+	allocation.typeIndex = allocateInfo.memoryTypeIndex;
+	allocation.category = category;
+	allocations[*memory] = allocation;
+
+	add(typeUsage[allocation.typeIndex], allocation.size);
+	add(heapUsage[heapIndex], allocation.size);
+	add(categoryUsage[static_cast<size_t>(category)], allocation.size);
+	add(totalUsage, allocation.size);
+
+	return VK_SUCCESS;
+}
+
+void MemoryTelemetry::release(VkDevice logicalDevice, VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto allocation = allocations.find(memory);
+		if (allocation != allocations.end())
+		{
+			remove(typeUsage[allocation->second.typeIndex], allocation->second.size);
+			remove(heapUsage[memoryProperties.memoryTypes[allocation->second.typeIndex].heapIndex], allocation->second.size);
+			remove(categoryUsage[static_cast<size_t>(allocation->second.category)], allocation->second.size);
+			remove(totalUsage, allocation->second.size);
+			allocations.erase(allocation);
+		}
+	}
+
+	vkFreeMemory(logicalDevice, memory, nullptr);
+}
+
+uint32_t MemoryTelemetry::addEvictionHandler(std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize bytes)> handler)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	EvictionHandler evictionHandler = {};
+	evictionHandler.id = nextEvictionHandlerId++;
+	evictionHandler.evict = handler;
+	evictionHandlers.push_back(evictionHandler);
+	return evictionHandler.id;
+}
+
+void MemoryTelemetry::removeEvictionHandler(uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	evictionHandlers.erase(std::remove_if(evictionHandlers.begin(), evictionHandlers.end(),
+		[id](const EvictionHandler& handler) { return handler.id == id; }), evictionHandlers.end());
+}
+
+MemorySnapshot MemoryTelemetry::getSnapshot()
+{
+	MemorySnapshot snapshot = {};
+	if (!initialised)
+	{
+		return snapshot;
+	}
+
+	std::vector<VkDeviceSize> budgets;
+	std::vector<VkDeviceSize> usages;
+	queryBudget(budgets, usages);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	snapshot.budgetSupported = budgetSupported;
+
+	snapshot.heaps.resize(memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		snapshot.heaps[i].usage = heapUsage[i];
+		snapshot.heaps[i].size = memoryProperties.memoryHeaps[i].size;
+		snapshot.heaps[i].budget = budgets[i];
+		snapshot.heaps[i].processUsage = usages[i];
+		snapshot.heaps[i].flags = memoryProperties.memoryHeaps[i].flags;
+	}
+
+	snapshot.types.resize(memoryProperties.memoryTypeCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		snapshot.types[i].usage = typeUsage[i];
+		snapshot.types[i].heapIndex = memoryProperties.memoryTypes[i].heapIndex;
+		snapshot.types[i].propertyFlags = memoryProperties.memoryTypes[i].propertyFlags;
+	}
+
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++)
+	{
+		snapshot.categories[i] = categoryUsage[i];
+	}
+	snapshot.total = totalUsage;
+
+	return snapshot;
+}
+
+void MemoryTelemetry::printSnapshot()
+{
+	MemorySnapshot snapshot = getSnapshot();
+
+	printf("Memory: %.1f MB in %u allocations (peak %.1f MB)\n", snapshot.total.liveBytes / MEGABYTE,
+		snapshot.total.allocationCount, snapshot.total.peakBytes / MEGABYTE);
+	for (size_t i = 0; i < snapshot.heaps.size(); i++)
+	{
+		const MemoryHeapStats& heap = snapshot.heaps[i];
+		printf("  heap %zu%s: %.1f MB in %u allocations, process uses %.1f of %.1f MB budget (%.1f MB heap)\n", i,
+			(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "", heap.usage.liveBytes / MEGABYTE,
+			heap.usage.allocationCount, heap.processUsage / MEGABYTE, heap.budget / MEGABYTE, heap.size / MEGABYTE);
+	}
+	for (size_t i = 0; i < snapshot.types.size(); i++)
+	{
+		const MemoryTypeStats& type = snapshot.types[i];
+		if (type.usage.peakBytes > 0)
+		{
+			printf("  type %zu (heap %u, flags 0x%x): %.1f MB in %u allocations, peak %.1f MB\n", i, type.heapIndex,
+				type.propertyFlags, type.usage.liveBytes / MEGABYTE, type.usage.allocationCount, type.usage.peakBytes / MEGABYTE);
+		}
+	}
+	for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); i++)
+	{
+		const MemoryUsageStats& category = snapshot.categories[i];
+		if (category.peakBytes > 0)
+		{
+			printf("  %s: %.1f MB in %u allocations, peak %.1f MB\n", getMemoryCategoryName(static_cast<MemoryCategory>(i)),
+				category.liveBytes / MEGABYTE, category.allocationCount, category.peakBytes / MEGABYTE);
+		}
+	}
+}
+
+void MemoryTelemetry::update()
+{
+	if (!initialised || logInterval <= 0.f)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<float>(now - lastLog).count() < logInterval)
+	{
+		return;
+	}
+	lastLog = now;
+
+	// one line: totals, then every heap the process uses
+	MemorySnapshot snapshot = getSnapshot();
+	printf("Memory: %.1f MB, %u allocations", snapshot.total.liveBytes / MEGABYTE, snapshot.total.allocationCount);
+	for (size_t i = 0; i < snapshot.heaps.size(); i++)
+	{
+		if (snapshot.heaps[i].usage.allocationCount > 0)
+		{
+			printf(" | heap %zu %.1f/%.1f MB", i, snapshot.heaps[i].processUsage / MEGABYTE, snapshot.heaps[i].budget / MEGABYTE);
+		}
+	}
+	printf("\n");
+}
+
+void MemoryTelemetry::queryBudget(std::vector<VkDeviceSize>& budgets, std::vector<VkDeviceSize>& usages)
+{
+	budgets.resize(memoryProperties.memoryHeapCount);
+	usages.resize(memoryProperties.memoryHeapCount);
+
+	if (!budgetSupported)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			budgets[i] = memoryProperties.memoryHeaps[i].size;
+			usages[i] = heapUsage[i].liveBytes;
+		}
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties2.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		budgets[i] = budgetProperties.heapBudget[i];
+		usages[i] = budgetProperties.heapUsage[i];
+	}
+}
+
+VkDeviceSize MemoryTelemetry::evict(uint32_t heapIndex, VkDeviceSize bytes)
+{
+	// copied so handlers can free memory (which takes the lock) while being called
+	std::vector<EvictionHandler> handlers;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handlers = evictionHandlers;
+	}
+
+	VkDeviceSize freed = 0;
+	for (const auto& handler : handlers)
+	{
+		if (freed >= bytes)
+		{
+			break;
+		}
+		freed += handler.evict(heapIndex, bytes - freed);
+	}
+	return freed;
+}
+
+bool MemoryTelemetry::shouldWarn(uint32_t* suppressed)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (warningCount > 0 && std::chrono::duration<float>(now - lastWarning).count() < WARNING_INTERVAL)
+	{
+		suppressedWarnings++;
+		return false;
+	}
+
+	warningCount++;
+	lastWarning = now;
+	*suppressed = suppressedWarnings;
+	suppressedWarnings = 0;
+	return true;
+}
+
+void MemoryTelemetry::add(MemoryUsageStats& stats, VkDeviceSize size)
+{
+	stats.liveBytes += size;
+	stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+	stats.allocationCount++;
+}
+
+void MemoryTelemetry::remove(MemoryUsageStats& stats, VkDeviceSize size)
+{
+	stats.liveBytes -= size;
+	stats.allocationCount--;
+}
\ No newline at end of file
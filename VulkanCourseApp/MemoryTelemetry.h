@@ -0,0 +1,132 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// what an allocation is for, buffers are categorised from their usage and memory properties
+enum class MemoryCategory {
+	Vertex,
+	Index,
+	Uniform,			// host visible buffers the GPU reads every frame
+	Storage,			// device local buffers written by the GPU
+	Staging,			// host visible upload sources
+	Readback,			// host visible download destinations
+	Image,
+	RenderTarget,		// render graph transients
+	Count
+};
+
+const char* getMemoryCategoryName(MemoryCategory category);
+
+struct MemoryUsageStats {
+	VkDeviceSize liveBytes = 0;
+	VkDeviceSize peakBytes = 0;
+	uint32_t allocationCount = 0;
+};
+
+struct MemoryHeapStats {
+	MemoryUsageStats usage;				// allocations made by this process through the telemetry
+	VkDeviceSize size;
+	VkDeviceSize budget;				// how much the process can use before the OS starts paging, heap size without the extension
+	VkDeviceSize processUsage;			// what the driver says the process uses (including allocations made elsewhere)
+	VkMemoryHeapFlags flags;
+};
+
+struct MemoryTypeStats {
+	MemoryUsageStats usage;
+	uint32_t heapIndex;
+	VkMemoryPropertyFlags propertyFlags;
+};
+
+struct MemorySnapshot {
+	bool budgetSupported;
+	std::vector<MemoryHeapStats> heaps;
+	std::vector<MemoryTypeStats> types;
+	MemoryUsageStats categories[static_cast<size_t>(MemoryCategory::Count)];
+	MemoryUsageStats total;
+};
+
+// Tracks every device memory allocation by type, heap and category, and compares heap use against the budget
+// VK_EXT_memory_budget reports (or the heap size without it). Allocations that would go over budget first ask the
+// registered eviction handlers to free memory in that heap, as does a failed allocation for the ones after it. Both warn,
+// at most once a second.
+// There is one per process, so the allocation helpers in Utilities.h can report to it without threading it through
+class MemoryTelemetry
+{
+public:
+	static MemoryTelemetry& get();
+
+	void init(VkPhysicalDevice physicalDevice, bool budgetSupported);
+	// prints anything still allocated
+	void shutdown();
+
+	// drop in replacements for vkAllocateMemory and vkFreeMemory. Allocation works before init, it just isn't tracked
+	VkResult allocate(VkDevice logicalDevice, const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category,
+		VkDeviceMemory* memory);
+	void release(VkDevice logicalDevice, VkDeviceMemory memory);
+
+	// handlers get the heap and the bytes wanted, and return how many bytes they freed or queued to free once the GPU is
+	// done with them. They're called without any telemetry lock held, from whichever thread is allocating, so may free (but
+	// not allocate) memory. Returns an id for removing the handler
+	uint32_t addEvictionHandler(std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize bytes)> handler);
+	void removeEvictionHandler(uint32_t id);
+
+	MemorySnapshot getSnapshot();
+	void printSnapshot();
+
+	// call once a frame, prints a one line summary every interval seconds (0 disables it)
+	void setLogInterval(float seconds) { logInterval = seconds; }
+	void update();
+
+private:
+	MemoryTelemetry();
+	~MemoryTelemetry();
+
+	struct Allocation {
+		VkDeviceSize size;
+		uint32_t typeIndex;
+		MemoryCategory category;
+	};
+
+	std::atomic<bool> initialised{ false };		// read without the lock by allocate and release
+	bool budgetSupported = false;
+	VkPhysicalDevice physicalDevice;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+
+	std::mutex mutex;		// buffers and images are created from loader and job threads
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	std::vector<MemoryUsageStats> typeUsage;
+	std::vector<MemoryUsageStats> heapUsage;
+	MemoryUsageStats categoryUsage[static_cast<size_t>(MemoryCategory::Count)];
+	MemoryUsageStats totalUsage;
+
+	struct EvictionHandler {
+		uint32_t id;
+		std::function<VkDeviceSize(uint32_t heapIndex, VkDeviceSize bytes)> evict;
+	};
+	std::vector<EvictionHandler> evictionHandlers;
+	uint32_t nextEvictionHandlerId = 0;
+
+	float logInterval = 5.f;
+	std::chrono::steady_clock::time_point lastLog;
+
+	uint32_t warningCount = 0;
+	uint32_t suppressedWarnings = 0;
+	std::chrono::steady_clock::time_point lastWarning;
+
+	// budget and driver reported usage per heap
+	void queryBudget(std::vector<VkDeviceSize>& budgets, std::vector<VkDeviceSize>& usages);
+	VkDeviceSize evict(uint32_t heapIndex, VkDeviceSize bytes);
+	// false if a warning was printed too recently, otherwise true with the number of warnings skipped since
+	bool shouldWarn(uint32_t* suppressed);
+	static void add(MemoryUsageStats& stats, VkDeviceSize size);
+	static void remove(MemoryUsageStats& stats, VkDeviceSize size);
+};
\ No newline at end of file
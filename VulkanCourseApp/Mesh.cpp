@@ -1,18 +1,32 @@
 #include "Mesh.h"
 
+#include <algorithm>
+#include <limits>
+
 Mesh::Mesh()
 {
 }
 
-Mesh::Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool,
-	const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices)
+Mesh::Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, QueueTimeline* transferQueue, VkCommandPool transferCommandPool,
+	const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices, MeshVertexLayout vertexLayout)
 {
-	this->physicalDevice = physicalDevice;
-	this->logicalDevice = logicalDevice;
-	vertexCount = static_cast<uint32_t>(vertices->size());
-	indexCount = static_cast<uint32_t>(indices->size());
-	createVertexBuffer(transferQueue, transferCommandPool, vertices);
-	createIndexBuffer(transferQueue, transferCommandPool, indices);
+	// every buffer's copy in one submission
+	std::vector<StagingBuffer> stagingBuffers;
+	VkCommandBuffer commandBuffer = beginCommandBuffer(logicalDevice, transferCommandPool);
+	create(physicalDevice, logicalDevice, commandBuffer, &stagingBuffers, vertices, indices, vertexLayout);
+	endAndSubmitCommandBuffer(logicalDevice, transferCommandPool, transferQueue, commandBuffer);
+
+	for (const StagingBuffer& stagingBuffer : stagingBuffers)
+	{
+		destroyStagingBuffer(logicalDevice, stagingBuffer);
+	}
+}
+
+Mesh::Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkCommandBuffer uploadCommandBuffer,
+	std::vector<StagingBuffer>* stagingBuffers, const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices,
+	MeshVertexLayout vertexLayout)
+{
+	create(physicalDevice, logicalDevice, uploadCommandBuffer, stagingBuffers, vertices, indices, vertexLayout);
 }
 
 Mesh::~Mesh()
@@ -22,55 +36,128 @@ Mesh::~Mesh()
 void Mesh::destroyBuffers()
 {
 	vkDestroyBuffer(logicalDevice, vertexBuffer, nullptr);
-	vkFreeMemory(logicalDevice, vertexBufferMemory, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, vertexBufferMemory);
 	vkDestroyBuffer(logicalDevice, indexBuffer, nullptr);
-	vkFreeMemory(logicalDevice, indexBufferMemory, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, indexBufferMemory);
 }
 
-void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const std::vector<Vertex>* vertices)
+void Mesh::destroyBuffers(DeletionQueue& deletionQueue)
 {
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
-	
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	// the handles move into the queue, so a later destroyBuffers() has nothing left to destroy
+	Mesh buffers = *this;
+	deletionQueue.push([buffers]() mutable { buffers.destroyBuffers(); });
+
+	vertexBuffer = VK_NULL_HANDLE;
+	vertexBufferMemory = VK_NULL_HANDLE;
+	indexBuffer = VK_NULL_HANDLE;
+	indexBufferMemory = VK_NULL_HANDLE;
+	positionAddress = 0;
+	attributeAddress = 0;
+}
+
+void Mesh::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkCommandBuffer uploadCommandBuffer,
+	std::vector<StagingBuffer>* stagingBuffers, const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices,
+	MeshVertexLayout vertexLayout)
+{
+	this->physicalDevice = physicalDevice;
+	this->logicalDevice = logicalDevice;
+	this->vertexLayout = vertexLayout;
+	vertexCount = static_cast<uint32_t>(vertices->size());
+	indexCount = static_cast<uint32_t>(indices->size());
+	calculateBoundingSphere(vertices);
+	if (vertexLayout == MeshVertexLayout::Pulled)
+	{
+		createVertexStreams(uploadCommandBuffer, stagingBuffers, vertices);
+	}
+	else
+	{
+		createVertexBuffer(uploadCommandBuffer, stagingBuffers, vertices);
+	}
+	createIndexBuffer(uploadCommandBuffer, stagingBuffers, indices);
+}
 
-	createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+void Mesh::createVertexBuffer(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+	const std::vector<Vertex>* vertices)
+{
+	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
 
 	void* data;
-	vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
+	StagingBuffer stagingBuffer = createStagingBuffer(physicalDevice, logicalDevice, bufferSize, &data);
 	memcpy(data, vertices->data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+	stagingBuffers->push_back(stagingBuffer);
 
 	createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
 
-	copyBuffer(logicalDevice, transferQueue, transferCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+	recordCopyBuffer(uploadCommandBuffer, stagingBuffer.buffer, vertexBuffer, bufferSize);
 }
 
-void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const std::vector<uint32_t>* indices)
+void Mesh::createVertexStreams(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+	const std::vector<Vertex>* vertices)
 {
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
+	// positions stay full precision for exact depth, colour and uv are packed. Streams start 16 byte aligned
+	VkDeviceSize positionSize = sizeof(glm::vec3) * vertices->size();
+	VkDeviceSize attributeOffset = (positionSize + 15) & ~static_cast<VkDeviceSize>(15);
+	VkDeviceSize bufferSize = attributeOffset + sizeof(PackedVertexAttributes) * vertices->size();
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	void* data;
+	StagingBuffer stagingBuffer = createStagingBuffer(physicalDevice, logicalDevice, bufferSize, &data);
+	stagingBuffers->push_back(stagingBuffer);
+
+	glm::vec3* positions = static_cast<glm::vec3*>(data);
+	PackedVertexAttributes* attributes = reinterpret_cast<PackedVertexAttributes*>(static_cast<uint8_t*>(data) + attributeOffset);
+	for (size_t i = 0; i < vertices->size(); i++)
+	{
+		const Vertex& vertex = (*vertices)[i];
+		positions[i] = vertex.pos;
+		attributes[i].colour = glm::packUnorm4x8(glm::vec4(vertex.col, 1.f));
+		attributes[i].uv = glm::packHalf2x16(vertex.uv);
+	}
+
+	// no vertex buffer usage, the vertex shader reads the streams as storage through their addresses
+	createBuffer(physicalDevice, logicalDevice, bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
 
-	createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+	recordCopyBuffer(uploadCommandBuffer, stagingBuffer.buffer, vertexBuffer, bufferSize);
+
+	positionAddress = getBufferDeviceAddress(logicalDevice, vertexBuffer);
+	attributeAddress = positionAddress + attributeOffset;
+}
+
+void Mesh::createIndexBuffer(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+	const std::vector<uint32_t>* indices)
+{
+	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
 
 	void* data;
-	vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
+	StagingBuffer stagingBuffer = createStagingBuffer(physicalDevice, logicalDevice, bufferSize, &data);
 	memcpy(data, indices->data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+	stagingBuffers->push_back(stagingBuffer);
 
 	createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexBufferMemory);
 
-	copyBuffer(logicalDevice, transferQueue, transferCommandPool, stagingBuffer, indexBuffer, bufferSize);
+	recordCopyBuffer(uploadCommandBuffer, stagingBuffer.buffer, indexBuffer, bufferSize);
+}
 
-	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+void Mesh::calculateBoundingSphere(const std::vector<Vertex>* vertices)
+{
+	// centre of the axis aligned bounds, radius reaching the furthest vertex. Not minimal, but cheap and conservative
+	glm::vec3 minPos(std::numeric_limits<float>::max());
+	glm::vec3 maxPos(-std::numeric_limits<float>::max());
+	for (const Vertex& vertex : *vertices)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+
+	glm::vec3 centre = (minPos + maxPos) * 0.5f;
+	float radius = 0.f;
+	for (const Vertex& vertex : *vertices)
+	{
+		radius = std::max(radius, glm::length(vertex.pos - centre));
+	}
+
+	boundingSphere = glm::vec4(centre, radius);
 }
@@ -5,35 +5,78 @@
 
 #include <vector>
 
+#include "DeletionQueue.h"
 #include "Utilities.h"
 
+// how a mesh's vertices are stored on the GPU
+enum class MeshVertexLayout {
+	Interleaved,		// Vertex structs in a vertex buffer, read through the pipeline's vertex input
+	Pulled				// a position stream and a packed colour/uv stream, read by the vertex shader through their device addresses
+};
+
+// one vertex of the pulled attribute stream, 8 bytes instead of the 20 colour and uv take in Vertex
+struct PackedVertexAttributes {
+	uint32_t colour;	// RGBA8 unorm
+	uint32_t uv;		// two halfs
+};
+
 class Mesh
 {
 public:
 	Mesh();
-	Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool,
-		const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices);
+	// uploads the buffers and waits for the copies
+	Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, QueueTimeline* transferQueue, VkCommandPool transferCommandPool,
+		const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices,
+		MeshVertexLayout vertexLayout = MeshVertexLayout::Interleaved);
+	// records the copies into uploadCommandBuffer and adds the staging buffers they read to stagingBuffers. The mesh can be
+	// drawn, and the staging buffers destroyed, once it has been submitted and finished
+	Mesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkCommandBuffer uploadCommandBuffer,
+		std::vector<StagingBuffer>* stagingBuffers, const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices,
+		MeshVertexLayout vertexLayout = MeshVertexLayout::Interleaved);
 	~Mesh();
 
+	// straight away, only once the GPU is idle
 	void destroyBuffers();
+	// once everything submitted so far is finished, the mesh is left without buffers
+	void destroyBuffers(DeletionQueue& deletionQueue);
+	bool hasBuffers() const { return indexBuffer != VK_NULL_HANDLE; }
 
 	uint32_t getVertexCount() const { return vertexCount; }
+	MeshVertexLayout getVertexLayout() const { return vertexLayout; }
+	// interleaved layout only
 	VkBuffer getVertexBuffer() const { return vertexBuffer; }
+	// pulled layout only, both streams live in the vertex buffer
+	VkDeviceAddress getPositionAddress() const { return positionAddress; }
+	VkDeviceAddress getAttributeAddress() const { return attributeAddress; }
 	uint32_t getIndexCount() const { return indexCount; }
 	VkBuffer getIndexBuffer() const { return indexBuffer; }
+	glm::vec4 getBoundingSphere() const { return boundingSphere; }
 private:
 	uint32_t vertexCount;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
+	MeshVertexLayout vertexLayout;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+	VkDeviceAddress positionAddress = 0;
+	VkDeviceAddress attributeAddress = 0;
 
 	uint32_t indexCount;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+	glm::vec4 boundingSphere;		// xyz = centre, w = radius, in model space
 
 	VkPhysicalDevice physicalDevice;
 	VkDevice logicalDevice;
 
-	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const std::vector<Vertex>* vertices);
-	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const std::vector<uint32_t>* indices);
+	void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkCommandBuffer uploadCommandBuffer,
+		std::vector<StagingBuffer>* stagingBuffers, const std::vector<Vertex>* vertices, const std::vector<uint32_t>* indices,
+		MeshVertexLayout vertexLayout);
+	void createVertexBuffer(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+		const std::vector<Vertex>* vertices);
+	void createVertexStreams(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+		const std::vector<Vertex>* vertices);
+	void createIndexBuffer(VkCommandBuffer uploadCommandBuffer, std::vector<StagingBuffer>* stagingBuffers,
+		const std::vector<uint32_t>* indices);
+	void calculateBoundingSphere(const std::vector<Vertex>* vertices);
 };
 
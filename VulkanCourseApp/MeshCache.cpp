@@ -0,0 +1,141 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static const uint64_t HASH_MULTIPLIER = 0x9e3779b97f4a7c15ull;
+// xxHash64's primes, for the checksum
+static const uint64_t CHECKSUM_PRIME_1 = 0x9e3779b185ebca87ull;
+static const uint64_t CHECKSUM_PRIME_2 = 0xc2b2ae3d27d4eb4full;
+
+// splitmix64's finaliser, so every input bit affects every output bit
+static uint64_t mix(uint64_t value)
+{
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ull;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebull;
+	value ^= value >> 31;
+	return value;
+}
+
+// an xxHash64 style round, which has nothing in common with mix, so a word sequence colliding in one is no more likely
+// to collide in the other
+static uint64_t checksumRound(uint64_t checksum, uint64_t word)
+{
+	checksum += word * CHECKSUM_PRIME_2;
+	checksum = (checksum << 31) | (checksum >> 33);
+	return checksum * CHECKSUM_PRIME_1;
+}
+
+static void hashBytes(MeshKey& key, const void* data, size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	size_t wordCount = size / sizeof(uint64_t);
+	for (size_t i = 0; i < wordCount; i++)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		key.hash = (key.hash ^ mix(word)) * HASH_MULTIPLIER;
+		key.checksum = checksumRound(key.checksum, word);
+	}
+
+	// index data can end on half a word
+	uint64_t tail = 0;
+	memcpy(&tail, bytes + wordCount * sizeof(uint64_t), size - wordCount * sizeof(uint64_t));
+	key.hash = (key.hash ^ mix(tail)) * HASH_MULTIPLIER;
+	key.checksum = checksumRound(key.checksum, tail);
+}
+
+static bool isSameGeometry(const MeshKey& a, const MeshKey& b)
+{
+	return a.hash == b.hash && a.checksum == b.checksum && a.vertexCount == b.vertexCount && a.indexCount == b.indexCount;
+}
+
+MeshCache::MeshCache()
+{
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+MeshKey MeshCache::hashGeometry(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	MeshKey key = {};
+	key.vertexCount = static_cast<uint32_t>(vertices.size());
+	key.indexCount = static_cast<uint32_t>(indices.size());
+
+	uint64_t counts = (static_cast<uint64_t>(vertices.size()) << 32) | indices.size();
+	key.hash = mix(counts);
+	key.checksum = CHECKSUM_PRIME_1 + counts;
+	hashBytes(key, vertices.data(), sizeof(Vertex) * vertices.size());
+	hashBytes(key, indices.data(), sizeof(uint32_t) * indices.size());
+	key.hash = mix(key.hash);
+	return key;
+}
+
+MeshHandle MeshCache::acquire(const MeshKey& key)
+{
+	auto handle = handles.find(key.hash);
+	if (handle == handles.end())
+	{
+		return MESH_NOT_CACHED;
+	}
+
+	// the hash alone isn't trusted, different geometry gets its own mesh
+	if (!isSameGeometry(entries[handle->second].key, key))
+	{
+		collisionCount++;
+		return MESH_NOT_CACHED;
+	}
+
+	entries[handle->second].references++;
+	duplicateCount++;
+	return handle->second;
+}
+
+void MeshCache::insert(const MeshKey& key, MeshHandle mesh)
+{
+	if (mesh >= entries.size())
+	{
+		entries.resize(mesh + 1, Entry{ MeshKey(), 0 });
+	}
+	entries[mesh].key = key;
+	entries[mesh].references = 1;
+
+	// a duplicate among the startup meshes, or a mesh whose hash collided, keeps its own handle and acquire finds the first
+	handles.insert(std::make_pair(key.hash, mesh));
+}
+
+bool MeshCache::release(MeshHandle mesh)
+{
+	if (mesh >= entries.size() || entries[mesh].references == 0)
+	{
+		throw std::runtime_error("Failed to release mesh, it has no references!");
+	}
+
+	Entry& entry = entries[mesh];
+	entry.references--;
+	if (entry.references > 0)
+	{
+		return false;
+	}
+
+	auto handle = handles.find(entry.key.hash);
+	if (handle != handles.end() && handle->second == mesh)
+	{
+		handles.erase(handle);
+	}
+	return true;
+}
+
+uint32_t MeshCache::getReferenceCount(MeshHandle mesh) const
+{
+	return mesh < entries.size() ? entries[mesh].references : 0;
+}
\ No newline at end of file
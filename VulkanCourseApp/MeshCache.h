@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Utilities.h"
+
+// meshes are referenced by their index in the renderer, which scene nodes take as their mesh
+typedef uint32_t MeshHandle;
+const MeshHandle MESH_NOT_CACHED = UINT32_MAX;
+
+// identifies a mesh's geometry without keeping a copy of it
+struct MeshKey {
+	uint64_t hash;				// what the cache is looked up by
+	uint64_t checksum;			// a second hash of the same data built differently, compared on a hit
+	uint32_t vertexCount;
+	uint32_t indexCount;
+};
+
+// Reference counted meshes keyed by a hash of their vertex and index data, so geometry that is added again gets the mesh
+// already uploaded instead of a second copy. A hit is only trusted if the counts and the independent checksum match as
+// well, otherwise the geometry is treated as new, so a false match needs two 64 bit collisions between meshes of the same
+// size. Handles aren't reused once their last reference goes, so scene nodes still pointing at a removed mesh never pick
+// up someone else's geometry
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	// 64 bits at a time, the whole mesh is read once for both hashes
+	static MeshKey hashGeometry(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// the mesh with this key gains a reference, MESH_NOT_CACHED if there isn't one
+	MeshHandle acquire(const MeshKey& key);
+	// a newly uploaded mesh, with one reference
+	void insert(const MeshKey& key, MeshHandle mesh);
+	// true when that was the last reference, the mesh is then forgotten and can be destroyed
+	bool release(MeshHandle mesh);
+
+	uint32_t getReferenceCount(MeshHandle mesh) const;
+	// acquires that found their geometry already uploaded
+	uint64_t getDuplicateCount() const { return duplicateCount; }
+	// lookups whose hash matched a mesh with different geometry
+	uint64_t getCollisionCount() const { return collisionCount; }
+
+private:
+	struct Entry {
+		MeshKey key;
+		uint32_t references;		// 0 once released
+	};
+
+	std::unordered_map<uint64_t, MeshHandle> handles;
+	std::vector<Entry> entries;			// by handle
+	uint64_t duplicateCount = 0;
+	uint64_t collisionCount = 0;
+};
\ No newline at end of file
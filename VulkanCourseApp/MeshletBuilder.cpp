@@ -0,0 +1,184 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// bounds and normal cone of the triangles in indices [firstIndex, firstIndex + indexCount)
+static Meshlet createMeshlet(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex,
+	uint32_t indexCount)
+{
+	Meshlet meshlet = {};
+	meshlet.firstIndex = firstIndex;
+	meshlet.indexCount = indexCount;
+
+	// like the mesh's sphere: centre of the bounds, radius reaching the furthest vertex
+	glm::vec3 minPos(std::numeric_limits<float>::max());
+	glm::vec3 maxPos(-std::numeric_limits<float>::max());
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+	{
+		minPos = glm::min(minPos, vertices[indices[i]].pos);
+		maxPos = glm::max(maxPos, vertices[indices[i]].pos);
+	}
+
+	glm::vec3 centre = (minPos + maxPos) * 0.5f;
+	float radius = 0.f;
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+	{
+		radius = std::max(radius, glm::length(vertices[indices[i]].pos - centre));
+	}
+	meshlet.boundingSphere = glm::vec4(centre, radius);
+
+	// front faces wind counter clockwise, so cross(b - a, c - a) points out of them. Degenerate triangles never rasterise,
+	// so they don't widen the cone
+	glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+	uint32_t normalCount = 0;
+	glm::vec3 normalSum(0.f);
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+	{
+		glm::vec3 a = vertices[indices[i]].pos;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].pos - a, vertices[indices[i + 2]].pos - a);
+		float area = glm::length(normal);
+		if (area > 0.f)
+		{
+			normals[normalCount] = normal / area;
+			normalSum += normals[normalCount];
+			normalCount++;
+		}
+	}
+
+	float axisLength = glm::length(normalSum);
+	if (axisLength < 1e-6f)
+	{
+		meshlet.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+		return meshlet;
+	}
+
+	glm::vec3 axis = normalSum / axisLength;
+	float minDot = 1.f;
+	for (uint32_t i = 0; i < normalCount; i++)
+	{
+		minDot = std::min(minDot, glm::dot(axis, normals[i]));
+	}
+
+	// a cone wider than ~84 degrees is back facing from almost nowhere, so it's marked as never culled
+	meshlet.cone = glm::vec4(axis, minDot <= 0.1f ? 1.f : std::sqrt(1.f - minDot * minDot));
+	return meshlet;
+}
+
+void buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets)
+{
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// triangles using each vertex, packed per vertex
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (const uint32_t index : indices)
+	{
+		adjacencyOffsets[index + 1]++;
+	}
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> reordered;
+	reordered.reserve(triangleCount * 3);
+
+	// the meshlet each vertex was last added to, so membership doesn't have to be cleared between meshlets
+	std::vector<uint32_t> vertexMeshlet(vertexCount, std::numeric_limits<uint32_t>::max());
+	uint32_t meshletIndex = 0;
+	uint32_t meshletVertices[MESHLET_MAX_VERTICES];
+	uint32_t meshletVertexCount = 0;
+	uint32_t meshletTriangleCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t nextSeed = 0;
+
+	auto countNewVertices = [&](uint32_t triangle) {
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			count += vertexMeshlet[indices[triangle * 3 + i]] != meshletIndex ? 1 : 0;
+		}
+		return count;
+	};
+
+	auto finishMeshlet = [&]() {
+		uint32_t indexCount = static_cast<uint32_t>(reordered.size()) - firstIndex;
+		meshlets.push_back(createMeshlet(vertices, reordered, firstIndex, indexCount));
+		firstIndex += indexCount;
+		meshletVertexCount = 0;
+		meshletTriangleCount = 0;
+		meshletIndex++;
+	};
+
+	for (uint32_t placed = 0; placed < triangleCount; placed++)
+	{
+		// the unplaced neighbour adding the fewest vertices, as long as it still fits
+		uint32_t best = std::numeric_limits<uint32_t>::max();
+		uint32_t bestNewVertices = 4;
+		if (meshletTriangleCount < MESHLET_MAX_TRIANGLES)
+		{
+			for (uint32_t i = 0; i < meshletVertexCount && bestNewVertices > 0; i++)
+			{
+				uint32_t vertex = meshletVertices[i];
+				for (uint32_t j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++)
+				{
+					uint32_t triangle = adjacency[j];
+					if (emitted[triangle])
+					{
+						continue;
+					}
+
+					uint32_t newVertices = countNewVertices(triangle);
+					if (newVertices < bestNewVertices && meshletVertexCount + newVertices <= MESHLET_MAX_VERTICES)
+					{
+						best = triangle;
+						bestNewVertices = newVertices;
+					}
+				}
+			}
+		}
+
+		// full, or nothing connected is left: start the next meshlet from the first unplaced triangle
+		if (best == std::numeric_limits<uint32_t>::max())
+		{
+			if (meshletTriangleCount > 0)
+			{
+				finishMeshlet();
+			}
+			while (emitted[nextSeed])
+			{
+				nextSeed++;
+			}
+			best = nextSeed;
+		}
+
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			uint32_t vertex = indices[best * 3 + i];
+			if (vertexMeshlet[vertex] != meshletIndex)
+			{
+				vertexMeshlet[vertex] = meshletIndex;
+				meshletVertices[meshletVertexCount++] = vertex;
+			}
+			reordered.push_back(vertex);
+		}
+		emitted[best] = true;
+		meshletTriangleCount++;
+	}
+
+	if (meshletTriangleCount > 0)
+	{
+		finishMeshlet();
+	}
+
+	indices.swap(reordered);
+}
\ No newline at end of file
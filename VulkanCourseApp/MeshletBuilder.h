@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+#include "Utilities.h"
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Splits a mesh into meshlets at load time. Triangles are reordered in indices so each meshlet is a contiguous index range,
+// and the meshlets are appended to meshlets. A meshlet grows from a seed triangle by whichever neighbouring triangle adds
+// the fewest new vertices, so it stays compact and its bounds and normal cone stay tight
+void buildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets);
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+#include "ShaderCache.h"
+
+ParticleSystem::ParticleSystem()
+{
+}
+
+ParticleSystem::~ParticleSystem()
+{
+}
+
+void ParticleSystem::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, BindlessDescriptors* bindlessDescriptors,
+	uint32_t capacity)
+{
+	this->physicalDevice = physicalDevice;
+	this->logicalDevice = logicalDevice;
+	this->bindlessDescriptors = bindlessDescriptors;
+	this->capacity = capacity;
+
+	// simulation is dispatched with one thread per alive particle, in groups of 64
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	if (capacity == 0 || (capacity + 63) / 64 > deviceProperties.limits.maxComputeWorkGroupCount[0])
+	{
+		throw std::runtime_error("Particle capacity is not supported by the device!");
+	}
+}
+
+void ParticleSystem::createBuffers(QueueTimeline* transferQueue, VkCommandPool transferCommandPool, uint32_t frameCount,
+	const std::vector<uint32_t>& queueFamilies)
+{
+	createBuffer(physicalDevice, logicalDevice, sizeof(glm::vec4) * 2 * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &particleBuffer, &particleBufferMemory, queueFamilies);
+	createBuffer(physicalDevice, logicalDevice, sizeof(uint32_t) * 2 * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &aliveListBuffer, &aliveListBufferMemory, queueFamilies);
+	createBuffer(physicalDevice, logicalDevice, sizeof(uint32_t) * capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&deadListBuffer, &deadListBufferMemory, queueFamilies);
+	createBuffer(physicalDevice, logicalDevice, sizeof(ParticleCounters),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &counterBuffer, &counterBufferMemory, queueFamilies);
+
+	// every particle starts dead, and the dead list and counters are only ever touched by the GPU after this
+	VkDeviceSize deadListSize = sizeof(uint32_t) * capacity;
+	VkDeviceSize stagingSize = deadListSize + sizeof(ParticleCounters);
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, logicalDevice, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, stagingSize, 0, &data);
+	uint32_t* deadList = static_cast<uint32_t*>(data);
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		deadList[i] = i;
+	}
+
+	ParticleCounters initialCounters = {};
+	initialCounters.deadCount = static_cast<int32_t>(capacity);
+	initialCounters.simulateDispatch = { 0, 1, 1 };
+	initialCounters.draw = { 6, 0, 0, 0 };
+	memcpy(static_cast<char*>(data) + deadListSize, &initialCounters, sizeof(ParticleCounters));
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(logicalDevice, transferCommandPool);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = deadListSize;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, deadListBuffer, 1, &copyRegion);
+
+		copyRegion.srcOffset = deadListSize;
+		copyRegion.size = sizeof(ParticleCounters);
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, counterBuffer, 1, &copyRegion);
+
+	endAndSubmitCommandBuffer(logicalDevice, transferCommandPool, transferQueue, commandBuffer);
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, stagingBufferMemory);
+
+	paramsBuffers.resize(frameCount);
+	paramsBufferMemory.resize(frameCount);
+	paramsBufferMapped.resize(frameCount);
+	paramsBufferIndex.resize(frameCount);
+
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(physicalDevice, logicalDevice, sizeof(ParticleParams), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &paramsBuffers[i], &paramsBufferMemory[i],
+			queueFamilies);
+		vkMapMemory(logicalDevice, paramsBufferMemory[i], 0, sizeof(ParticleParams), 0, &paramsBufferMapped[i]);
+		memset(paramsBufferMapped[i], 0, sizeof(ParticleParams));
+
+		paramsBufferIndex[i] = bindlessDescriptors->registerStorageBuffer(paramsBuffers[i]);
+	}
+
+	particleBufferIndex = bindlessDescriptors->registerStorageBuffer(particleBuffer);
+	aliveListBufferIndex = bindlessDescriptors->registerStorageBuffer(aliveListBuffer);
+	deadListBufferIndex = bindlessDescriptors->registerStorageBuffer(deadListBuffer);
+	counterBufferIndex = bindlessDescriptors->registerStorageBuffer(counterBuffer);
+}
+
+void ParticleSystem::createPipelines(VkFormat colourFormat, VkFormat depthFormat, VkSampleCountFlagBits samples, uint32_t viewMask)
+{
+	// one layout for every particle pipeline, they all take the same push constants
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ParticlePushConstants);
+
+	VkDescriptorSetLayout bindlessLayout = bindlessDescriptors->getLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle pipeline layout!");
+	}
+
+	emitPipeline = createComputePipeline("Shaders/particle_emit.spv");
+	simulatePipeline = createComputePipeline("Shaders/particle_simulate.spv");
+	preparePipeline = createComputePipeline("Shaders/particle_prepare.spv");
+
+	std::vector<char> vertCode = ShaderCache::get().getCode("Shaders/particle_vert.spv");
+	std::vector<char> fragCode = ShaderCache::get().getCode("Shaders/particle_frag.spv");
+
+	VkShaderModule vertexShaderModule = createShaderModule(logicalDevice, vertCode);
+	VkShaderModule fragmentShaderModule = createShaderModule(logicalDevice, fragCode);
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentShaderModule;
+	shaderStages[1].pName = "main";
+
+	// particles are pulled from storage buffers by instance index, corners come from the vertex index
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	// the render graph sets the viewport and scissor to the render resolution
+	VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
+	viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportCreateInfo.viewportCount = 1;
+	viewportCreateInfo.scissorCount = 1;
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicCreateInfo = {};
+	dynamicCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicCreateInfo.pDynamicStates = dynamicStates.data();
+
+	VkPipelineRasterizationStateCreateInfo rasterizationCreateInfo = {};
+	rasterizationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationCreateInfo.lineWidth = 1.f;
+	rasterizationCreateInfo.cullMode = VK_CULL_MODE_NONE;
+	rasterizationCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
+	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleCreateInfo.rasterizationSamples = samples;
+
+	// tested against the scene, but particles don't occlude each other
+	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	depthStencilCreateInfo.depthWriteEnable = VK_FALSE;
+	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	// additive, so the order particles are drawn in doesn't matter
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
+	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendCreateInfo.logicOpEnable = VK_FALSE;
+	colorBlendCreateInfo.attachmentCount = 1;
+	colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
+
+	VkPipelineRenderingCreateInfo renderingCreateInfo = {};
+	renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingCreateInfo.colorAttachmentCount = 1;
+	renderingCreateInfo.pColorAttachmentFormats = &colourFormat;
+	renderingCreateInfo.depthAttachmentFormat = depthFormat;
+	renderingCreateInfo.viewMask = viewMask;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = &renderingCreateInfo;
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineCreateInfo.pStages = shaderStages.data();
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pViewportState = &viewportCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colorBlendCreateInfo;
+	pipelineCreateInfo.pDynamicState = &dynamicCreateInfo;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.renderPass = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	result = vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &drawPipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle draw pipeline!");
+	}
+
+	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+}
+
+VkPipeline ParticleSystem::createComputePipeline(const std::string& shaderFile)
+{
+	std::vector<char> code = ShaderCache::get().getCode(shaderFile);
+	VkShaderModule shaderModule = createShaderModule(logicalDevice, code);
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	VkResult result = vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle compute pipeline!");
+	}
+
+	vkDestroyShaderModule(logicalDevice, shaderModule, nullptr);
+	return pipeline;
+}
+
+void ParticleSystem::destroy()
+{
+	vkDestroyPipeline(logicalDevice, drawPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, preparePipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, simulatePipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, emitPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+
+	for (size_t i = 0; i < paramsBuffers.size(); i++)
+	{
+		bindlessDescriptors->releaseStorageBuffer(paramsBufferIndex[i]);
+		vkDestroyBuffer(logicalDevice, paramsBuffers[i], nullptr);
+		MemoryTelemetry::get().release(logicalDevice, paramsBufferMemory[i]);
+	}
+
+	bindlessDescriptors->releaseStorageBuffer(particleBufferIndex);
+	bindlessDescriptors->releaseStorageBuffer(aliveListBufferIndex);
+	bindlessDescriptors->releaseStorageBuffer(deadListBufferIndex);
+	bindlessDescriptors->releaseStorageBuffer(counterBufferIndex);
+
+	vkDestroyBuffer(logicalDevice, counterBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, counterBufferMemory);
+	vkDestroyBuffer(logicalDevice, deadListBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, deadListBufferMemory);
+	vkDestroyBuffer(logicalDevice, aliveListBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, aliveListBufferMemory);
+	vkDestroyBuffer(logicalDevice, particleBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, particleBufferMemory);
+}
+
+void ParticleSystem::addSimulationPasses(RenderGraph& renderGraph)
+{
+	simulationGraph = &renderGraph;
+	particleResource = renderGraph.importBuffer("Particles", particleBuffer);
+	aliveListResource = renderGraph.importBuffer("Particle alive lists", aliveListBuffer);
+	deadListResource = renderGraph.importBuffer("Particle dead list", deadListBuffer);
+	counterResource = renderGraph.importBuffer("Particle counters", counterBuffer, 0, offsetof(ParticleCounters, simulateDispatch));
+	argumentResource = renderGraph.importBuffer("Particle arguments", counterBuffer, offsetof(ParticleCounters, simulateDispatch),
+		sizeof(ParticleCounters) - offsetof(ParticleCounters, simulateDispatch));
+
+	RenderGraphPass pass = renderGraph.addPass("Particle simulate", RenderGraphPassType::Compute,
+		[this](VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+		bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline, frameIndex);
+		vkCmdDispatchIndirect(commandBuffer, counterBuffer, offsetof(ParticleCounters, simulateDispatch));
+	});
+	renderGraph.read(pass, argumentResource, RenderGraphAccess::IndirectRead);
+	renderGraph.write(pass, particleResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, aliveListResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, deadListResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, counterResource, RenderGraphAccess::ComputeWrite);
+
+	// the emit count changes every frame, so dispatch for the most that can be emitted and let the rest exit early
+	pass = renderGraph.addPass("Particle emit", RenderGraphPassType::Compute, [this](VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+		bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline, frameIndex);
+		vkCmdDispatch(commandBuffer, (MAX_PARTICLE_EMIT_PER_FRAME + 63) / 64, 1, 1);
+	});
+	renderGraph.write(pass, particleResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, aliveListResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, deadListResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, counterResource, RenderGraphAccess::ComputeWrite);
+
+	pass = renderGraph.addPass("Particle prepare", RenderGraphPassType::Compute, [this](VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+		bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, preparePipeline, frameIndex);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+	});
+	renderGraph.write(pass, counterResource, RenderGraphAccess::ComputeWrite);
+	renderGraph.write(pass, argumentResource, RenderGraphAccess::ComputeWrite);
+}
+
+RenderGraphPass ParticleSystem::addDrawPass(RenderGraph& renderGraph, RenderGraphResource colour, RenderGraphResource depth,
+	const std::vector<uint32_t>* mvpBuffers)
+{
+	mvpBufferIndex = mvpBuffers;
+
+	// in another graph the simulation's writes are made visible by the semaphore between the queues, so the draw pass only
+	// needs the buffers as resources of its own graph
+	RenderGraphResource particles = particleResource;
+	RenderGraphResource aliveLists = aliveListResource;
+	RenderGraphResource counters = counterResource;
+	RenderGraphResource arguments = argumentResource;
+	if (&renderGraph != simulationGraph)
+	{
+		particles = renderGraph.importBuffer("Particles", particleBuffer);
+		aliveLists = renderGraph.importBuffer("Particle alive lists", aliveListBuffer);
+		counters = renderGraph.importBuffer("Particle counters", counterBuffer, 0, offsetof(ParticleCounters, simulateDispatch));
+		arguments = renderGraph.importBuffer("Particle arguments", counterBuffer, offsetof(ParticleCounters, simulateDispatch),
+			sizeof(ParticleCounters) - offsetof(ParticleCounters, simulateDispatch));
+	}
+
+	RenderGraphPass pass = renderGraph.addPass("Particle draw", RenderGraphPassType::Raster,
+		[this](VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+		bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline, frameIndex);
+		vkCmdDrawIndirect(commandBuffer, counterBuffer, offsetof(ParticleCounters, draw), 1, sizeof(VkDrawIndirectCommand));
+	});
+	renderGraph.read(pass, arguments, RenderGraphAccess::IndirectRead);
+	renderGraph.read(pass, counters, RenderGraphAccess::VertexShaderRead);
+	renderGraph.read(pass, aliveLists, RenderGraphAccess::VertexShaderRead);
+	renderGraph.read(pass, particles, RenderGraphAccess::VertexShaderRead);
+	renderGraph.write(pass, colour, RenderGraphAccess::ColourAttachment);
+	renderGraph.read(pass, depth, RenderGraphAccess::DepthAttachmentRead);
+
+	return pass;
+}
+
+void ParticleSystem::update(uint32_t frameIndex, float deltaTime)
+{
+	// whole particles only, the remainder carries over. Anything over the per frame limit is dropped rather than saved up
+	emitAccumulator += emitter.emitRate * deltaTime;
+	uint32_t emitCount = std::min(static_cast<uint32_t>(emitAccumulator), MAX_PARTICLE_EMIT_PER_FRAME);
+	emitAccumulator = std::min(emitAccumulator - static_cast<float>(emitCount), 1.f);
+
+	ParticleParams params = {};
+	params.emitterPosition = glm::vec4(emitter.position, emitter.radius);
+	params.gravity = glm::vec4(emitter.gravity, deltaTime);
+	params.colour = emitter.colour;
+	params.emitCount = emitCount;
+	params.seed = frameNumber++;
+	params.lifetime = emitter.lifetime;
+	params.speed = emitter.speed;
+	params.size = emitter.size;
+
+	memcpy(paramsBufferMapped[frameIndex], &params, sizeof(ParticleParams));
+}
+
+void ParticleSystem::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline, uint32_t frameIndex) const
+{
+	ParticlePushConstants pushConstants = {};
+	pushConstants.capacity = capacity;
+	pushConstants.particleBuffer = particleBufferIndex;
+	pushConstants.aliveListBuffer = aliveListBufferIndex;
+	pushConstants.deadListBuffer = deadListBufferIndex;
+	pushConstants.counterBuffer = counterBufferIndex;
+	pushConstants.paramsBuffer = paramsBufferIndex[frameIndex];
+	pushConstants.mvpBuffer = mvpBufferIndex != nullptr ? (*mvpBufferIndex)[frameIndex] : 0;
+
+	VkDescriptorSet bindlessSet = bindlessDescriptors->getSet();
+
+	vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0,
+		sizeof(ParticlePushConstants), &pushConstants);
+}
\ No newline at end of file
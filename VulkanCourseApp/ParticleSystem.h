@@ -0,0 +1,146 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "glm/glm.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BindlessDescriptors.h"
+#include "RenderGraph.h"
+#include "Utilities.h"
+
+const uint32_t MAX_PARTICLE_EMIT_PER_FRAME = 65536;
+
+// how particles are spawned and move, can be changed between frames
+struct ParticleEmitterSettings {
+	glm::vec3 position = glm::vec3(0.f);
+	float radius = 0.05f;				// particles spawn anywhere inside this sphere
+	glm::vec3 gravity = glm::vec3(0.f, 0.4f, 0.f);
+	float speed = 0.3f;					// initial speed, in a random direction
+	glm::vec4 colour = glm::vec4(1.f, 0.5f, 0.15f, 0.6f);
+	float lifetime = 3.f;				// longest life in seconds, each particle lives between half and all of it
+	float size = 0.004f;				// billboard half size
+	float emitRate = 250000.f;			// particles per second
+};
+
+// Particles live entirely on the GPU. Every frame, as render graph passes:
+// - simulate integrates the alive particles, compacting survivors into the other alive list and freed particles onto
+//   the dead list with atomic appends. It is dispatched indirectly, sized by last frame's alive count
+// - emit takes particles off the dead list and appends them to the same list as the survivors
+// - prepare writes next frame's dispatch and this frame's draw arguments, then swaps the lists
+// - draw renders one billboard per alive particle with a single indirect draw
+// The CPU only writes the emitter parameters, so the cost doesn't depend on the particle count. Simulation can run on an
+// async compute queue, in a graph of its own: the draw pass then imports the buffers into the graphics graph, and the
+// queues are ordered with semaphores
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+	~ParticleSystem();
+
+	// after create, buffers (which upload) and pipelines don't depend on each other and can be created on different threads.
+	// queueFamilies are the families that simulate or draw, the buffers are shared between them if there's more than one
+	void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, BindlessDescriptors* bindlessDescriptors, uint32_t capacity);
+	void createBuffers(QueueTimeline* transferQueue, VkCommandPool transferCommandPool, uint32_t frameCount,
+		const std::vector<uint32_t>& queueFamilies);
+	void createPipelines(VkFormat colourFormat, VkFormat depthFormat, VkSampleCountFlagBits samples, uint32_t viewMask);
+	void destroy();
+
+	// simulation only depends on last frame's particles, drawing needs the scene's colour and finished depth so is added
+	// later, to the same graph or the graphics graph when simulating on another queue. mvpBuffers are bindless indices per
+	// frame, and only need to be filled in before recording
+	void addSimulationPasses(RenderGraph& renderGraph);
+	RenderGraphPass addDrawPass(RenderGraph& renderGraph, RenderGraphResource colour, RenderGraphResource depth,
+		const std::vector<uint32_t>* mvpBuffers);
+
+	// writes the frame's emitter parameters, the frame's previous submission must have finished
+	void update(uint32_t frameIndex, float deltaTime);
+
+	ParticleEmitterSettings& getEmitter() { return emitter; }
+	uint32_t getCapacity() const { return capacity; }
+
+private:
+	// std430, matches the shaders
+	struct ParticleParams {
+		glm::vec4 emitterPosition;		// w = emitter radius
+		glm::vec4 gravity;				// w = delta time
+		glm::vec4 colour;
+		uint32_t emitCount;
+		uint32_t seed;
+		float lifetime;
+		float speed;
+		float size;
+		uint32_t padding[3];
+	};
+
+	struct ParticlePushConstants {
+		uint32_t capacity;
+		uint32_t particleBuffer;
+		uint32_t aliveListBuffer;
+		uint32_t deadListBuffer;
+		uint32_t counterBuffer;
+		uint32_t paramsBuffer;
+		uint32_t mvpBuffer;
+	};
+
+	// counters are followed by the indirect arguments, which the graph tracks as a separate resource
+	struct ParticleCounters {
+		uint32_t aliveCount[2];
+		int32_t deadCount;
+		uint32_t currentList;
+		VkDispatchIndirectCommand simulateDispatch;
+		uint32_t padding;
+		VkDrawIndirectCommand draw;
+	};
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice logicalDevice;
+	BindlessDescriptors* bindlessDescriptors;
+
+	uint32_t capacity;
+	ParticleEmitterSettings emitter;
+	float emitAccumulator = 0.f;
+	uint32_t frameNumber = 0;
+
+	VkBuffer particleBuffer;
+	VkDeviceMemory particleBufferMemory;
+	VkBuffer aliveListBuffer;
+	VkDeviceMemory aliveListBufferMemory;
+	VkBuffer deadListBuffer;
+	VkDeviceMemory deadListBufferMemory;
+	VkBuffer counterBuffer;
+	VkDeviceMemory counterBufferMemory;
+
+	// emitter parameters per frame, persistently mapped
+	std::vector<VkBuffer> paramsBuffers;
+	std::vector<VkDeviceMemory> paramsBufferMemory;
+	std::vector<void*> paramsBufferMapped;
+
+	uint32_t particleBufferIndex;
+	uint32_t aliveListBufferIndex;
+	uint32_t deadListBufferIndex;
+	uint32_t counterBufferIndex;
+	std::vector<uint32_t> paramsBufferIndex;
+	const std::vector<uint32_t>* mvpBufferIndex = nullptr;
+
+	// render graph resources in the simulation graph, the counters and the indirect arguments after them are tracked separately
+	const RenderGraph* simulationGraph = nullptr;
+	RenderGraphResource particleResource;
+	RenderGraphResource aliveListResource;
+	RenderGraphResource deadListResource;
+	RenderGraphResource counterResource;
+	RenderGraphResource argumentResource;
+
+	VkPipelineLayout pipelineLayout;
+	VkPipeline emitPipeline;
+	VkPipeline simulatePipeline;
+	VkPipeline preparePipeline;
+	VkPipeline drawPipeline;
+
+	VkPipeline createComputePipeline(const std::string& shaderFile);
+	void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline, uint32_t frameIndex) const;
+};
\ No newline at end of file
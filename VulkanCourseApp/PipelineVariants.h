@@ -0,0 +1,109 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+// Pipeline variants are structs of 32 bit specialization constants: member i is constant_id i in the shaders, so a variant
+// is specialised when its pipeline is created rather than branched on per draw, and the driver drops the code a variant
+// doesn't use. The struct is also the key its pipeline is cached under
+
+// the VkSpecializationInfo of a variant, valid for as long as this exists
+template <typename Constants>
+class SpecializationConstants
+{
+public:
+	explicit SpecializationConstants(const Constants& constants) : constants(constants)
+	{
+		static_assert(std::is_trivially_copyable<Constants>::value, "Specialization constants must be plain data");
+		static_assert(sizeof(Constants) % sizeof(uint32_t) == 0, "Specialization constants must be 32 bit members");
+
+		for (uint32_t i = 0; i < CONSTANT_COUNT; i++)
+		{
+			entries[i].constantID = i;
+			entries[i].offset = i * sizeof(uint32_t);
+			entries[i].size = sizeof(uint32_t);
+		}
+
+		info.mapEntryCount = CONSTANT_COUNT;
+		info.pMapEntries = entries;
+		info.dataSize = sizeof(Constants);
+		info.pData = &this->constants;
+	}
+
+	// info points into this, so it can't move
+	SpecializationConstants(const SpecializationConstants&) = delete;
+	SpecializationConstants& operator=(const SpecializationConstants&) = delete;
+
+	const VkSpecializationInfo* getInfo() const { return &info; }
+
+private:
+	static const uint32_t CONSTANT_COUNT = sizeof(Constants) / sizeof(uint32_t);
+
+	Constants constants;
+	VkSpecializationMapEntry entries[CONSTANT_COUNT];
+	VkSpecializationInfo info;
+};
+
+// pipelines by variant. Variants are created at startup or as meshes are added, never while recording, so lookups while
+// recording (from any thread) don't lock
+template <typename Variant>
+class PipelineVariantCache
+{
+public:
+	// create is called for variants that don't have a pipeline yet
+	template <typename CreateFunction>
+	VkPipeline getOrCreate(const Variant& variant, CreateFunction create)
+	{
+		auto found = pipelines.find(variant);
+		if (found != pipelines.end())
+		{
+			return found->second;
+		}
+
+		VkPipeline pipeline = create(variant);
+		pipelines.emplace(variant, pipeline);
+		return pipeline;
+	}
+
+	// VK_NULL_HANDLE if the variant wasn't created
+	VkPipeline find(const Variant& variant) const
+	{
+		auto found = pipelines.find(variant);
+		return found != pipelines.end() ? found->second : VK_NULL_HANDLE;
+	}
+
+	size_t size() const { return pipelines.size(); }
+
+	void destroy(VkDevice logicalDevice)
+	{
+		for (const auto& pipeline : pipelines)
+		{
+			vkDestroyPipeline(logicalDevice, pipeline.second, nullptr);
+		}
+		pipelines.clear();
+	}
+
+private:
+	// variants are plain data, so their bytes are the key (FNV-1a)
+	struct Hash {
+		size_t operator()(const Variant& variant) const
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&variant);
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(Variant); i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+	struct Equal {
+		bool operator()(const Variant& a, const Variant& b) const { return memcmp(&a, &b, sizeof(Variant)) == 0; }
+	};
+
+	std::unordered_map<Variant, VkPipeline, Hash, Equal> pipelines;
+};
\ No newline at end of file
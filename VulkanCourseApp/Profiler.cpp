@@ -0,0 +1,227 @@
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+std::atomic<bool> Profiler::enabled{ false };
+std::mutex Profiler::registryMutex;
+std::vector<Profiler::ThreadBuffer*> Profiler::threadBuffers;
+const std::chrono::steady_clock::time_point Profiler::epoch = std::chrono::steady_clock::now();
+
+// names are literals, but function names can contain quotes, backslashes or control characters, which JSON only allows
+// escaped
+static void writeJsonString(std::ofstream& file, const char* text)
+{
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+
+	file << '"';
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		unsigned char character = static_cast<unsigned char>(*c);
+		if (character < 0x20)
+		{
+			file << "\\u00" << HEX_DIGITS[character >> 4] << HEX_DIGITS[character & 0xF];
+			continue;
+		}
+		if (*c == '"' || *c == '\\')
+		{
+			file << '\\';
+		}
+		file << *c;
+	}
+	file << '"';
+}
+
+uint64_t Profiler::now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::recordZone(const char* name, uint64_t start, uint64_t end)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	ProfileEvent event = {};
+	event.name = name;
+	event.start = start;
+	event.duration = end - start;
+	event.type = ProfileEventType::Zone;
+	append(event);
+}
+
+void Profiler::recordFlow(const char* name, uint64_t id, bool begin)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	ProfileEvent event = {};
+	event.name = name;
+	event.start = now();
+	event.flowId = id;
+	event.type = begin ? ProfileEventType::FlowBegin : ProfileEventType::FlowEnd;
+	append(event);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	getThreadBuffer().name.store(name, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+	// buffers live until shutdown, threads that exit keep their events for the trace
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer == nullptr)
+	{
+		buffer = new ThreadBuffer();
+		buffer->first = new Block();
+		buffer->last = buffer->first;
+		buffer->blockCount = 1;
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffer->threadIndex = static_cast<uint32_t>(threadBuffers.size());
+		threadBuffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+void Profiler::append(const ProfileEvent& event)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+
+	uint32_t count = buffer.last->count.load(std::memory_order_relaxed);
+	if (count == EVENTS_PER_BLOCK)
+	{
+		// a long run keeps its first events rather than growing without bound
+		if (buffer.blockCount == MAX_BLOCKS_PER_THREAD)
+		{
+			buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Block* block = new Block();
+		buffer.last->next.store(block, std::memory_order_release);
+		buffer.last = block;
+		buffer.blockCount++;
+		count = 0;
+	}
+
+	buffer.last->events[count] = event;
+	buffer.last->count.store(count + 1, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		printf("Failed to open trace file %s\n", path.c_str());
+		return false;
+	}
+
+	std::vector<ThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffers = threadBuffers;
+	}
+
+	// timestamps in microseconds, the trace format's unit, with nanosecond precision however long the app has run
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	size_t eventCount = 0;
+	uint64_t droppedCount = 0;
+	for (const ThreadBuffer* buffer : buffers)
+	{
+		droppedCount += buffer->droppedCount.load(std::memory_order_relaxed);
+
+		const char* name = buffer->name.load(std::memory_order_acquire);
+		if (name != nullptr)
+		{
+			file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadIndex
+				<< ",\"args\":{\"name\":";
+			writeJsonString(file, name);
+			file << "}}";
+			first = false;
+		}
+
+		for (const Block* block = buffer->first; block != nullptr; block = block->next.load(std::memory_order_acquire))
+		{
+			uint32_t count = block->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const ProfileEvent& event = block->events[i];
+
+				file << (first ? "" : ",\n") << "{\"name\":";
+				writeJsonString(file, event.name);
+				file << ",\"pid\":1,\"tid\":" << buffer->threadIndex << ",\"ts\":" << event.start / 1000.0;
+				switch (event.type)
+				{
+				case ProfileEventType::Zone:
+					file << ",\"ph\":\"X\",\"dur\":" << event.duration / 1000.0;
+					break;
+				case ProfileEventType::FlowBegin:
+					file << ",\"ph\":\"s\",\"id\":" << event.flowId;
+					break;
+				case ProfileEventType::FlowEnd:
+					// binds to the enclosing zone rather than the next one to start
+					file << ",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << event.flowId;
+					break;
+				}
+				if (event.type != ProfileEventType::Zone)
+				{
+					// flows are matched by category and id, so each flow name gets its own ids
+					file << ",\"cat\":";
+					writeJsonString(file, event.name);
+				}
+				file << "}";
+				first = false;
+				eventCount++;
+			}
+		}
+	}
+	file << "\n]}\n";
+
+	printf("Wrote %zu profiler events from %zu threads to %s\n", eventCount, buffers.size(), path.c_str());
+	if (droppedCount > 0)
+	{
+		printf("WARNING: %llu profiler events were dropped, threads keep at most %u\n",
+			static_cast<unsigned long long>(droppedCount), MAX_BLOCKS_PER_THREAD * EVENTS_PER_BLOCK);
+	}
+	return static_cast<bool>(file);
+}
+
+void Profiler::shutdown()
+{
+	setEnabled(false);
+
+	// the exited threads' thread_local pointers dangle, but nothing records again once disabled
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (ThreadBuffer* buffer : threadBuffers)
+	{
+		Block* block = buffer->first;
+		while (block != nullptr)
+		{
+			Block* next = block->next.load(std::memory_order_acquire);
+			delete block;
+			block = next;
+		}
+		delete buffer;
+	}
+	threadBuffers.clear();
+}
+
+#endif
\ No newline at end of file
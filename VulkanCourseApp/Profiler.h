@@ -0,0 +1,118 @@
+#pragma once
+
+// Scoped CPU zones and flow events, written to per-thread buffers and dumped as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev). Everything compiles away unless ENABLE_PROFILER is defined (every configuration defines it, so release
+// builds can be profiled), and nothing is recorded until setEnabled(true), which costs one relaxed load per zone. Each thread keeps at most MAX_BLOCKS_PER_THREAD blocks, later events are dropped and
+// counted. Zone and flow names must be string literals (or otherwise live until the trace is written), only the pointer
+// is stored
+#ifdef ENABLE_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+// links the zone the begin is recorded in to the zone the end is recorded in, e.g. a submission to its fence wait
+#define PROFILE_FLOW_BEGIN(name, id) Profiler::recordFlow(name, id, true)
+#define PROFILE_FLOW_END(name, id) Profiler::recordFlow(name, id, false)
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+
+enum class ProfileEventType : uint8_t {
+	Zone,
+	FlowBegin,
+	FlowEnd
+};
+
+struct ProfileEvent {
+	const char* name;
+	uint64_t start;			// nanoseconds since the profiler started
+	uint64_t duration;
+	uint64_t flowId;
+	ProfileEventType type;
+};
+
+class Profiler
+{
+public:
+	static uint64_t now();
+
+	static void setEnabled(bool enabled) { Profiler::enabled.store(enabled, std::memory_order_relaxed); }
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	static void recordZone(const char* name, uint64_t start, uint64_t end);
+	static void recordFlow(const char* name, uint64_t id, bool begin);
+	static void setThreadName(const char* name);
+
+	// safe to call while other threads are still recording, events recorded during the write may be missed
+	static bool writeChromeTrace(const std::string& path);
+	// disables recording and frees every thread's events. Call once no other thread is recording
+	static void shutdown();
+
+private:
+	static const uint32_t EVENTS_PER_BLOCK = 4096;
+	static const uint32_t MAX_BLOCKS_PER_THREAD = 64;		// 10 MB of events
+
+	// only the owning thread appends. It fills an event then publishes it by incrementing count (release), so readers
+	// (acquire) only see complete events without either side locking
+	struct Block {
+		ProfileEvent events[EVENTS_PER_BLOCK];
+		std::atomic<uint32_t> count{ 0 };
+		std::atomic<Block*> next{ nullptr };
+	};
+
+	struct ThreadBuffer {
+		Block* first;
+		Block* last;		// only touched by the owning thread
+		uint32_t blockCount;
+		std::atomic<uint64_t> droppedCount{ 0 };
+		uint32_t threadIndex;
+		std::atomic<const char*> name{ nullptr };
+	};
+
+	// the registry is only locked once per thread, on its first event, and when writing the trace
+	static std::atomic<bool> enabled;
+	static std::mutex registryMutex;
+	static std::vector<ThreadBuffer*> threadBuffers;
+	static const std::chrono::steady_clock::time_point epoch;
+
+	static ThreadBuffer& getThreadBuffer();
+	static void append(const ProfileEvent& event);
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name) :
+		name(Profiler::isEnabled() ? name : nullptr), start(this->name != nullptr ? Profiler::now() : 0) {}
+	~ProfileZone()
+	{
+		if (name != nullptr)
+		{
+			Profiler::recordZone(name, start, Profiler::now());
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name;		// null if the profiler was disabled when the zone began
+	uint64_t start;
+};
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_FLOW_BEGIN(name, id) ((void)0)
+#define PROFILE_FLOW_END(name, id) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "QueueTimeline.h"
+
+#include <limits>
+
+#include "Profiler.h"
+
+QueueTimeline::QueueTimeline()
+{
+}
+
+QueueTimeline::~QueueTimeline()
+{
+}
+
+void QueueTimeline::create(VkDevice logicalDevice, VkQueue queue)
+{
+	this->logicalDevice = logicalDevice;
+	this->queue = queue;
+
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+	semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+	VkResult result = vkCreateSemaphore(logicalDevice, &semaphoreCreateInfo, nullptr, &semaphore);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+
+	submittedValue.store(0);
+	completedValue.store(0);
+}
+
+void QueueTimeline::destroy()
+{
+	if (semaphore == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	wait(getLastSubmittedValue());
+	vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t QueueTimeline::submit(const VkSubmitInfo& submitInfo, const uint64_t* waitValues)
+{
+	// the timeline goes last, binary semaphores ignore their value
+	std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+	signalSemaphores.push_back(semaphore);
+	std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+	std::vector<uint64_t> semaphoreWaitValues(submitInfo.waitSemaphoreCount, 0);
+	if (waitValues != nullptr)
+	{
+		semaphoreWaitValues.assign(waitValues, waitValues + submitInfo.waitSemaphoreCount);
+	}
+
+	// values have to increase in the order the queue sees the submissions, so both happen under the lock
+	std::lock_guard<std::mutex> lock(submitMutex);
+	uint64_t value = submittedValue.load(std::memory_order_relaxed) + 1;
+	signalValues.back() = value;
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.pNext = submitInfo.pNext;
+	timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(semaphoreWaitValues.size());
+	timelineSubmitInfo.pWaitSemaphoreValues = semaphoreWaitValues.data();
+	timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+	VkSubmitInfo timelineSubmit = submitInfo;
+	timelineSubmit.pNext = &timelineSubmitInfo;
+	timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+	timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+
+	VkResult result = vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit to queue!");
+	}
+
+	submittedValue.store(value, std::memory_order_release);
+	return value;
+}
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+	uint64_t value = 0;
+	VkResult result = vkGetSemaphoreCounterValue(logicalDevice, semaphore, &value);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to read timeline semaphore!");
+	}
+
+	advanceCompletedValue(value);
+	return value;
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+	if (isComplete(value))
+	{
+		return;
+	}
+
+	PROFILE_ZONE("Wait for timeline");
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	VkResult result = vkWaitSemaphores(logicalDevice, &waitInfo, std::numeric_limits<uint64_t>::max());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to wait for timeline semaphore!");
+	}
+
+	advanceCompletedValue(value);
+}
+
+void QueueTimeline::advanceCompletedValue(uint64_t value)
+{
+	// other threads may have read a newer value in the meantime, keep the highest
+	uint64_t completed = completedValue.load(std::memory_order_relaxed);
+	while (completed < value && !completedValue.compare_exchange_weak(completed, value, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// A queue with a timeline semaphore that every submission to it signals with the next value. A submission is finished
+// once the semaphore reaches its value, so any submission (frame, upload or readback) can be checked without blocking or
+// waited on without waiting for anything submitted after it. Submissions to the queue have to go through here
+class QueueTimeline
+{
+public:
+	QueueTimeline();
+	~QueueTimeline();
+
+	void create(VkDevice logicalDevice, VkQueue queue);
+	void destroy();
+
+	// signals the timeline after the submission's own signal semaphores and returns the value it will reach. Thread safe,
+	// which also covers the queue's external synchronisation. waitValues has one value per wait semaphore, only read for
+	// timeline semaphores such as another queue's, so a submission can wait on that queue's submissions
+	uint64_t submit(const VkSubmitInfo& submitInfo, const uint64_t* waitValues = nullptr);
+
+	// value reached so far, never blocks
+	uint64_t getCompletedValue();
+	bool isComplete(uint64_t value) { return value <= completedValue.load(std::memory_order_acquire) || value <= getCompletedValue(); }
+	// blocks until the timeline reaches value, returns straight away if it already has
+	void wait(uint64_t value);
+
+	uint64_t getLastSubmittedValue() const { return submittedValue.load(std::memory_order_acquire); }
+	VkQueue getQueue() const { return queue; }
+	VkSemaphore getSemaphore() const { return semaphore; }
+
+private:
+	VkDevice logicalDevice = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+
+	std::mutex submitMutex;
+	std::atomic<uint64_t> submittedValue{ 0 };
+	std::atomic<uint64_t> completedValue{ 0 };		// last value read back, saves a driver call for older values
+
+	void advanceCompletedValue(uint64_t value);
+};
\ No newline at end of file
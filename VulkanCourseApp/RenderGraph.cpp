@@ -0,0 +1,986 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+struct AccessInfo {
+	VkPipelineStageFlags2 stages;
+	VkAccessFlags2 access;
+	VkImageLayout layout;
+};
+
+static const VkAccessFlags2 WRITE_ACCESS_MASK = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+	VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static AccessInfo getAccessInfo(RenderGraphAccess access, bool isDepth)
+{
+	VkImageLayout sampledLayout = isDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	switch (access)
+	{
+	case RenderGraphAccess::TransferRead:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	case RenderGraphAccess::TransferWrite:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+	case RenderGraphAccess::IndirectRead:
+		return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+	case RenderGraphAccess::VertexShaderRead:
+		return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, sampledLayout };
+	case RenderGraphAccess::ComputeRead:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case RenderGraphAccess::ComputeWrite:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL };
+	case RenderGraphAccess::ComputeSampled:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, sampledLayout };
+	case RenderGraphAccess::FragmentSampled:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, sampledLayout };
+	case RenderGraphAccess::ColourAttachment:
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	case RenderGraphAccess::DepthAttachment:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	case RenderGraphAccess::DepthAttachmentRead:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+	case RenderGraphAccess::ResolveAttachment:
+		// resolves happen at the end of rendering in the colour output stage, depth resolves are also ordered like depth writes
+		if (isDepth)
+		{
+			return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		}
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	case RenderGraphAccess::Present:
+		// the stage the acquire semaphore is waited on, so the next frame's first transition is ordered after it
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+	default:
+		return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+	}
+}
+
+static VkImageUsageFlags getImageUsage(RenderGraphAccess access, bool isDepth)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::TransferRead:
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	case RenderGraphAccess::TransferWrite:
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	case RenderGraphAccess::ComputeRead:
+		return VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	case RenderGraphAccess::ComputeWrite:
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	case RenderGraphAccess::VertexShaderRead:
+	case RenderGraphAccess::ComputeSampled:
+	case RenderGraphAccess::FragmentSampled:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case RenderGraphAccess::ColourAttachment:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case RenderGraphAccess::DepthAttachment:
+	case RenderGraphAccess::DepthAttachmentRead:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case RenderGraphAccess::ResolveAttachment:
+		return isDepth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	default:
+		return 0;
+	}
+}
+
+static bool isAttachment(RenderGraphAccess access)
+{
+	return access == RenderGraphAccess::ColourAttachment || access == RenderGraphAccess::DepthAttachment ||
+		access == RenderGraphAccess::DepthAttachmentRead;
+}
+
+// lazily allocated memory is only committed if a tiled GPU actually has to spill the attachment, desktop GPUs don't have it
+static bool findLazyMemoryType(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, uint32_t& typeIndex)
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if ((allowedTypes & (1 << i)) &&
+			(memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
+		{
+			typeIndex = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static VkImageAspectFlags getAspectFlags(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+RenderGraph::RenderGraph()
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+}
+
+void RenderGraph::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+{
+	this->physicalDevice = physicalDevice;
+	this->logicalDevice = logicalDevice;
+}
+
+void RenderGraph::destroy()
+{
+	for (const Resource& resource : resources)
+	{
+		if (resource.imported)
+		{
+			continue;
+		}
+
+		for (const VkImageView imageView : resource.imageViews)
+		{
+			vkDestroyImageView(logicalDevice, imageView, nullptr);
+		}
+		for (const VkImage image : resource.images)
+		{
+			vkDestroyImage(logicalDevice, image, nullptr);
+		}
+	}
+
+	for (const MemoryBlock& block : memoryBlocks)
+	{
+		MemoryTelemetry::get().release(logicalDevice, block.memory);
+	}
+
+	resources.clear();
+	passes.clear();
+	memoryBlocks.clear();
+	passBarriers.clear();
+	passAttachmentOps.clear();
+	finalBarriers.clear();
+	compiled = false;
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples,
+	uint32_t layers)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.format = format;
+	resource.extent = extent;
+	resource.samples = samples;
+	resource.layers = layers;
+	resource.aspect = getAspectFlags(format);
+	resource.preserveContents = false;
+	resource.finalAccess = RenderGraphAccess::None;
+	resource.aliasPredecessor = static_cast<RenderGraphResource>(resources.size());
+
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkFormat format, VkExtent2D extent, const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& imageViews, bool preserveContents, RenderGraphAccess finalAccess)
+{
+	if (images.empty() || images.size() != imageViews.size())
+	{
+		throw std::runtime_error("Imported render graph image needs one view per image!");
+	}
+
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.format = format;
+	resource.extent = extent;
+	resource.samples = VK_SAMPLE_COUNT_1_BIT;
+	resource.layers = 1;
+	resource.aspect = getAspectFlags(format);
+	resource.images = images;
+	resource.imageViews = imageViews;
+	resource.preserveContents = preserveContents;
+	resource.finalAccess = finalAccess;
+
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.buffer = buffer;
+	resource.offset = offset;
+	resource.size = size;
+	resource.preserveContents = true;
+	resource.finalAccess = RenderGraphAccess::None;
+
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+void RenderGraph::setImportedBuffer(RenderGraphResource resource, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	Resource& bufferResource = resources[resource];
+	if (bufferResource.isImage || !bufferResource.imported)
+	{
+		throw std::runtime_error("Render graph resource " + bufferResource.name + " isn't an imported buffer!");
+	}
+
+	bufferResource.buffer = buffer;
+	bufferResource.offset = offset;
+	bufferResource.size = size;
+}
+
+RenderGraphPass RenderGraph::addPass(const std::string& name, RenderGraphPassType type,
+	std::function<void(VkCommandBuffer commandBuffer, uint32_t frameIndex)> execute)
+{
+	if (compiled)
+	{
+		throw std::runtime_error("Can't add passes to a compiled render graph!");
+	}
+
+	Pass pass = {};
+	pass.name = name;
+	pass.type = type;
+	pass.execute = std::move(execute);
+	pass.culled = false;
+	pass.secondaryContents = false;
+	pass.viewMask = 0;
+
+	passes.push_back(pass);
+	return static_cast<RenderGraphPass>(passes.size() - 1);
+}
+
+void RenderGraph::read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	for (const ResourceUse& use : passes[pass].uses)
+	{
+		if (use.resource == resource)
+		{
+			throw std::runtime_error("Render graph pass " + passes[pass].name + " uses " + resources[resource].name + " twice!");
+		}
+	}
+
+	ResourceUse use = {};
+	use.resource = resource;
+	use.access = access;
+	use.isWrite = false;
+	use.clear = false;
+	use.resolveSource = resource;
+	use.resolveMode = VK_RESOLVE_MODE_NONE;
+	passes[pass].uses.push_back(use);
+}
+
+void RenderGraph::write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access, const VkClearValue* clearValue)
+{
+	read(pass, resource, access);
+
+	ResourceUse& use = passes[pass].uses.back();
+	use.isWrite = true;
+	if (clearValue != nullptr)
+	{
+		use.clear = true;
+		use.clearValue = *clearValue;
+	}
+}
+
+void RenderGraph::setSecondaryContents(RenderGraphPass pass)
+{
+	if (passes[pass].type != RenderGraphPassType::Raster)
+	{
+		throw std::runtime_error("Render graph pass " + passes[pass].name + " isn't a raster pass, so can't have secondary contents!");
+	}
+
+	passes[pass].secondaryContents = true;
+}
+
+void RenderGraph::setViewMask(RenderGraphPass pass, uint32_t viewMask)
+{
+	if (passes[pass].type != RenderGraphPassType::Raster)
+	{
+		throw std::runtime_error("Render graph pass " + passes[pass].name + " isn't a raster pass, so can't have a view mask!");
+	}
+
+	passes[pass].viewMask = viewMask;
+}
+
+void RenderGraph::resolve(RenderGraphPass pass, RenderGraphResource source, RenderGraphResource destination,
+	VkResolveModeFlagBits resolveMode)
+{
+	bool sourceIsAttachment = false;
+	for (const ResourceUse& use : passes[pass].uses)
+	{
+		sourceIsAttachment = sourceIsAttachment || (use.resource == source && isAttachment(use.access));
+	}
+
+	if (passes[pass].type != RenderGraphPassType::Raster || !sourceIsAttachment)
+	{
+		throw std::runtime_error("Render graph pass " + passes[pass].name + " can only resolve one of its attachments!");
+	}
+	if (resources[source].samples == VK_SAMPLE_COUNT_1_BIT || resources[destination].samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		throw std::runtime_error("Render graph can only resolve " + resources[source].name + " from multisampled to single sampled!");
+	}
+
+	write(pass, destination, RenderGraphAccess::ResolveAttachment);
+
+	ResourceUse& use = passes[pass].uses.back();
+	use.resolveSource = source;
+	use.resolveMode = resolveMode;
+}
+
+void RenderGraph::compile()
+{
+	cullPasses();
+	createTransientImages();
+	computeBarriers();
+	computeAttachmentOps();
+	compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+	// walk backwards from the imported resources, a pass survives if it writes something a later survivor (or the
+	// outside world) needs
+	std::vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		needed[i] = resources[i].imported;
+	}
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		Pass& pass = passes[i];
+
+		pass.culled = true;
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.isWrite && needed[use.resource])
+			{
+				pass.culled = false;
+			}
+		}
+
+		if (!pass.culled)
+		{
+			for (const ResourceUse& use : pass.uses)
+			{
+				needed[use.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::createTransientImages()
+{
+	std::vector<RenderGraphResource> transients;
+	std::vector<VkMemoryRequirements> memoryRequirements(resources.size());
+
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		Resource& resource = resources[i];
+		if (resource.imported)
+		{
+			continue;
+		}
+
+		resource.firstUse = static_cast<uint32_t>(passes.size());
+		resource.lastUse = 0;
+		resource.usage = 0;
+		for (size_t j = 0; j < passes.size(); j++)
+		{
+			if (passes[j].culled)
+			{
+				continue;
+			}
+
+			for (const ResourceUse& use : passes[j].uses)
+			{
+				if (use.resource == i)
+				{
+					resource.firstUse = std::min(resource.firstUse, static_cast<uint32_t>(j));
+					resource.lastUse = std::max(resource.lastUse, static_cast<uint32_t>(j));
+					resource.usage |= getImageUsage(use.access, (resource.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0);
+				}
+			}
+		}
+
+		// only used by culled passes
+		if (resource.usage == 0)
+		{
+			continue;
+		}
+
+		// nothing but rendering ever touches it, e.g. multisampled attachments that are resolved
+		resource.lazy = (resource.usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) == 0;
+		if (resource.lazy)
+		{
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent.width = resource.extent.width;
+		imageCreateInfo.extent.height = resource.extent.height;
+		imageCreateInfo.extent.depth = 1;
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = resource.layers;
+		imageCreateInfo.format = resource.format;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = resource.usage;
+		imageCreateInfo.samples = resource.samples;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImage image;
+		VkResult result = vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &image);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph image " + resource.name + "!");
+		}
+		resource.images.push_back(image);
+
+		vkGetImageMemoryRequirements(logicalDevice, image, &memoryRequirements[i]);
+		transients.push_back(static_cast<RenderGraphResource>(i));
+	}
+
+	// largest first, each image goes into the first block whose occupants are all dead or not yet born while it's alive
+	std::sort(transients.begin(), transients.end(), [&memoryRequirements](RenderGraphResource a, RenderGraphResource b) {
+		return memoryRequirements[a].size > memoryRequirements[b].size;
+	});
+
+	VkDeviceSize unaliasedSize = 0;
+	for (const RenderGraphResource transient : transients)
+	{
+		Resource& resource = resources[transient];
+		const VkMemoryRequirements& requirements = memoryRequirements[transient];
+		unaliasedSize += requirements.size;
+
+		resource.memoryBlock = static_cast<uint32_t>(memoryBlocks.size());
+		for (size_t i = 0; i < memoryBlocks.size(); i++)
+		{
+			MemoryBlock& block = memoryBlocks[i];
+			if ((block.memoryTypeBits & requirements.memoryTypeBits) == 0 || block.lazy != resource.lazy)
+			{
+				continue;
+			}
+
+			bool overlaps = false;
+			for (const RenderGraphResource occupant : block.occupants)
+			{
+				if (resources[occupant].firstUse <= resource.lastUse && resource.firstUse <= resources[occupant].lastUse)
+				{
+					overlaps = true;
+					break;
+				}
+			}
+
+			if (!overlaps)
+			{
+				resource.memoryBlock = static_cast<uint32_t>(i);
+				break;
+			}
+		}
+
+		if (resource.memoryBlock == memoryBlocks.size())
+		{
+			MemoryBlock block = {};
+			block.memoryTypeBits = requirements.memoryTypeBits;
+			block.lazy = resource.lazy;
+			memoryBlocks.push_back(block);
+		}
+
+		// every occupant is bound at offset 0, so the block has to satisfy the largest size and alignment
+		MemoryBlock& block = memoryBlocks[resource.memoryBlock];
+		block.size = std::max(block.size, (requirements.size + requirements.alignment - 1) / requirements.alignment * requirements.alignment);
+		block.memoryTypeBits &= requirements.memoryTypeBits;
+		block.occupants.push_back(transient);
+	}
+
+	VkDeviceSize aliasedSize = 0;
+	VkDeviceSize lazySize = 0;
+	for (MemoryBlock& block : memoryBlocks)
+	{
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.allocationSize = block.size;
+
+		if (block.lazy && findLazyMemoryType(physicalDevice, block.memoryTypeBits, memoryAllocateInfo.memoryTypeIndex))
+		{
+			lazySize += block.size;
+		}
+		else
+		{
+			memoryAllocateInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+
+		VkResult result = MemoryTelemetry::get().allocate(logicalDevice, memoryAllocateInfo, MemoryCategory::RenderTarget, &block.memory);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate render graph memory!");
+		}
+		aliasedSize += block.size;
+
+		// in order of use within the frame, the first occupant follows the last one from the previous frame
+		std::sort(block.occupants.begin(), block.occupants.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+			return resources[a].firstUse < resources[b].firstUse;
+		});
+
+		for (size_t i = 0; i < block.occupants.size(); i++)
+		{
+			Resource& resource = resources[block.occupants[i]];
+			resource.aliasPredecessor = block.occupants[(i + block.occupants.size() - 1) % block.occupants.size()];
+
+			vkBindImageMemory(logicalDevice, resource.images[0], block.memory, 0);
+
+			VkImageViewCreateInfo viewCreateInfo = {};
+			viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewCreateInfo.image = resource.images[0];
+			viewCreateInfo.viewType = resource.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			viewCreateInfo.format = resource.format;
+			viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+			viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+			// views of depth/stencil images used for sampling may only have one aspect
+			viewCreateInfo.subresourceRange.aspectMask = (resource.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0 ? VK_IMAGE_ASPECT_DEPTH_BIT :
+				resource.aspect;
+			viewCreateInfo.subresourceRange.baseMipLevel = 0;
+			viewCreateInfo.subresourceRange.levelCount = 1;
+			viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+			viewCreateInfo.subresourceRange.layerCount = resource.layers;
+
+			VkImageView imageView;
+			VkResult result = vkCreateImageView(logicalDevice, &viewCreateInfo, nullptr, &imageView);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image view " + resource.name + "!");
+			}
+			resource.imageViews.push_back(imageView);
+		}
+	}
+
+	uint32_t culledPasses = 0;
+	for (const Pass& pass : passes)
+	{
+		culledPasses += pass.culled ? 1 : 0;
+	}
+
+	printf("Render graph: %zu passes (%u culled), %zu transient images in %zu allocations, %.1f MB (%.1f MB without aliasing, "
+		"%.1f MB lazily allocated)\n", passes.size(), culledPasses, transients.size(), memoryBlocks.size(), aliasedSize / (1024.0 * 1024.0),
+		unaliasedSize / (1024.0 * 1024.0), lazySize / (1024.0 * 1024.0));
+}
+
+void RenderGraph::computeBarriers()
+{
+	// the first walk finds the state each resource ends the frame in, which is the state it starts the next frame in
+	ResourceState emptyState = {};
+	emptyState.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	std::vector<ResourceState> endStates(resources.size(), emptyState);
+	walkPasses(endStates, false);
+
+	std::vector<ResourceState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		states[i] = getInitialState(static_cast<RenderGraphResource>(i), endStates);
+	}
+	walkPasses(states, true);
+}
+
+void RenderGraph::walkPasses(std::vector<ResourceState>& states, bool recordBarriers)
+{
+	passBarriers.assign(passes.size(), std::vector<Barrier>());
+	finalBarriers.clear();
+
+	Barrier barrier;
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		if (passes[i].culled)
+		{
+			continue;
+		}
+
+		for (const ResourceUse& use : passes[i].uses)
+		{
+			if (transition(use.resource, states[use.resource], use.access, use.isWrite, barrier) && recordBarriers)
+			{
+				passBarriers[i].push_back(barrier);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		if (resources[i].finalAccess == RenderGraphAccess::None)
+		{
+			continue;
+		}
+
+		RenderGraphResource resource = static_cast<RenderGraphResource>(i);
+		if (transition(resource, states[resource], resources[i].finalAccess, false, barrier) && recordBarriers)
+		{
+			finalBarriers.push_back(barrier);
+		}
+	}
+}
+
+RenderGraph::ResourceState RenderGraph::getInitialState(RenderGraphResource resource, const std::vector<ResourceState>& endStates) const
+{
+	const Resource& description = resources[resource];
+
+	// transient images wait for whatever last used their memory (themselves last frame if nothing else shares it)
+	ResourceState state = endStates[description.imported ? resource : description.aliasPredecessor];
+	if (!description.preserveContents)
+	{
+		state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	state.visibleStages = 0;
+	state.visibleAccess = 0;
+
+	return state;
+}
+
+bool RenderGraph::transition(RenderGraphResource resource, ResourceState& state, RenderGraphAccess access, bool isWrite,
+	Barrier& barrier) const
+{
+	const Resource& description = resources[resource];
+	AccessInfo info = getAccessInfo(access, (description.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0);
+	VkImageLayout layout = description.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+	barrier.resource = resource;
+	barrier.srcStages = VK_PIPELINE_STAGE_2_NONE;
+	barrier.srcAccess = VK_ACCESS_2_NONE;
+	barrier.dstStages = info.stages;
+	barrier.dstAccess = info.access;
+	barrier.oldLayout = state.layout;
+	barrier.newLayout = layout;
+
+	bool layoutChange = layout != state.layout;
+	if (isWrite || layoutChange)
+	{
+		// wait for earlier writes and reads (and make earlier writes available), a layout transition counts as a write
+		barrier.srcStages = state.writeStages | state.readStages;
+		barrier.srcAccess = state.writeAccess;
+		bool needed = layoutChange || barrier.srcStages != VK_PIPELINE_STAGE_2_NONE;
+
+		state.writeStages = info.stages;
+		state.writeAccess = isWrite ? info.access & WRITE_ACCESS_MASK : VK_ACCESS_2_NONE;
+		state.readStages = VK_PIPELINE_STAGE_2_NONE;
+		state.visibleStages = isWrite ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+		state.visibleAccess = isWrite ? VK_ACCESS_2_NONE : info.access;
+		state.layout = layout;
+		return needed;
+	}
+
+	// reads only need a barrier if the last write isn't visible to them yet, and never wait on other reads
+	bool needed = false;
+	if (state.writeStages != VK_PIPELINE_STAGE_2_NONE &&
+		((info.stages & ~state.visibleStages) != 0 || (info.access & ~state.visibleAccess) != 0))
+	{
+		barrier.srcStages = state.writeStages;
+		barrier.srcAccess = state.writeAccess;
+		needed = true;
+
+		state.visibleStages |= info.stages;
+		state.visibleAccess |= info.access;
+	}
+	state.readStages |= info.stages;
+
+	return needed;
+}
+
+void RenderGraph::computeAttachmentOps()
+{
+	passAttachmentOps.assign(passes.size(), std::vector<AttachmentOps>());
+
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		const Pass& pass = passes[i];
+		if (pass.culled || pass.type != RenderGraphPassType::Raster)
+		{
+			continue;
+		}
+
+		passAttachmentOps[i].resize(pass.uses.size());
+		for (size_t j = 0; j < pass.uses.size(); j++)
+		{
+			const ResourceUse& use = pass.uses[j];
+			const Resource& resource = resources[use.resource];
+			if (!isAttachment(use.access))
+			{
+				continue;
+			}
+
+			// load only if something earlier this frame (or a previous frame, for preserved images) produced the contents
+			bool hasContents = resource.imported && resource.preserveContents;
+			bool usedLater = resource.imported;
+			for (size_t k = 0; k < passes.size(); k++)
+			{
+				if (k == i || passes[k].culled)
+				{
+					continue;
+				}
+
+				for (const ResourceUse& other : passes[k].uses)
+				{
+					if (other.resource != use.resource)
+					{
+						continue;
+					}
+
+					hasContents = hasContents || (k < i && other.isWrite);
+					usedLater = usedLater || k > i;
+				}
+			}
+
+			AttachmentOps& ops = passAttachmentOps[i][j];
+			if (use.clear)
+			{
+				ops.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			}
+			else
+			{
+				ops.loadOp = hasContents || !use.isWrite ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			}
+
+			if (!use.isWrite)
+			{
+				ops.storeOp = VK_ATTACHMENT_STORE_OP_NONE;
+			}
+			else
+			{
+				ops.storeOp = usedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			}
+		}
+	}
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D renderExtent, RenderGraphPass firstPass,
+	RenderGraphPass endPass) const
+{
+	if (!compiled)
+	{
+		throw std::runtime_error("Render graph must be compiled before it is executed!");
+	}
+
+	endPass = std::min(endPass, static_cast<RenderGraphPass>(passes.size()));
+	for (size_t i = firstPass; i < endPass; i++)
+	{
+		const Pass& pass = passes[i];
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		recordBarriers(commandBuffer, passBarriers[i], frameIndex);
+
+		if (pass.type != RenderGraphPassType::Raster)
+		{
+			pass.execute(commandBuffer, frameIndex);
+			continue;
+		}
+
+		std::vector<VkRenderingAttachmentInfo> colourAttachments;
+		std::vector<RenderGraphResource> colourResources;
+		VkRenderingAttachmentInfo depthAttachment = {};
+		RenderGraphResource depthResource = 0;
+		bool hasDepth = false;
+		VkExtent2D extent = { 0, 0 };
+
+		for (size_t j = 0; j < pass.uses.size(); j++)
+		{
+			const ResourceUse& use = pass.uses[j];
+			if (!isAttachment(use.access))
+			{
+				continue;
+			}
+
+			VkRenderingAttachmentInfo attachment = {};
+			attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			attachment.imageView = getImageView(use.resource, frameIndex);
+			attachment.imageLayout = getAccessInfo(use.access, (resources[use.resource].aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0).layout;
+			attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+			attachment.loadOp = passAttachmentOps[i][j].loadOp;
+			attachment.storeOp = passAttachmentOps[i][j].storeOp;
+			attachment.clearValue = use.clearValue;
+
+			extent = resources[use.resource].extent;
+
+			if (use.access == RenderGraphAccess::ColourAttachment)
+			{
+				colourAttachments.push_back(attachment);
+				colourResources.push_back(use.resource);
+			}
+			else
+			{
+				depthAttachment = attachment;
+				depthResource = use.resource;
+				hasDepth = true;
+			}
+		}
+
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (use.access != RenderGraphAccess::ResolveAttachment)
+			{
+				continue;
+			}
+
+			// resolve() made sure the source is one of this pass's attachments
+			VkRenderingAttachmentInfo* attachment = &depthAttachment;
+			if (!hasDepth || depthResource != use.resolveSource)
+			{
+				size_t index = std::find(colourResources.begin(), colourResources.end(), use.resolveSource) - colourResources.begin();
+				attachment = &colourAttachments[index];
+			}
+
+			bool isDepth = (resources[use.resource].aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+			attachment->resolveMode = use.resolveMode;
+			attachment->resolveImageView = getImageView(use.resource, frameIndex);
+			attachment->resolveImageLayout = getAccessInfo(use.access, isDepth).layout;
+		}
+
+		if (renderExtent.width != 0 && renderExtent.height != 0)
+		{
+			extent.width = std::min(extent.width, renderExtent.width);
+			extent.height = std::min(extent.height, renderExtent.height);
+		}
+
+		VkRenderingInfo renderingInfo = {};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.flags = pass.secondaryContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = extent;
+		renderingInfo.layerCount = 1;			// ignored by multiview passes
+		renderingInfo.viewMask = pass.viewMask;
+		renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colourAttachments.size());
+		renderingInfo.pColorAttachments = colourAttachments.data();
+		renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+
+		VkViewport viewport = {};
+		viewport.x = 0.f;
+		viewport.y = 0.f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.f;
+		viewport.maxDepth = 1.f;
+
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+			// state doesn't carry into secondary command buffers
+			if (!pass.secondaryContents)
+			{
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &renderingInfo.renderArea);
+			}
+			pass.execute(commandBuffer, frameIndex);
+
+		vkCmdEndRendering(commandBuffer);
+	}
+
+	if (endPass == passes.size())
+	{
+		recordBarriers(commandBuffer, finalBarriers, frameIndex);
+	}
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource, uint32_t frameIndex) const
+{
+	const std::vector<VkImage>& images = resources[resource].images;
+	return images[std::min(static_cast<size_t>(frameIndex), images.size() - 1)];
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource, uint32_t frameIndex) const
+{
+	const std::vector<VkImageView>& imageViews = resources[resource].imageViews;
+	return imageViews[std::min(static_cast<size_t>(frameIndex), imageViews.size() - 1)];
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, uint32_t frameIndex) const
+{
+	if (barriers.empty())
+	{
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+
+	for (const Barrier& barrier : barriers)
+	{
+		const Resource& resource = resources[barrier.resource];
+
+		if (resource.isImage)
+		{
+			VkImageMemoryBarrier2 imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			imageBarrier.srcStageMask = barrier.srcStages;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstStageMask = barrier.dstStages;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = getImage(barrier.resource, frameIndex);
+			imageBarrier.subresourceRange.aspectMask = resource.aspect;
+			imageBarrier.subresourceRange.baseMipLevel = 0;
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			imageBarriers.push_back(imageBarrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier2 bufferBarrier = {};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			bufferBarrier.srcStageMask = barrier.srcStages;
+			bufferBarrier.srcAccessMask = barrier.srcAccess;
+			bufferBarrier.dstStageMask = barrier.dstStages;
+			bufferBarrier.dstAccessMask = barrier.dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.offset = resource.offset;
+			bufferBarrier.size = resource.size;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+	dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+	dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+	dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
\ No newline at end of file
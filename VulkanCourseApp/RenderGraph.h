@@ -0,0 +1,205 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Utilities.h"
+
+typedef uint32_t RenderGraphResource;
+typedef uint32_t RenderGraphPass;
+
+// how a pass uses a resource, each maps to a pipeline stage, access mask and (for images) layout
+enum class RenderGraphAccess {
+	None,
+	TransferRead,
+	TransferWrite,
+	IndirectRead,
+	VertexShaderRead,
+	ComputeRead,			// storage buffer, or storage/sampled image in VK_IMAGE_LAYOUT_GENERAL
+	ComputeWrite,			// storage buffer or storage image, including read-modify-write
+	ComputeSampled,			// sampled image in a read only layout
+	FragmentSampled,
+	ColourAttachment,
+	DepthAttachment,
+	DepthAttachmentRead,	// depth test without writes
+	ResolveAttachment,		// destination of a multisample resolve at the end of a raster pass
+	Present
+};
+
+enum class RenderGraphPassType {
+	Raster,			// recorded inside dynamic rendering over the pass's attachments
+	Compute,
+	Transfer
+};
+
+// Passes declare the resources they read and write, in submission order. compile() then:
+// - culls passes whose results are never used (imported resources always count as used)
+// - derives the layout transitions and the narrowest pipeline barriers between passes, including across frames
+// - places transient images whose lifetimes don't overlap in the same memory. Images only ever used as attachments are
+//   created as transient attachments in lazily allocated memory where the device has it, so on tiled GPUs they may never
+//   need backing memory
+// execute() records the barriers and passes, and can be called from several threads for different frames at once. Raster
+// passes set their viewport and scissor dynamically, so their pipelines must use dynamic viewport and scissor state. Passes
+// with secondary contents only execute secondary command buffers, which have to set those themselves
+class RenderGraph
+{
+public:
+	RenderGraph();
+	~RenderGraph();
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+	void destroy();
+
+	// owned by the graph, contents only live within a frame. Images with more than one layer are viewed as arrays, which
+	// multiview passes render all their views into at once
+	RenderGraphResource createImage(const std::string& name, VkFormat format, VkExtent2D extent,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, uint32_t layers = 1);
+
+	// owned by the caller, one image per frame index (or a single image for all of them). Preserved images keep their
+	// contents and layout between frames, others start each frame undefined. A final access is applied at the end of the frame
+	RenderGraphResource importImage(const std::string& name, VkFormat format, VkExtent2D extent, const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& imageViews, bool preserveContents, RenderGraphAccess finalAccess = RenderGraphAccess::None);
+	RenderGraphResource importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	// points an imported buffer at a replacement, e.g. after it was reallocated. Barriers only depend on how the passes use
+	// it, so nothing is recompiled, but command buffers recorded before this still use the old buffer
+	void setImportedBuffer(RenderGraphResource resource, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	RenderGraphPass addPass(const std::string& name, RenderGraphPassType type,
+		std::function<void(VkCommandBuffer commandBuffer, uint32_t frameIndex)> execute);
+	void read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access);
+	void write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access, const VkClearValue* clearValue = nullptr);
+
+	// the raster pass records nothing but vkCmdExecuteCommands, the secondaries inherit its attachment formats
+	void setSecondaryContents(RenderGraphPass pass);
+	// the raster pass renders each view in the mask into the attachment layer of the same index. Its pipelines and
+	// secondaries have to be created with the same view mask
+	void setViewMask(RenderGraphPass pass, uint32_t viewMask);
+
+	// resolves a multisampled attachment of a raster pass into a single sampled image when the pass ends
+	void resolve(RenderGraphPass pass, RenderGraphResource source, RenderGraphResource destination,
+		VkResolveModeFlagBits resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT);
+
+	void compile();
+	// raster passes only render to the top left renderExtent of their attachments (all of them if it's zero), so the
+	// resolution can change without recreating the graph. A frame can be split over several command buffers by executing
+	// consecutive ranges of passes [firstPass, endPass), the end of frame barriers go with the range that reaches the end
+	void execute(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D renderExtent = VkExtent2D{ 0, 0 },
+		RenderGraphPass firstPass = 0, RenderGraphPass endPass = UINT32_MAX) const;
+
+	VkImage getImage(RenderGraphResource resource, uint32_t frameIndex = 0) const;
+	VkImageView getImageView(RenderGraphResource resource, uint32_t frameIndex = 0) const;
+
+private:
+	struct ResourceUse {
+		RenderGraphResource resource;
+		RenderGraphAccess access;
+		bool isWrite;
+		bool clear;
+		VkClearValue clearValue;
+
+		// resolve destinations
+		RenderGraphResource resolveSource;
+		VkResolveModeFlagBits resolveMode;
+	};
+
+	struct Pass {
+		std::string name;
+		RenderGraphPassType type;
+		std::function<void(VkCommandBuffer, uint32_t)> execute;
+		std::vector<ResourceUse> uses;
+		bool culled;
+		bool secondaryContents;
+		uint32_t viewMask;
+	};
+
+	struct Resource {
+		std::string name;
+		bool isImage;
+		bool imported;
+
+		// images
+		VkFormat format;
+		VkExtent2D extent;
+		VkSampleCountFlagBits samples;
+		uint32_t layers;
+		VkImageAspectFlags aspect;
+		VkImageUsageFlags usage;
+		std::vector<VkImage> images;
+		std::vector<VkImageView> imageViews;
+		bool preserveContents;
+		RenderGraphAccess finalAccess;
+
+		// buffers
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+
+		// transient images
+		uint32_t firstUse;
+		uint32_t lastUse;
+		uint32_t memoryBlock;
+		bool lazy;									// only used as an attachment, so may live in lazily allocated memory
+		RenderGraphResource aliasPredecessor;		// previous occupant of the same memory, possibly itself from last frame
+	};
+
+	// synchronisation state of a resource while walking the passes
+	struct ResourceState {
+		VkPipelineStageFlags2 writeStages;
+		VkAccessFlags2 writeAccess;
+		VkPipelineStageFlags2 readStages;
+		VkPipelineStageFlags2 visibleStages;		// stages the last write has already been made visible to
+		VkAccessFlags2 visibleAccess;
+		VkImageLayout layout;
+	};
+
+	struct Barrier {
+		RenderGraphResource resource;
+		VkPipelineStageFlags2 srcStages;
+		VkAccessFlags2 srcAccess;
+		VkPipelineStageFlags2 dstStages;
+		VkAccessFlags2 dstAccess;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+	};
+
+	struct AttachmentOps {
+		VkAttachmentLoadOp loadOp;
+		VkAttachmentStoreOp storeOp;
+	};
+
+	struct MemoryBlock {
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint32_t memoryTypeBits;
+		bool lazy;
+		std::vector<RenderGraphResource> occupants;
+	};
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice logicalDevice;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<MemoryBlock> memoryBlocks;
+
+	// filled by compile()
+	std::vector<std::vector<Barrier>> passBarriers;
+	std::vector<std::vector<AttachmentOps>> passAttachmentOps;		// matches the pass's uses, only set for attachments
+	std::vector<Barrier> finalBarriers;
+	bool compiled = false;
+
+	void cullPasses();
+	void createTransientImages();
+	void computeBarriers();
+	void computeAttachmentOps();
+	void walkPasses(std::vector<ResourceState>& states, bool recordBarriers);
+
+	ResourceState getInitialState(RenderGraphResource resource, const std::vector<ResourceState>& endStates) const;
+	bool transition(RenderGraphResource resource, ResourceState& state, RenderGraphAccess access, bool isWrite, Barrier& barrier) const;
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, uint32_t frameIndex) const;
+};
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define SCENE_USE_SSE
+#endif
+
+// below this many nodes per batch, scheduling costs more than the transforms
+const uint32_t MIN_NODES_PER_BATCH = 1024;
+
+static glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+
+	glm::mat4 transform;
+	transform[0] = glm::vec4(rotationMatrix[0] * scale.x, 0.f);
+	transform[1] = glm::vec4(rotationMatrix[1] * scale.y, 0.f);
+	transform[2] = glm::vec4(rotationMatrix[2] * scale.z, 0.f);
+	transform[3] = glm::vec4(position, 1.f);
+	return transform;
+}
+
+static void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+#ifdef SCENE_USE_SSE
+	// each column of the result is the columns of a weighted by the matching column of b
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+	for (int i = 0; i < 4; i++)
+	{
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[i][0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[i][1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[i][2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[i][3])));
+		_mm_storeu_ps(&result[i][0], column);
+	}
+#else
+	result = a * b;
+#endif
+}
+
+Scene::Scene()
+{
+}
+
+Scene::~Scene()
+{
+}
+
+uint32_t Scene::addNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale,
+	uint32_t mesh, const glm::vec4& localBounds)
+{
+	uint32_t node = getNodeCount();
+	if (parent != SCENE_NO_PARENT && parent >= node)
+	{
+		throw std::runtime_error("Scene node parent must be added before its children!");
+	}
+
+	localPositions.push_back(position);
+	localRotations.push_back(rotation);
+	localScales.push_back(scale);
+
+	parents.push_back(parent);
+	depths.push_back(parent == SCENE_NO_PARENT ? 0 : depths[parent] + 1);
+
+	worldMatrices.push_back(glm::mat4(1.f));
+	worldBounds.push_back(localBounds);
+
+	meshes.push_back(mesh);
+	this->localBounds.push_back(localBounds);
+
+	dirty.push_back(1);
+	updated.push_back(0);
+
+	depthOrderValid = false;
+
+	return node;
+}
+
+void Scene::clear()
+{
+	localPositions.clear();
+	localRotations.clear();
+	localScales.clear();
+	parents.clear();
+	depths.clear();
+	worldMatrices.clear();
+	worldBounds.clear();
+	meshes.clear();
+	localBounds.clear();
+	dirty.clear();
+	updated.clear();
+	depthOrderValid = false;
+}
+
+void Scene::setLocalPosition(uint32_t node, const glm::vec3& position)
+{
+	localPositions[node] = position;
+	dirty[node] = 1;
+}
+
+void Scene::setLocalRotation(uint32_t node, const glm::quat& rotation)
+{
+	localRotations[node] = rotation;
+	dirty[node] = 1;
+}
+
+void Scene::setLocalScale(uint32_t node, const glm::vec3& scale)
+{
+	localScales[node] = scale;
+	dirty[node] = 1;
+}
+
+void Scene::updateTransforms(JobSystem& jobSystem)
+{
+	if (!depthOrderValid)
+	{
+		buildDepthOrder();
+	}
+
+	// depth by depth, so a node's parent is always final before the node is updated
+	for (size_t depth = 0; depth + 1 < depthOffsets.size(); depth++)
+	{
+		const uint32_t* nodes = depthOrder.data() + depthOffsets[depth];
+		uint32_t count = depthOffsets[depth + 1] - depthOffsets[depth];
+
+		uint32_t batchCount = jobSystem.getThreadCount() * 4;
+		uint32_t batchSize = std::max(MIN_NODES_PER_BATCH, (count + batchCount - 1) / batchCount);
+
+		jobSystem.parallelFor(count, batchSize, [this, nodes](uint32_t start, uint32_t end) {
+			updateNodes(nodes + start, end - start);
+		});
+	}
+}
+
+void Scene::buildDepthOrder()
+{
+	// counting sort by depth
+	uint32_t maxDepth = 0;
+	for (const uint32_t depth : depths)
+	{
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	depthOffsets.assign(parents.empty() ? 1 : maxDepth + 2, 0);
+	for (const uint32_t depth : depths)
+	{
+		depthOffsets[depth + 1]++;
+	}
+	for (size_t i = 1; i < depthOffsets.size(); i++)
+	{
+		depthOffsets[i] += depthOffsets[i - 1];
+	}
+
+	depthOrder.resize(parents.size());
+	std::vector<uint32_t> next(depthOffsets.begin(), depthOffsets.end() - 1);
+	for (uint32_t node = 0; node < getNodeCount(); node++)
+	{
+		depthOrder[next[depths[node]]++] = node;
+	}
+
+	depthOrderValid = true;
+}
+
+void Scene::updateNodes(const uint32_t* nodes, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t node = nodes[i];
+		uint32_t parent = parents[node];
+
+		// a changed parent dirties the whole subtree, one depth at a time
+		uint8_t changed = static_cast<uint8_t>(dirty[node] | (parent != SCENE_NO_PARENT ? updated[parent] : 0));
+		updated[node] = changed;
+		dirty[node] = 0;
+
+		if (!changed)
+		{
+			continue;
+		}
+
+		glm::mat4 local = composeTransform(localPositions[node], localRotations[node], localScales[node]);
+		if (parent == SCENE_NO_PARENT)
+		{
+			worldMatrices[node] = local;
+		}
+		else
+		{
+			multiplyMatrices(worldMatrices[parent], local, worldMatrices[node]);
+		}
+
+		const glm::mat4& world = worldMatrices[node];
+		const glm::vec4& bounds = localBounds[node];
+		float scaleSquared = std::max(std::max(glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+			glm::dot(glm::vec3(world[1]), glm::vec3(world[1]))), glm::dot(glm::vec3(world[2]), glm::vec3(world[2])));
+		worldBounds[node] = glm::vec4(glm::vec3(world * glm::vec4(glm::vec3(bounds), 1.f)), bounds.w * std::sqrt(scaleSquared));
+	}
+}
\ No newline at end of file
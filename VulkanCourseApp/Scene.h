@@ -0,0 +1,75 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#include "JobSystem.h"
+
+const uint32_t SCENE_NO_PARENT = 0xFFFFFFFF;
+const uint32_t SCENE_NO_MESH = 0xFFFFFFFF;
+
+// Scene graph stored as structure of arrays, one entry per node in every array. Nodes can only be parented to nodes that
+// already exist, so parents always precede their children and a single ordered pass sees every parent before its children.
+// Only nodes whose own transform changed, or whose ancestor's did, recompute their world matrix
+class Scene
+{
+public:
+	Scene();
+	~Scene();
+
+	uint32_t addNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale,
+		uint32_t mesh = SCENE_NO_MESH, const glm::vec4& localBounds = glm::vec4(0.f));
+	void clear();
+
+	void setLocalPosition(uint32_t node, const glm::vec3& position);
+	void setLocalRotation(uint32_t node, const glm::quat& rotation);
+	void setLocalScale(uint32_t node, const glm::vec3& scale);
+
+	// recomputes world matrices and bounds of dirty subtrees, spread across the job system
+	void updateTransforms(JobSystem& jobSystem);
+
+	uint32_t getNodeCount() const { return static_cast<uint32_t>(parents.size()); }
+	uint32_t getParent(uint32_t node) const { return parents[node]; }
+	uint32_t getMesh(uint32_t node) const { return meshes[node]; }
+	const glm::vec3& getLocalPosition(uint32_t node) const { return localPositions[node]; }
+	const glm::quat& getLocalRotation(uint32_t node) const { return localRotations[node]; }
+	const glm::vec3& getLocalScale(uint32_t node) const { return localScales[node]; }
+	const glm::mat4& getWorldMatrix(uint32_t node) const { return worldMatrices[node]; }
+	const glm::vec4& getLocalBounds(uint32_t node) const { return localBounds[node]; }		// xyz = centre, w = radius
+	const glm::vec4& getWorldBounds(uint32_t node) const { return worldBounds[node]; }
+
+	// whether the last updateTransforms() changed the node's world matrix
+	bool wasUpdated(uint32_t node) const { return updated[node] != 0; }
+
+private:
+	// local transform
+	std::vector<glm::vec3> localPositions;
+	std::vector<glm::quat> localRotations;
+	std::vector<glm::vec3> localScales;
+
+	// hierarchy
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+
+	// results
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<glm::vec4> worldBounds;
+
+	std::vector<uint32_t> meshes;
+	std::vector<glm::vec4> localBounds;
+
+	std::vector<uint8_t> dirty;		// local transform changed since the last update
+	std::vector<uint8_t> updated;		// world matrix changed in the last update
+
+	// nodes grouped by depth (stable, so still in storage order within a depth). Every node of a depth can be updated in
+	// parallel once the previous depth is done
+	std::vector<uint32_t> depthOrder;
+	std::vector<uint32_t> depthOffsets;
+	bool depthOrderValid = false;
+
+	void buildDepthOrder();
+	void updateNodes(const uint32_t* nodes, uint32_t count);
+};
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// the same integer hash everywhere, so results only depend on the seed and what is being generated
+static uint32_t hash(uint32_t value)
+{
+	value ^= value >> 16;
+	value *= 0x7feb352du;
+	value ^= value >> 15;
+	value *= 0x846ca68bu;
+	value ^= value >> 16;
+	return value;
+}
+
+// sequence of floats in [0, 1)
+struct Random {
+	uint32_t state;
+
+	explicit Random(uint32_t seed) : state(hash(seed)) {}
+
+	float next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return static_cast<float>(state >> 8) / 16777216.f;
+	}
+};
+
+static glm::quat randomRotation(Random& random)
+{
+	glm::vec3 axis = glm::normalize(glm::vec3(random.next(), random.next(), random.next()) * 2.f - 1.f + 0.001f);
+	return glm::angleAxis(random.next() * 6.2831853f, axis);
+}
+
+SceneGenerator::SceneGenerator()
+{
+}
+
+SceneGenerator::~SceneGenerator()
+{
+}
+
+void SceneGenerator::init(const SceneGeneratorSettings& settings)
+{
+	if (settings.meshCount == 0 || settings.trianglesPerMesh == 0 || settings.instanceCount == 0 || settings.churn < 0.f ||
+		settings.churn > 1.f || settings.density <= 0.f)
+	{
+		throw std::runtime_error("Invalid scene generator settings!");
+	}
+
+	this->settings = settings;
+	instanceNodes.clear();
+	churnCursor = 0;
+	frameNumber = 0;
+}
+
+void SceneGenerator::generateMesh(uint32_t meshIndex, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const
+{
+	Random random(settings.seed ^ hash(meshIndex + 1));
+
+	// latitude/longitude band (stopping short of the poles, so no triangle is degenerate) with at least enough quads, the
+	// last few triangles are dropped to hit the count exactly
+	uint32_t triangleCount = settings.trianglesPerMesh;
+	uint32_t columns = std::max(3u, static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount / 2.f))));
+	uint32_t rows = std::max(1u, (triangleCount + columns * 2 - 1) / (columns * 2));
+
+	glm::vec3 baseColour = glm::vec3(random.next(), random.next(), random.next());
+	float roughness = 0.1f + random.next() * 0.2f;
+
+	vertices.clear();
+	vertices.reserve((rows + 1) * (columns + 1));
+	for (uint32_t row = 0; row <= rows; row++)
+	{
+		float theta = 3.14159265f * (row + 0.5f) / (rows + 1);
+		for (uint32_t column = 0; column <= columns; column++)
+		{
+			float phi = 6.2831853f * column / columns;
+			float radius = 0.5f * (1.f - roughness + random.next() * roughness);
+
+			Vertex vertex = {};
+			vertex.pos = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius;
+			vertex.col = glm::mix(baseColour, glm::vec3(1.f) - baseColour, static_cast<float>(row) / rows);
+			vertex.uv = glm::vec2(static_cast<float>(column) / columns, static_cast<float>(row) / rows);
+			vertices.push_back(vertex);
+		}
+	}
+
+	indices.clear();
+	indices.reserve(triangleCount * 3);
+	for (uint32_t row = 0; row < rows; row++)
+	{
+		for (uint32_t column = 0; column < columns; column++)
+		{
+			uint32_t topLeft = row * (columns + 1) + column;
+			uint32_t bottomLeft = topLeft + columns + 1;
+
+			uint32_t quad[] = {
+				topLeft, bottomLeft, topLeft + 1,
+				topLeft + 1, bottomLeft, bottomLeft + 1
+			};
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	indices.resize(triangleCount * 3);
+}
+
+void SceneGenerator::populate(Scene& scene, uint32_t parent, const std::vector<glm::vec4>& meshBounds)
+{
+	if (meshBounds.size() != settings.meshCount)
+	{
+		throw std::runtime_error("Scene generator needs the bounds of every generated mesh!");
+	}
+
+	Random random(settings.seed);
+	float halfSize = std::cbrt(settings.instanceCount / settings.density) * 0.5f;
+
+	instanceNodes.resize(settings.instanceCount);
+	for (uint32_t i = 0; i < settings.instanceCount; i++)
+	{
+		glm::vec3 position = (glm::vec3(random.next(), random.next(), random.next()) * 2.f - 1.f) * halfSize;
+		glm::quat rotation = randomRotation(random);
+		float scale = 0.5f + random.next();
+		uint32_t mesh = std::min(static_cast<uint32_t>(random.next() * settings.meshCount), settings.meshCount - 1);
+
+		instanceNodes[i] = scene.addNode(parent, position, rotation, glm::vec3(scale), mesh, meshBounds[mesh]);
+	}
+}
+
+void SceneGenerator::update(Scene& scene, JobSystem& jobSystem)
+{
+	uint32_t instanceCount = static_cast<uint32_t>(instanceNodes.size());
+	uint32_t churnCount = std::min(static_cast<uint32_t>(std::lround(settings.churn * instanceCount)), instanceCount);
+	if (churnCount == 0)
+	{
+		return;
+	}
+
+	// each instance's rotation only depends on the frame and the instance, so batches can run in any order
+	uint32_t cursor = churnCursor;
+	uint32_t frame = frameNumber;
+	jobSystem.parallelFor(churnCount, 0, [&](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			uint32_t instance = (cursor + i) % instanceCount;
+			Random random(settings.seed ^ hash(frame * 0x9e3779b9u + instance));
+			scene.setLocalRotation(instanceNodes[instance], randomRotation(random));
+		}
+	});
+
+	churnCursor = (churnCursor + churnCount) % instanceCount;
+	frameNumber++;
+}
+
+float SceneGenerator::getRadius() const
+{
+	// corner of the placement cube plus the largest instance
+	float halfSize = std::cbrt(settings.instanceCount / settings.density) * 0.5f;
+	return halfSize * std::sqrt(3.f) + 0.75f;
+}
\ No newline at end of file
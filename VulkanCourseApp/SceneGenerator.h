@@ -0,0 +1,51 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Scene.h"
+#include "Utilities.h"
+
+struct SceneGeneratorSettings {
+	uint32_t seed = 1;
+	uint32_t meshCount = 1;
+	uint32_t trianglesPerMesh = 1;
+	uint32_t instanceCount = 1;
+	float churn = 0.f;				// fraction of instances given a new rotation every frame
+	float density = 0.2f;			// instances per unit cube, meshes are about one unit across, so higher means more overlap
+};
+
+// Builds deterministic synthetic scenes, so features can be measured on identical workloads: the same settings always give
+// the same meshes, the same placement and the same per frame changes. Instances are spread uniformly through a cube sized
+// for the requested density, each using a random mesh, and hang off a single parent node
+class SceneGenerator
+{
+public:
+	SceneGenerator();
+	~SceneGenerator();
+
+	void init(const SceneGeneratorSettings& settings);
+
+	// a jittered, roughly spherical mesh with exactly trianglesPerMesh triangles
+	void generateMesh(uint32_t meshIndex, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) const;
+
+	// adds every instance as a child of parent, meshBounds are the model space bounding spheres of the generated meshes
+	void populate(Scene& scene, uint32_t parent, const std::vector<glm::vec4>& meshBounds);
+
+	// re-rotates the next churn fraction of instances, cycling through all of them
+	void update(Scene& scene, JobSystem& jobSystem);
+
+	// radius of a sphere around the origin containing every instance
+	float getRadius() const;
+	const SceneGeneratorSettings& getSettings() const { return settings; }
+
+private:
+	SceneGeneratorSettings settings;
+	std::vector<uint32_t> instanceNodes;
+	uint32_t churnCursor = 0;
+	uint32_t frameNumber = 0;
+};
\ No newline at end of file
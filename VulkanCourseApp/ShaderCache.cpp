@@ -0,0 +1,52 @@
+#include "ShaderCache.h"
+
+#include "Utilities.h"
+
+ShaderCache& ShaderCache::get()
+{
+	static ShaderCache shaderCache;
+	return shaderCache;
+}
+
+ShaderCache::ShaderCache()
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+}
+
+void ShaderCache::preload(JobSystem& jobSystem, const std::vector<std::string>& paths)
+{
+	PROFILE_FUNCTION();
+
+	jobSystem.parallelFor(static_cast<uint32_t>(paths.size()), 1, [this, &paths](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			std::vector<char> fileCode = readFile(paths[i]);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			code[paths[i]] = std::move(fileCode);
+		}
+	});
+}
+
+std::vector<char> ShaderCache::getCode(const std::string& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = code.find(path);
+		if (cached != code.end())
+		{
+			return cached->second;
+		}
+	}
+
+	return readFile(path);
+}
+
+void ShaderCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	code.clear();
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JobSystem.h"
+
+// SPIR-V read ahead of time, so pipeline creation doesn't wait on the disk. Files that weren't preloaded are read on
+// first use. There is one per process, shared by everything that creates shader modules
+class ShaderCache
+{
+public:
+	static ShaderCache& get();
+
+	// reads every file in parallel, rethrowing the first failure
+	void preload(JobSystem& jobSystem, const std::vector<std::string>& paths);
+	std::vector<char> getCode(const std::string& path);
+
+	// the code is only needed until the pipelines exist
+	void clear();
+
+private:
+	ShaderCache();
+	~ShaderCache();
+
+	std::mutex mutex;
+	std::unordered_map<std::string, std::vector<char>> code;
+};
\ No newline at end of file
@@ -1,3 +1,11 @@
 C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V shader.vert
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V shader_pulled.vert -o vert_pulled.spv
 C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V shader.frag
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V cull.comp -o cull.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V depth_reduce.comp -o depth_reduce.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V particle_emit.comp -o particle_emit.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V particle_simulate.comp -o particle_simulate.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V particle_prepare.comp -o particle_prepare.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V particle.vert -o particle_vert.spv
+C:\VulkanSDK\1.3.275.0\Bin\glslangValidator.exe -V particle.frag -o particle_frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 450
+
+layout (location = 0) in vec2 fragCorner;
+layout (location = 1) in vec4 fragColour;
+
+layout (location = 0) out vec4 outColour;
+
+void main()
+{
+    // round, soft edged sprite
+    float falloff = 1.0 - dot(fragCorner, fragCorner);
+    if (falloff <= 0.0)
+    {
+        discard;
+    }
+    outColour = vec4(fragColour.rgb, fragColour.a * falloff);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_multiview : require
+
+const uint MAX_VIEWS = 4;       // matches Utilities.h
+
+struct Particle {
+    vec4 position;      // w = remaining life in seconds
+    vec4 velocity;      // w = lifetime at spawn
+};
+
+// bindless storage buffers, the push constants say which ones the draw uses
+layout (set = 0, binding = 0) readonly buffer MVPBuffer {
+    mat4 projection[MAX_VIEWS];     // a camera per view
+    mat4 view[MAX_VIEWS];
+    mat4 model;
+    uint viewCount;
+} mvpBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer ParticleBuffer {
+    Particle particles[];
+} particleBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer AliveListBuffer {
+    uint indices[];
+} aliveListBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer CounterBuffer {
+    uint aliveCount[2];
+    int deadCount;
+    uint currentList;
+} counterBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer ParamsBuffer {
+    vec4 emitterPosition;   // w = emitter radius
+    vec4 gravity;           // w = delta time
+    vec4 colour;
+    uint emitCount;
+    uint seed;
+    float lifetime;
+    float speed;
+    float size;
+} paramsBuffers[];
+
+layout (push_constant) uniform Constants {
+    uint capacity;
+    uint particleBuffer;
+    uint aliveListBuffer;
+    uint deadListBuffer;
+    uint counterBuffer;
+    uint paramsBuffer;
+    uint mvpBuffer;
+} constants;
+
+layout (location = 0) out vec2 fragCorner;
+layout (location = 1) out vec4 fragColour;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+void main()
+{
+    // one instance per alive particle, in the list the prepare pass just made current
+    uint currentList = counterBuffers[constants.counterBuffer].currentList;
+    uint particleIndex = aliveListBuffers[constants.aliveListBuffer].indices[currentList * constants.capacity + gl_InstanceIndex];
+    Particle particle = particleBuffers[constants.particleBuffer].particles[particleIndex];
+
+    // billboard: offset the corner in view space so the quad always faces the camera
+    vec2 corner = corners[gl_VertexIndex];
+    vec4 viewPosition = mvpBuffers[constants.mvpBuffer].view[gl_ViewIndex] * vec4(particle.position.xyz, 1.0);
+    viewPosition.xy += corner * paramsBuffers[constants.paramsBuffer].size;
+    gl_Position = mvpBuffers[constants.mvpBuffer].projection[gl_ViewIndex] * viewPosition;
+
+    // fade out over the particle's life
+    vec4 colour = paramsBuffers[constants.paramsBuffer].colour;
+    fragCorner = corner;
+    fragColour = vec4(colour.rgb, colour.a * clamp(particle.position.w / particle.velocity.w, 0.0, 1.0));
+}
\ No newline at end of file
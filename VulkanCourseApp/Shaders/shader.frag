@@ -1,10 +1,27 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+const uint NO_TEXTURE = 0xffffffffu;
+
+// pipeline variant (MeshPipelineVariant), fixed when the pipeline is created
+layout (constant_id = 0) const bool VERTEX_COLOUR = true;
+layout (constant_id = 1) const bool TEXTURED = true;
 
 layout (location = 0) in vec3 fragCol;
+layout (location = 1) in vec2 fragUV;
+layout (location = 2) flat in uint fragTexture;
+
+layout (set = 0, binding = 1) uniform sampler2D sampledImages[];
 
 layout (location = 0) out vec4 outColour;
 
 void main()
 {
-    outColour = vec4(fragCol, 1.f);
+    // the index comes from per-object data, so can differ within a draw
+    vec3 colour = VERTEX_COLOUR ? fragCol : vec3(1.f);
+    if (TEXTURED && fragTexture != NO_TEXTURE)
+    {
+        colour *= texture(sampledImages[nonuniformEXT(fragTexture)], fragUV).rgb;
+    }
+    outColour = vec4(colour, 1.f);
 }
\ No newline at end of file
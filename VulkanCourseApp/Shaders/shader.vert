@@ -1,18 +1,61 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_multiview : require
 
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 col;
+layout (location = 2) in vec2 uv;
 
-layout (binding = 0) uniform MVP {
-    mat4 projection;
-    mat4 view;
+const uint NO_TEXTURE = 0xffffffffu;
+const uint MAX_VIEWS = 4;       // matches Utilities.h
+
+// pipeline variant (MeshPipelineVariant), fixed when the pipeline is created
+layout (constant_id = 1) const bool TEXTURED = true;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint texture;
+};
+
+// bindless storage buffers, the push constants say which ones this draw uses
+layout (set = 0, binding = 0) readonly buffer MVPBuffer {
+    mat4 projection[MAX_VIEWS];     // a camera per view
+    mat4 view[MAX_VIEWS];
     mat4 model;
-} mvp;
+    uint viewCount;
+} mvpBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffers[];
+
+// texture handle -> sampled image index, rewritten by the streamer as textures refine
+layout (set = 0, binding = 0) readonly buffer TextureTable {
+    uint sampledImages[];
+} textureTables[];
+
+layout (push_constant) uniform Constants {
+    uint mvpBuffer;
+    uint objectBuffer;
+    uint textureTable;
+    uint meshDrawBuffer;
+} constants;
 
 layout (location = 0) out vec3 fragCol;
+layout (location = 1) out vec2 fragUV;
+layout (location = 2) flat out uint fragTexture;
 
 void main()
 {
-    gl_Position = mvp.projection * mvp.view * mvp.model * vec4(pos, 1.f);
+    // culling writes the object index as firstInstance of each indirect draw
+    ObjectData object = objectBuffers[constants.objectBuffer].objects[gl_InstanceIndex];
+
+    mat4 model = mvpBuffers[constants.mvpBuffer].model * object.model;
+    gl_Position = mvpBuffers[constants.mvpBuffer].projection[gl_ViewIndex] * mvpBuffers[constants.mvpBuffer].view[gl_ViewIndex] *
+        model * vec4(pos, 1.f);
     fragCol = col;
+    fragUV = uv;
+    fragTexture = !TEXTURED || object.texture == NO_TEXTURE ? NO_TEXTURE : textureTables[constants.textureTable].sampledImages[object.texture];
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_multiview : require
+#extension GL_EXT_buffer_reference : require
+
+// shader.vert with the vertices read from the mesh's streams instead of vertex input, see Mesh::createVertexStreams
+
+const uint NO_TEXTURE = 0xffffffffu;
+const uint MAX_VIEWS = 4;       // matches Utilities.h
+
+// pipeline variant (MeshPipelineVariant), fixed when the pipeline is created
+layout (constant_id = 1) const bool TEXTURED = true;
+
+// vec3 arrays would be padded to 16 bytes, positions are tightly packed floats
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer PositionStream {
+    float positions[];
+};
+
+// RGBA8 unorm colour and half float uv
+layout (buffer_reference, std430, buffer_reference_align = 8) readonly buffer AttributeStream {
+    uvec2 attributes[];
+};
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint texture;
+};
+
+struct MeshDrawData {
+    uint indexCount;
+    uint firstDraw;
+    uint firstMeshlet;
+    uint meshletCount;
+    PositionStream positions;
+    AttributeStream attributes;
+};
+
+// bindless storage buffers, the push constants say which ones this draw uses
+layout (set = 0, binding = 0) readonly buffer MVPBuffer {
+    mat4 projection[MAX_VIEWS];     // a camera per view
+    mat4 view[MAX_VIEWS];
+    mat4 model;
+    uint viewCount;
+} mvpBuffers[];
+
+layout (set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffers[];
+
+// texture handle -> sampled image index, rewritten by the streamer as textures refine
+layout (set = 0, binding = 0) readonly buffer TextureTable {
+    uint sampledImages[];
+} textureTables[];
+
+layout (set = 0, binding = 0) readonly buffer MeshDrawBuffer {
+    MeshDrawData meshDraws[];
+} meshDrawBuffers[];
+
+layout (push_constant) uniform Constants {
+    uint mvpBuffer;
+    uint objectBuffer;
+    uint textureTable;
+    uint meshDrawBuffer;
+} constants;
+
+layout (location = 0) out vec3 fragCol;
+layout (location = 1) out vec2 fragUV;
+layout (location = 2) flat out uint fragTexture;
+
+void main()
+{
+    // culling writes the object index as firstInstance of each indirect draw
+    ObjectData object = objectBuffers[constants.objectBuffer].objects[gl_InstanceIndex];
+    MeshDrawData meshDraw = meshDrawBuffers[constants.meshDrawBuffer].meshDraws[object.meshIndex];
+
+    // indices are local to the mesh, so the vertex index addresses its streams directly
+    uint vertex = gl_VertexIndex;
+    vec3 pos = vec3(meshDraw.positions.positions[vertex * 3], meshDraw.positions.positions[vertex * 3 + 1],
+        meshDraw.positions.positions[vertex * 3 + 2]);
+    uvec2 attributes = meshDraw.attributes.attributes[vertex];
+
+    mat4 model = mvpBuffers[constants.mvpBuffer].model * object.model;
+    gl_Position = mvpBuffers[constants.mvpBuffer].projection[gl_ViewIndex] * mvpBuffers[constants.mvpBuffer].view[gl_ViewIndex] *
+        model * vec4(pos, 1.f);
+    fragCol = unpackUnorm4x8(attributes.x).rgb;
+    fragUV = unpackHalf2x16(attributes.y);
+    fragTexture = !TEXTURED || object.texture == NO_TEXTURE ? NO_TEXTURE : textureTables[constants.textureTable].sampledImages[object.texture];
+}
\ No newline at end of file
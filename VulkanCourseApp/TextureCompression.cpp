@@ -0,0 +1,378 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+FormatBlockInfo getFormatBlockInfo(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		return { 1, 1, 1 };
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SRGB:
+		return { 1, 1, 2 };
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		return { 1, 1, 4 };
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return { 1, 1, 8 };
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return { 1, 1, 16 };
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+		return { 4, 4, 8 };
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+		return { 4, 4, 16 };
+	case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+		return { 6, 6, 16 };
+	case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+		return { 8, 8, 16 };
+	default:
+		throw std::runtime_error("Failed to find the block size of a texture format!");
+	}
+}
+
+VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	FormatBlockInfo block = getFormatBlockInfo(format);
+	VkDeviceSize blocksX = (width + block.width - 1) / block.width;
+	VkDeviceSize blocksY = (height + block.height - 1) / block.height;
+	return blocksX * blocksY * block.bytes;
+}
+
+bool isBlockCompressed(VkFormat format)
+{
+	FormatBlockInfo block = getFormatBlockInfo(format);
+	return block.width > 1 || block.height > 1;
+}
+
+void downsampleRgba8(const std::vector<uint8_t>& source, uint32_t width, uint32_t height, std::vector<uint8_t>& destination)
+{
+	uint32_t halfWidth = std::max(1u, width / 2);
+	uint32_t halfHeight = std::max(1u, height / 2);
+	destination.resize(static_cast<size_t>(halfWidth) * halfHeight * 4);
+
+	for (uint32_t y = 0; y < halfHeight; y++)
+	{
+		uint32_t y0 = std::min(y * 2, height - 1);
+		uint32_t y1 = std::min(y * 2 + 1, height - 1);
+		for (uint32_t x = 0; x < halfWidth; x++)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, width - 1);
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				uint32_t sum = source[(static_cast<size_t>(y0) * width + x0) * 4 + channel] +
+					source[(static_cast<size_t>(y0) * width + x1) * 4 + channel] +
+					source[(static_cast<size_t>(y1) * width + x0) * 4 + channel] +
+					source[(static_cast<size_t>(y1) * width + x1) * 4 + channel];
+				destination[(static_cast<size_t>(y) * halfWidth + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool hasTranslucentPixels(const std::vector<uint8_t>& pixels)
+{
+	for (size_t i = 3; i < pixels.size(); i += 4)
+	{
+		if (pixels[i] != 255)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void generateMipChain(std::vector<TextureLevel>& levels)
+{
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		const TextureLevel& source = levels.back();
+		TextureLevel level = {};
+		level.width = std::max(1u, source.width / 2);
+		level.height = std::max(1u, source.height / 2);
+		downsampleRgba8(source.data, source.width, source.height, level.data);
+		levels.push_back(std::move(level));
+	}
+}
+
+bool canCompressTo(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint16_t packRgb565(const int colour[3])
+{
+	return static_cast<uint16_t>(((colour[0] * 31 + 127) / 255) << 11 | ((colour[1] * 63 + 127) / 255) << 5 |
+		((colour[2] * 31 + 127) / 255));
+}
+
+static void unpackRgb565(uint16_t packed, int colour[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+static void writeLittleEndian(uint8_t* output, uint64_t value, uint32_t bytes)
+{
+	for (uint32_t i = 0; i < bytes; i++)
+	{
+		output[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+// four colours interpolated between two RGB565 endpoints, 2 bit indices
+static void encodeColourBlock(const uint8_t texels[16][4], uint8_t* output)
+{
+	int minimum[3] = { 255, 255, 255 };
+	int maximum[3] = { 0, 0, 0 };
+	int mean[3] = { 0, 0, 0 };
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t channel = 0; channel < 3; channel++)
+		{
+			minimum[channel] = std::min(minimum[channel], static_cast<int>(texels[i][channel]));
+			maximum[channel] = std::max(maximum[channel], static_cast<int>(texels[i][channel]));
+			mean[channel] += texels[i][channel];
+		}
+	}
+
+	// the endpoints are opposite corners of the bounding box. Channels that fall as the widest one rises swap their ends,
+	// so the line runs along the colours rather than across them
+	uint32_t widest = 0;
+	for (uint32_t channel = 1; channel < 3; channel++)
+	{
+		if (maximum[channel] - minimum[channel] > maximum[widest] - minimum[widest])
+		{
+			widest = channel;
+		}
+	}
+	for (uint32_t channel = 0; channel < 3; channel++)
+	{
+		int covariance = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			covariance += (texels[i][widest] * 16 - mean[widest]) * (texels[i][channel] * 16 - mean[channel]);
+		}
+		if (covariance < 0)
+		{
+			std::swap(minimum[channel], maximum[channel]);
+		}
+	}
+
+	// inset by a sixteenth, so the interpolated colours land nearer the cluster
+	for (uint32_t channel = 0; channel < 3; channel++)
+	{
+		int inset = (maximum[channel] - minimum[channel]) / 16;
+		maximum[channel] -= inset;
+		minimum[channel] += inset;
+	}
+
+	uint16_t colour0 = packRgb565(maximum);
+	uint16_t colour1 = packRgb565(minimum);
+
+	// colour0 > colour1 selects four colour mode, the only one BC3 has
+	if (colour0 < colour1)
+	{
+		std::swap(colour0, colour1);
+	}
+	writeLittleEndian(output, colour0, 2);
+	writeLittleEndian(output + 2, colour1, 2);
+	if (colour0 == colour1)
+	{
+		writeLittleEndian(output + 4, 0, 4);
+		return;
+	}
+
+	int palette[4][3];
+	unpackRgb565(colour0, palette[0]);
+	unpackRgb565(colour1, palette[1]);
+	for (uint32_t channel = 0; channel < 3; channel++)
+	{
+		palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+		palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+	}
+
+	uint32_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t bestIndex = 0;
+		int bestDistance = INT32_MAX;
+		for (uint32_t index = 0; index < 4; index++)
+		{
+			int distance = 0;
+			for (uint32_t channel = 0; channel < 3; channel++)
+			{
+				int difference = texels[i][channel] - palette[index][channel];
+				distance += difference * difference;
+			}
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				bestIndex = index;
+			}
+		}
+		indices |= bestIndex << (i * 2);
+	}
+	writeLittleEndian(output + 4, indices, 4);
+}
+
+// eight alphas interpolated between the block's extremes, 3 bit indices
+static void encodeAlphaBlock(const uint8_t texels[16][4], uint8_t* output)
+{
+	int alpha0 = 0;
+	int alpha1 = 255;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, static_cast<int>(texels[i][3]));
+		alpha1 = std::min(alpha1, static_cast<int>(texels[i][3]));
+	}
+
+	output[0] = static_cast<uint8_t>(alpha0);
+	output[1] = static_cast<uint8_t>(alpha1);
+	if (alpha0 == alpha1)
+	{
+		writeLittleEndian(output + 2, 0, 6);
+		return;
+	}
+
+	// alpha0 > alpha1 selects eight alpha mode: the endpoints, then six steps from alpha0 to alpha1
+	int palette[8] = { alpha0, alpha1 };
+	for (int step = 1; step < 7; step++)
+	{
+		palette[step + 1] = ((7 - step) * alpha0 + step * alpha1) / 7;
+	}
+
+	uint64_t indices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint64_t bestIndex = 0;
+		int bestDistance = 256;
+		for (uint32_t index = 0; index < 8; index++)
+		{
+			int distance = std::abs(texels[i][3] - palette[index]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				bestIndex = index;
+			}
+		}
+		indices |= bestIndex << (i * 3);
+	}
+	writeLittleEndian(output + 2, indices, 6);
+}
+
+void compressBlockRows(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow,
+	uint8_t* blocks)
+{
+	if (!canCompressTo(format))
+	{
+		throw std::runtime_error("Failed to compress texture, there's no encoder for the format!");
+	}
+
+	bool alpha = format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+	uint32_t blockBytes = alpha ? 16 : 8;
+	uint32_t blocksX = (width + 3) / 4;
+
+	uint8_t texels[16][4];
+	for (uint32_t blockY = firstRow; blockY < lastRow; blockY++)
+	{
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+				uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+				memcpy(texels[i], pixels + (static_cast<size_t>(y) * width + x) * 4, 4);
+			}
+
+			uint8_t* output = blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes;
+			if (alpha)
+			{
+				encodeAlphaBlock(texels, output);
+				output += 8;
+			}
+			encodeColourBlock(texels, output);
+		}
+	}
+}
+
+void compressMipChain(JobSystem& jobSystem, VkFormat format, std::vector<TextureLevel>& levels)
+{
+	// first block row of each level, counting down the whole chain
+	std::vector<uint32_t> firstRows;
+	std::vector<TextureLevel> compressed(levels.size());
+	uint32_t rowCount = 0;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		compressed[i].width = levels[i].width;
+		compressed[i].height = levels[i].height;
+		compressed[i].data.resize(static_cast<size_t>(getLevelSize(format, levels[i].width, levels[i].height)));
+		firstRows.push_back(rowCount);
+		rowCount += (levels[i].height + 3) / 4;
+	}
+
+	jobSystem.parallelFor(rowCount, 16, [&](uint32_t start, uint32_t end) {
+		// a batch can run over the end of one level into the next
+		uint32_t row = start;
+		while (row < end)
+		{
+			size_t level = std::upper_bound(firstRows.begin(), firstRows.end(), row) - firstRows.begin() - 1;
+			uint32_t levelEnd = level + 1 < firstRows.size() ? firstRows[level + 1] : rowCount;
+			uint32_t batchEnd = std::min(end, levelEnd);
+			compressBlockRows(format, levels[level].data.data(), levels[level].width, levels[level].height, row - firstRows[level],
+				batchEnd - firstRows[level], compressed[level].data.data());
+			row = batchEnd;
+		}
+	});
+
+	levels.swap(compressed);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "JobSystem.h"
+
+// one mip level, tightly packed in its format
+struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> data;
+};
+
+// texel block of a format, 1x1 for uncompressed formats
+struct FormatBlockInfo {
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes;
+};
+
+// throws for formats textures can't use
+FormatBlockInfo getFormatBlockInfo(VkFormat format);
+VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+bool isBlockCompressed(VkFormat format);
+
+// halves each side (never below 1) of an RGBA8 image with a box filter
+void downsampleRgba8(const std::vector<uint8_t>& source, uint32_t width, uint32_t height, std::vector<uint8_t>& destination);
+bool hasTranslucentPixels(const std::vector<uint8_t>& pixels);
+// adds box filtered levels below the last RGBA8 level of levels, down to 1x1
+void generateMipChain(std::vector<TextureLevel>& levels);
+
+// RGBA8 to BC1 (opaque) or BC3, the sRGB variants keep the sRGB encoding. Endpoints are a range fit of each block's colours,
+// lower quality than an offline encoder but fast enough to run while loading
+bool canCompressTo(VkFormat format);
+// compresses block rows [firstRow, lastRow) into blocks (the whole level), so large levels can be split across jobs. Blocks
+// past the edge of the image repeat its last row and column
+void compressBlockRows(VkFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow,
+	uint8_t* blocks);
+// compresses every level of an RGBA8 chain in place. Block rows are independent, so the work is split across the job
+// system by rows rather than by level, which keeps the threads busy when the top level is most of it
+void compressMipChain(JobSystem& jobSystem, VkFormat format, std::vector<TextureLevel>& levels);
\ No newline at end of file
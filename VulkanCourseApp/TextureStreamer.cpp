@@ -0,0 +1,1143 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+const VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+const VkDeviceSize STAGING_ALIGNMENT = 16;		// covers the texel size and the usual optimal copy offset alignment
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+	{
+		levels++;
+	}
+	return levels;
+}
+
+static void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMipLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+	VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+	VkImageMemoryBarrier2 imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageBarrier.srcStageMask = srcStage;
+	imageBarrier.srcAccessMask = srcAccess;
+	imageBarrier.dstStageMask = dstStage;
+	imageBarrier.dstAccessMask = dstAccess;
+	imageBarrier.oldLayout = oldLayout;
+	imageBarrier.newLayout = newLayout;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel = baseMipLevel;
+	imageBarrier.subresourceRange.levelCount = levelCount;
+	imageBarrier.subresourceRange.layerCount = 1;
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+TextureStreamer::TextureStreamer()
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, QueueTimeline* queue, uint32_t queueFamily,
+	BindlessDescriptors* bindlessDescriptors, JobSystem* jobSystem, uint32_t frameCount, bool anisotropy,
+	const TextureStreamerSettings& settings)
+{
+	PROFILE_FUNCTION();
+
+	this->physicalDevice = physicalDevice;
+	this->logicalDevice = logicalDevice;
+	this->queue = queue;
+	this->bindlessDescriptors = bindlessDescriptors;
+	this->jobSystem = jobSystem;
+	this->settings = settings;
+
+	// mips are generated by blitting one level into the next and sampled with trilinear filtering
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, TEXTURE_FORMAT, &formatProperties);
+	VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+	{
+		throw std::runtime_error("Failed to find blit and linear filtering support for the texture format!");
+	}
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	maxImageDimension = deviceProperties.limits.maxImageDimension2D;
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.anisotropyEnable = anisotropy ? VK_TRUE : VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = anisotropy ? std::min(16.f, deviceProperties.limits.maxSamplerAnisotropy) : 1.f;
+	samplerCreateInfo.minLod = 0.f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkResult result = vkCreateSampler(logicalDevice, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture sampler!");
+	}
+
+	// command buffers are reset one at a time as their submissions finish
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	result = vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture upload command pool!");
+	}
+
+	createBuffer(physicalDevice, logicalDevice, settings.stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, settings.stagingSize, 0, reinterpret_cast<void**>(&stagingMapped));
+
+	VkDeviceSize tableSize = sizeof(uint32_t) * MAX_STREAMED_TEXTURES;
+	tableBuffers.resize(frameCount);
+	tableBufferMemory.resize(frameCount);
+	tableMapped.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		createBuffer(physicalDevice, logicalDevice, tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &tableBuffers[i], &tableBufferMemory[i]);
+		vkMapMemory(logicalDevice, tableBufferMemory[i], 0, tableSize, 0, reinterpret_cast<void**>(&tableMapped[i]));
+		tableBufferIndex.push_back(bindlessDescriptors->registerStorageBuffer(tableBuffers[i]));
+	}
+
+	// handle 0 is the white fallback every other texture shows until its preview is resident. It's uploaded by the first
+	// update, which always has the staging ring to itself
+	std::unique_ptr<Texture> fallback(new Texture());
+	fallback->path = "fallback";
+	fallback->width = 1;
+	fallback->height = 1;
+	fallback->previewLevels.push_back({ 1, 1, std::vector<uint8_t>(4, 255) });
+	fallback->loadStart = std::chrono::steady_clock::now();
+	fallback->state.store(TextureState::Decoded, std::memory_order_release);
+	textures.push_back(std::move(fallback));
+
+	evictionHandlerId = MemoryTelemetry::get().addEvictionHandler([this](uint32_t heapIndex, VkDeviceSize bytes) {
+		return evict(heapIndex, bytes);
+	});
+}
+
+void TextureStreamer::destroy()
+{
+	if (logicalDevice == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// decode jobs write into their textures
+	jobSystem->wait(&decodeJobs);
+	printStats();
+
+	MemoryTelemetry::get().removeEvictionHandler(evictionHandlerId);
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	for (const std::unique_ptr<Texture>& texture : textures)
+	{
+		destroyTextureImage(texture->preview);
+		destroyTextureImage(texture->full);
+	}
+	textures.clear();
+	for (RetiredImage& retired : retiredImages)
+	{
+		destroyTextureImage(retired.image);
+	}
+	retiredImages.clear();
+
+	for (size_t i = 0; i < tableBuffers.size(); i++)
+	{
+		bindlessDescriptors->releaseStorageBuffer(tableBufferIndex[i]);
+		vkDestroyBuffer(logicalDevice, tableBuffers[i], nullptr);
+		MemoryTelemetry::get().release(logicalDevice, tableBufferMemory[i]);
+	}
+	tableBuffers.clear();
+	tableBufferMemory.clear();
+	tableMapped.clear();
+	tableBufferIndex.clear();
+
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, stagingBufferMemory);
+	stagingRegions.clear();
+
+	// frees the command buffers too
+	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+	commandBuffers.clear();
+	vkDestroySampler(logicalDevice, sampler, nullptr);
+
+	logicalDevice = VK_NULL_HANDLE;
+}
+
+uint32_t TextureStreamer::load(const std::string& path)
+{
+	if (textures.size() >= MAX_STREAMED_TEXTURES)
+	{
+		throw std::runtime_error("Failed to load texture, the texture table is full!");
+	}
+
+	uint32_t handle = static_cast<uint32_t>(textures.size());
+	textures.push_back(std::unique_ptr<Texture>(new Texture()));
+
+	Texture* texture = textures.back().get();
+	texture->path = path;
+	texture->loadStart = std::chrono::steady_clock::now();
+
+	std::string extension = path.size() >= 5 ? path.substr(path.size() - 5) : "";
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	bool ktx2 = extension == ".ktx2";
+
+	jobSystem->run([this, texture, ktx2] {
+		PROFILE_ZONE("Decode texture");
+		try
+		{
+			if (ktx2)
+			{
+				decodeKtx2(*texture);
+			}
+			else
+			{
+				decodePpm(*texture);
+			}
+			choosePreview(*texture);
+			texture->state.store(TextureState::Decoded, std::memory_order_release);
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("Failed to load texture %s: %s\n", texture->path.c_str(), e.what());
+			texture->state.store(TextureState::Failed, std::memory_order_release);
+		}
+	}, &decodeJobs);
+
+	return handle;
+}
+
+bool TextureStreamer::isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+void TextureStreamer::decodePpm(Texture& texture)
+{
+	std::vector<char> file = readFile(texture.path);
+
+	// binary PPM: "P6", width, height and the maximum value separated by whitespace (and comments), then one whitespace
+	// character before the RGB data
+	size_t position = 0;
+	auto readToken = [&file, &position]() {
+		while (position < file.size())
+		{
+			if (file[position] == '#')
+			{
+				while (position < file.size() && file[position] != '\n')
+				{
+					position++;
+				}
+			}
+			else if (isspace(static_cast<unsigned char>(file[position])))
+			{
+				position++;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		std::string token;
+		while (position < file.size() && !isspace(static_cast<unsigned char>(file[position])))
+		{
+			token += file[position++];
+		}
+		return token;
+	};
+
+	if (readToken() != "P6")
+	{
+		throw std::runtime_error("Failed to decode texture, only binary PPM (P6) is supported!");
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t maxValue = 0;
+	try
+	{
+		width = static_cast<uint32_t>(std::stoul(readToken()));
+		height = static_cast<uint32_t>(std::stoul(readToken()));
+		maxValue = static_cast<uint32_t>(std::stoul(readToken()));
+	}
+	catch (const std::logic_error&)
+	{
+		throw std::runtime_error("Failed to decode texture header!");
+	}
+	position++;
+
+	if (width == 0 || height == 0 || maxValue == 0 || maxValue > 255)
+	{
+		throw std::runtime_error("Failed to decode texture, only 8 bit images with a size are supported!");
+	}
+	if (std::max(width, height) > maxImageDimension)
+	{
+		throw std::runtime_error("Failed to decode texture, it's larger than the device's maximum image size!");
+	}
+	if (file.size() < position + static_cast<size_t>(width) * height * 3)
+	{
+		throw std::runtime_error("Failed to decode texture, the file is truncated!");
+	}
+
+	TextureLevel level = {};
+	level.width = width;
+	level.height = height;
+	level.data.resize(static_cast<size_t>(width) * height * 4);
+	const uint8_t* source = reinterpret_cast<const uint8_t*>(file.data() + position);
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+	{
+		for (size_t channel = 0; channel < 3; channel++)
+		{
+			level.data[i * 4 + channel] = static_cast<uint8_t>(source[i * 3 + channel] * 255u / maxValue);
+		}
+		level.data[i * 4 + 3] = 255;
+	}
+
+	texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+	texture.generateMips = true;
+	texture.width = width;
+	texture.height = height;
+	texture.levels.push_back(std::move(level));
+}
+
+void TextureStreamer::decodeKtx2(Texture& texture)
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	const size_t KTX2_LEVEL_INDEX_OFFSET = 80;		// identifier, header and the data format, key/value and global data index
+	const size_t KTX2_LEVEL_INDEX_SIZE = 24;
+
+	std::vector<char> file = readFile(texture.path);
+	if (file.size() < KTX2_LEVEL_INDEX_OFFSET || memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+	{
+		throw std::runtime_error("Failed to decode texture, not a KTX2 file!");
+	}
+
+	// little endian throughout, like the hosts this runs on
+	auto readUint32 = [&file](size_t offset) {
+		uint32_t value;
+		memcpy(&value, file.data() + offset, sizeof(value));
+		return value;
+	};
+	auto readUint64 = [&file](size_t offset) {
+		uint64_t value;
+		memcpy(&value, file.data() + offset, sizeof(value));
+		return value;
+	};
+
+	VkFormat format = static_cast<VkFormat>(readUint32(12));
+	uint32_t width = readUint32(20);
+	uint32_t height = readUint32(24);
+	uint32_t depth = readUint32(28);
+	uint32_t layerCount = readUint32(32);
+	uint32_t faceCount = readUint32(36);
+	uint32_t levelCount = readUint32(40);
+	uint32_t supercompressionScheme = readUint32(44);
+
+	// an undefined format means Basis Universal, whose transcoder (like the Zstandard and zlib decoders) isn't part of this
+	if (format == VK_FORMAT_UNDEFINED || supercompressionScheme != 0)
+	{
+		throw std::runtime_error("Failed to decode texture, supercompressed KTX2 isn't supported!");
+	}
+	if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1)
+	{
+		throw std::runtime_error("Failed to decode texture, only 2D KTX2 textures are supported!");
+	}
+	if (std::max(width, height) > maxImageDimension)
+	{
+		throw std::runtime_error("Failed to decode texture, it's larger than the device's maximum image size!");
+	}
+
+	// a level count of 0 asks for the mips to be generated
+	uint32_t storedLevels = std::max(1u, levelCount);
+	if (file.size() < KTX2_LEVEL_INDEX_OFFSET + storedLevels * KTX2_LEVEL_INDEX_SIZE)
+	{
+		throw std::runtime_error("Failed to decode texture, the file is truncated!");
+	}
+
+	std::vector<TextureLevel> levels(storedLevels);
+	for (uint32_t i = 0; i < storedLevels; i++)
+	{
+		uint64_t byteOffset = readUint64(KTX2_LEVEL_INDEX_OFFSET + i * KTX2_LEVEL_INDEX_SIZE);
+		uint64_t byteLength = readUint64(KTX2_LEVEL_INDEX_OFFSET + i * KTX2_LEVEL_INDEX_SIZE + 8);
+
+		levels[i].width = std::max(1u, width >> i);
+		levels[i].height = std::max(1u, height >> i);
+		VkDeviceSize levelSize = getLevelSize(format, levels[i].width, levels[i].height);
+		if (byteLength < levelSize || byteOffset > file.size() || file.size() - byteOffset < levelSize)
+		{
+			throw std::runtime_error("Failed to decode texture, the file is truncated!");
+		}
+		levels[i].data.assign(file.data() + byteOffset, file.data() + byteOffset + levelSize);
+	}
+	std::vector<char>().swap(file);
+
+	// RGBA8 is compressed to the format the device samples, with alpha or without. Compressed images can't be blitted, so
+	// generated mips are made on the CPU first
+	bool rgba8 = format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+	if (rgba8 && settings.compress)
+	{
+		bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+		bool alpha = hasTranslucentPixels(levels[0].data);
+		VkFormat compressedFormat = alpha ? (srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK) :
+			(srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+		if (isFormatSupported(compressedFormat, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (levelCount == 0)
+			{
+				generateMipChain(levels);
+			}
+
+			VkDeviceSize sourceBytes = 0;
+			for (const TextureLevel& level : levels)
+			{
+				sourceBytes += level.data.size();
+			}
+			compressMipChain(*jobSystem, compressedFormat, levels);
+
+			double milliseconds = millisecondsSince(start);
+			printf("Texture %s compressed to %s in %.1f ms (%.0f MB/s)\n", texture.path.c_str(), alpha ? "BC3" : "BC1", milliseconds,
+				sourceBytes / (1024.0 * 1024.0) / std::max(milliseconds / 1000.0, 1e-6));
+			format = compressedFormat;
+		}
+	}
+
+	if (!isFormatSupported(format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+	{
+		throw std::runtime_error("Failed to decode texture, the device can't sample its format!");
+	}
+
+	texture.format = format;
+	texture.generateMips = levels.size() == 1 && levelCount == 0 && !isBlockCompressed(format) &&
+		isFormatSupported(format, VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT);
+	texture.width = width;
+	texture.height = height;
+	texture.levels.swap(levels);
+}
+
+void TextureStreamer::choosePreview(Texture& texture)
+{
+	uint32_t previewSize = settings.previewSize;
+
+	// small textures are their own preview and never refine
+	if (std::max(texture.width, texture.height) <= previewSize)
+	{
+		texture.previewLevels.swap(texture.levels);
+		return;
+	}
+
+	// the preview is the coarse end of the chain. Generated chains only have a top level, so it's box filtered down on the
+	// CPU. A stored chain may not go small enough, then the fallback shows until the full image is resident
+	if (texture.generateMips)
+	{
+		TextureLevel preview = texture.levels[0];
+		while (std::max(preview.width, preview.height) > previewSize)
+		{
+			TextureLevel halved = {};
+			halved.width = std::max(1u, preview.width / 2);
+			halved.height = std::max(1u, preview.height / 2);
+			downsampleRgba8(preview.data, preview.width, preview.height, halved.data);
+			preview = std::move(halved);
+		}
+		texture.previewLevels.push_back(std::move(preview));
+		return;
+	}
+
+	for (const TextureLevel& level : texture.levels)
+	{
+		if (std::max(level.width, level.height) <= previewSize)
+		{
+			texture.previewLevels.push_back(level);
+		}
+	}
+}
+
+void TextureStreamer::update(uint32_t frameIndex)
+{
+	PROFILE_FUNCTION();
+
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	reclaim();
+
+	// coarse before fine: every decoded texture gets its preview before any full image streams
+	bool stagingFull = false;
+	for (const std::unique_ptr<Texture>& texture : textures)
+	{
+		if (texture->state.load(std::memory_order_acquire) == TextureState::Decoded && !uploadPreview(*texture))
+		{
+			stagingFull = true;
+			break;
+		}
+	}
+
+	// then full images in load order, so the one already streaming finishes before the next takes staging space
+	for (size_t i = 0; i < textures.size() && !stagingFull; i++)
+	{
+		Texture& texture = *textures[i];
+		if (texture.state.load(std::memory_order_acquire) != TextureState::Preview)
+		{
+			continue;
+		}
+
+		if (texture.full.image == VK_NULL_HANDLE)
+		{
+			// generated chains are a third on top of the top level
+			VkDeviceSize estimatedSize = 0;
+			for (const TextureLevel& level : texture.levels)
+			{
+				estimatedSize += level.data.size();
+			}
+			if (texture.generateMips)
+			{
+				estimatedSize += estimatedSize / 3;
+			}
+
+			FormatBlockInfo block = getFormatBlockInfo(texture.format);
+			bool rowFits = static_cast<VkDeviceSize>((texture.width + block.width - 1) / block.width) * block.bytes <= settings.stagingSize;
+			if (residentBytes + estimatedSize > settings.memoryBudget || !rowFits)
+			{
+				printf("Texture %s stays at its preview, %ux%u is over the %s\n", texture.path.c_str(), texture.width, texture.height,
+					rowFits ? "memory budget" : "staging ring size");
+				std::vector<TextureLevel>().swap(texture.levels);
+				texture.state.store(TextureState::OverBudget, std::memory_order_release);
+				continue;
+			}
+		}
+
+		stagingFull = !uploadFullLevels(texture);
+	}
+
+	submitUploads();
+	fallbackIndex = textures[0]->full.sampledIndex;
+	writeTable(frameIndex);
+}
+
+TextureStreamerStats TextureStreamer::getStats() const
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+
+	TextureStreamerStats stats;
+	stats.textureCount = static_cast<uint32_t>(textures.size()) - 1;		// not counting the fallback
+	stats.residentBytes = residentBytes;
+	stats.savedBytes = savedBytes;
+	stats.uploadedBytes = uploadedBytes;
+
+	for (size_t i = 1; i < textures.size(); i++)
+	{
+		TextureState state = textures[i]->state.load(std::memory_order_acquire);
+		if (state != TextureState::Decoding && state != TextureState::Failed && isBlockCompressed(textures[i]->format))
+		{
+			stats.compressed++;
+		}
+
+		switch (state)
+		{
+		case TextureState::Decoding:
+		case TextureState::Decoded:
+			stats.decoding++;
+			break;
+		case TextureState::Preview:
+			stats.previewResident++;
+			break;
+		case TextureState::Full:
+			stats.fullResident++;
+			break;
+		case TextureState::OverBudget:
+			stats.previewResident++;
+			stats.overBudget++;
+			break;
+		case TextureState::Failed:
+			stats.failed++;
+			break;
+		}
+	}
+	return stats;
+}
+
+void TextureStreamer::printStats() const
+{
+	const double MEGABYTE = 1024.0 * 1024.0;
+
+	TextureStreamerStats stats = getStats();
+	printf("Textures: %u loaded, %u full resolution, %u preview only (%u over budget), %u decoding, %u failed\n",
+		stats.textureCount, stats.fullResident, stats.previewResident, stats.overBudget, stats.decoding, stats.failed);
+	printf("  %.2f of %.2f MB budget resident, %.2f MB uploaded, %u block compressed saving %.2f MB\n",
+		stats.residentBytes / MEGABYTE, settings.memoryBudget / MEGABYTE, stats.uploadedBytes / MEGABYTE, stats.compressed,
+		stats.savedBytes / MEGABYTE);
+}
+
+void TextureStreamer::reclaim()
+{
+	// regions are freed in allocation order, and submissions on the queue finish in order
+	while (!stagingRegions.empty() && stagingRegions.front().timelineValue != 0 &&
+		queue->isComplete(stagingRegions.front().timelineValue))
+	{
+		stagingRegions.pop_front();
+	}
+
+	for (size_t i = 0; i < retiredImages.size();)
+	{
+		if (retiredImages[i].tablesRemaining == 0 && queue->isComplete(retiredImages[i].timelineValue))
+		{
+			destroyTextureImage(retiredImages[i].image);
+			retiredImages[i] = std::move(retiredImages.back());
+			retiredImages.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+bool TextureStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize* offset)
+{
+	size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	if (size > settings.stagingSize)
+	{
+		return false;
+	}
+
+	// in use is [tail, head), wrapping past the end when head is at or before tail
+	if (stagingRegions.empty())
+	{
+		*offset = 0;
+	}
+	else
+	{
+		VkDeviceSize tail = stagingRegions.front().offset;
+		if (stagingHead > tail)
+		{
+			if (stagingHead + size <= settings.stagingSize)
+			{
+				*offset = stagingHead;
+			}
+			else if (size <= tail)
+			{
+				*offset = 0;		// the rest of the end is skipped
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (stagingHead + size <= tail)
+		{
+			*offset = stagingHead;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	stagingHead = *offset + size;
+	StagingRegion region = {};
+	region.offset = *offset;
+	region.size = size;
+	region.timelineValue = 0;
+	stagingRegions.push_back(region);
+	return true;
+}
+
+VkCommandBuffer TextureStreamer::beginUpload()
+{
+	if (recordingCommandBuffer != VK_NULL_HANDLE)
+	{
+		return recordingCommandBuffer;
+	}
+
+	recordingSlot = commandBuffers.size();
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+	{
+		if (queue->isComplete(commandBuffers[i].timelineValue))
+		{
+			recordingSlot = i;
+			break;
+		}
+	}
+
+	if (recordingSlot == commandBuffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		UploadCommandBuffer upload = {};
+		VkResult result = vkAllocateCommandBuffers(logicalDevice, &allocInfo, &upload.commandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate texture upload command buffer!");
+		}
+		commandBuffers.push_back(upload);
+	}
+	else
+	{
+		vkResetCommandBuffer(commandBuffers[recordingSlot].commandBuffer, 0);
+	}
+
+	// never complete until it's submitted
+	commandBuffers[recordingSlot].timelineValue = ~0ull;
+	recordingCommandBuffer = commandBuffers[recordingSlot].commandBuffer;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(recordingCommandBuffer, &beginInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording texture uploads!");
+	}
+	return recordingCommandBuffer;
+}
+
+void TextureStreamer::submitUploads()
+{
+	if (recordingCommandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	VkResult result = vkEndCommandBuffer(recordingCommandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording texture uploads!");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &recordingCommandBuffer;
+
+	// submitted ahead of the frame on the same queue, so the frame sees the uploads without a semaphore
+	uint64_t value = queue->submit(submitInfo);
+	commandBuffers[recordingSlot].timelineValue = value;
+	for (auto region = stagingRegions.rbegin(); region != stagingRegions.rend() && region->timelineValue == 0; ++region)
+	{
+		region->timelineValue = value;
+	}
+	recordingCommandBuffer = VK_NULL_HANDLE;
+}
+
+void TextureStreamer::createTextureImage(const Texture& texture, const TextureLevel& topLevel, uint32_t mipLevels, TextureImage& image)
+{
+	image.width = topLevel.width;
+	image.height = topLevel.height;
+	image.mipLevels = mipLevels;
+
+	// only generated chains are blitted from
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (texture.generateMips)
+	{
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	createImage(physicalDevice, logicalDevice, image.width, image.height, image.mipLevels, texture.format, VK_IMAGE_TILING_OPTIMAL,
+		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image.image, &image.memory);
+
+	VkMemoryRequirements memoryRequirements = {};
+	vkGetImageMemoryRequirements(logicalDevice, image.image, &memoryRequirements);
+	image.size = memoryRequirements.size;
+
+	// the same type createImage chose, so eviction only retires images from the heap that's short
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	uint32_t typeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	image.heapIndex = memoryProperties.memoryTypes[typeIndex].heapIndex;
+
+	VkImageViewCreateInfo imageViewCreateInfo = {};
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.image = image.image;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format = texture.format;
+	imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+	imageViewCreateInfo.subresourceRange.levelCount = image.mipLevels;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+	VkResult result = vkCreateImageView(logicalDevice, &imageViewCreateInfo, nullptr, &image.imageView);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(logicalDevice, image.image, nullptr);
+		MemoryTelemetry::get().release(logicalDevice, image.memory);
+		image = TextureImage();
+		throw std::runtime_error("Failed to create texture image view!");
+	}
+
+	// no frame can sample it before the upload that transitions it, which is submitted first
+	image.sampledIndex = bindlessDescriptors->registerSampledImage(image.imageView, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void TextureStreamer::destroyTextureImage(TextureImage& image)
+{
+	if (image.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	bindlessDescriptors->releaseSampledImage(image.sampledIndex);
+	vkDestroyImageView(logicalDevice, image.imageView, nullptr);
+	vkDestroyImage(logicalDevice, image.image, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, image.memory);
+	image = TextureImage();
+}
+
+bool TextureStreamer::uploadPreview(Texture& texture)
+{
+	PROFILE_FUNCTION();
+
+	if (texture.previewLevels.empty())
+	{
+		texture.state.store(TextureState::Preview, std::memory_order_release);
+		return true;
+	}
+
+	// every preview level goes in one staging region, each aligned like a region of its own
+	std::vector<VkDeviceSize> levelOffsets;
+	VkDeviceSize size = 0;
+	for (const TextureLevel& level : texture.previewLevels)
+	{
+		levelOffsets.push_back(size);
+		size += (level.data.size() + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	}
+
+	VkDeviceSize offset;
+	if (!allocateStaging(size, &offset))
+	{
+		return false;
+	}
+
+	const TextureLevel& topLevel = texture.previewLevels[0];
+	uint32_t mipLevels = texture.generateMips ? getMipLevelCount(topLevel.width, topLevel.height) :
+		static_cast<uint32_t>(texture.previewLevels.size());
+
+	// like a failed decode, the texture samples the fallback
+	VkCommandBuffer commandBuffer = beginUpload();
+	try
+	{
+		createTextureImage(texture, topLevel, mipLevels, texture.preview);
+	}
+	catch (const std::runtime_error& e)
+	{
+		printf("Failed to load texture %s: %s\n", texture.path.c_str(), e.what());
+		std::vector<TextureLevel>().swap(texture.previewLevels);
+		std::vector<TextureLevel>().swap(texture.levels);
+		texture.state.store(TextureState::Failed, std::memory_order_release);
+		return true;
+	}
+	recordImageBarrier(commandBuffer, texture.preview.image, 0, texture.preview.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+		VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+	for (size_t i = 0; i < texture.previewLevels.size(); i++)
+	{
+		const TextureLevel& level = texture.previewLevels[i];
+		memcpy(stagingMapped + offset + levelOffsets[i], level.data.data(), level.data.size());
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = offset + levelOffsets[i];
+		region.bufferRowLength = 0;		// tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { level.width, level.height, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.preview.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		uploadedBytes += level.data.size();
+	}
+	std::vector<TextureLevel>().swap(texture.previewLevels);
+
+	recordImageCompletion(commandBuffer, texture, texture.preview);
+
+	// an image no larger than the preview is already complete
+	if (texture.levels.empty())
+	{
+		texture.full = texture.preview;
+		texture.preview = TextureImage();
+		texture.state.store(TextureState::Full, std::memory_order_release);
+		return true;
+	}
+
+	texture.state.store(TextureState::Preview, std::memory_order_release);
+	printf("Texture %s previewed at %ux%u after %.1f ms\n", texture.path.c_str(), topLevel.width, topLevel.height,
+		millisecondsSince(texture.loadStart));
+	return true;
+}
+
+bool TextureStreamer::uploadFullLevels(Texture& texture)
+{
+	PROFILE_FUNCTION();
+
+	FormatBlockInfo block = getFormatBlockInfo(texture.format);
+	while (texture.uploadLevel < texture.levels.size())
+	{
+		// as many of the level's remaining block rows as the ring has room for, levels larger than the ring stream over
+		// several frames
+		const TextureLevel& level = texture.levels[texture.uploadLevel];
+		uint32_t blockRows = (level.height + block.height - 1) / block.height;
+		VkDeviceSize rowSize = static_cast<VkDeviceSize>((level.width + block.width - 1) / block.width) * block.bytes;
+		uint32_t rowCount = blockRows - texture.uploadedRows;
+		VkDeviceSize offset = 0;
+		while (rowCount > 0 && !allocateStaging(rowCount * rowSize, &offset))
+		{
+			rowCount /= 2;
+		}
+		if (rowCount == 0)
+		{
+			return false;
+		}
+
+		VkCommandBuffer commandBuffer = beginUpload();
+		if (texture.full.image == VK_NULL_HANDLE)
+		{
+			const TextureLevel& topLevel = texture.levels[0];
+			uint32_t mipLevels = texture.generateMips ? getMipLevelCount(topLevel.width, topLevel.height) :
+				static_cast<uint32_t>(texture.levels.size());
+			// out of memory even after eviction, the preview stays
+			try
+			{
+				createTextureImage(texture, topLevel, mipLevels, texture.full);
+			}
+			catch (const std::runtime_error& e)
+			{
+				printf("Texture %s stays at its preview: %s\n", texture.path.c_str(), e.what());
+				std::vector<TextureLevel>().swap(texture.levels);
+				texture.state.store(TextureState::OverBudget, std::memory_order_release);
+				return true;
+			}
+			residentBytes += texture.full.size;
+			recordImageBarrier(commandBuffer, texture.full.image, 0, texture.full.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+				VK_ACCESS_2_TRANSFER_WRITE_BIT);
+		}
+
+		memcpy(stagingMapped + offset, level.data.data() + texture.uploadedRows * rowSize, rowCount * rowSize);
+
+		// bands write different rows, so they need no barriers between them. The last band of a level can end part way
+		// through its last block
+		uint32_t firstPixelRow = texture.uploadedRows * block.height;
+		VkBufferImageCopy region = {};
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = texture.uploadLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(firstPixelRow), 0 };
+		region.imageExtent = { level.width, std::min(rowCount * block.height, level.height - firstPixelRow), 1 };
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.full.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		texture.uploadedRows += rowCount;
+		uploadedBytes += rowCount * rowSize;
+		if (texture.uploadedRows < blockRows)
+		{
+			// the ring ran out before the last row
+			return false;
+		}
+		texture.uploadLevel++;
+		texture.uploadedRows = 0;
+	}
+
+	// the preview is kept to fall back to if the full image is evicted
+	recordImageCompletion(beginUpload(), texture, texture.full);
+
+	// against the same chain in RGBA8
+	if (isBlockCompressed(texture.format))
+	{
+		for (uint32_t i = 0; i < texture.full.mipLevels; i++)
+		{
+			uint32_t width = std::max(1u, texture.full.width >> i);
+			uint32_t height = std::max(1u, texture.full.height >> i);
+			savedBytes += getLevelSize(VK_FORMAT_R8G8B8A8_UNORM, width, height) - getLevelSize(texture.format, width, height);
+		}
+	}
+
+	std::vector<TextureLevel>().swap(texture.levels);
+	texture.state.store(TextureState::Full, std::memory_order_release);
+	printf("Texture %s fully resident at %ux%u after %.1f ms\n", texture.path.c_str(), texture.width, texture.height,
+		millisecondsSince(texture.loadStart));
+	return true;
+}
+
+void TextureStreamer::recordImageCompletion(VkCommandBuffer commandBuffer, const Texture& texture, const TextureImage& image)
+{
+	if (texture.generateMips)
+	{
+		recordMipGeneration(commandBuffer, image);
+		return;
+	}
+
+	recordImageBarrier(commandBuffer, image.image, 0, image.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+}
+
+void TextureStreamer::recordMipGeneration(VkCommandBuffer commandBuffer, const TextureImage& image)
+{
+	// level 0 has been copied and every level is in TRANSFER_DST. Each level is blitted from the one above it, which first
+	// has to become a transfer source
+	int32_t width = static_cast<int32_t>(image.width);
+	int32_t height = static_cast<int32_t>(image.height);
+	for (uint32_t level = 1; level < image.mipLevels; level++)
+	{
+		recordImageBarrier(commandBuffer, image.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+
+		int32_t halfWidth = std::max(1, width / 2);
+		int32_t halfHeight = std::max(1, height / 2);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.layerCount = 1;
+		blit.dstOffsets[1] = { halfWidth, halfHeight, 1 };
+		vkCmdBlitImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		width = halfWidth;
+		height = halfHeight;
+	}
+
+	// every level but the last was a blit source
+	if (image.mipLevels > 1)
+	{
+		recordImageBarrier(commandBuffer, image.image, 0, image.mipLevels - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+	}
+	recordImageBarrier(commandBuffer, image.image, image.mipLevels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+}
+
+void TextureStreamer::retire(TextureImage& image)
+{
+	if (image.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	RetiredImage retired = {};
+	retired.image = image;
+	retired.tablesRewritten.assign(tableBuffers.size(), false);
+	retired.tablesRemaining = static_cast<uint32_t>(tableBuffers.size());
+	retired.timelineValue = 0;
+	retiredImages.push_back(retired);
+
+	image = TextureImage();
+}
+
+void TextureStreamer::writeTable(uint32_t frameIndex)
+{
+	PROFILE_FUNCTION();
+
+	// textures sample the finest image they have, or the fallback until their preview is resident
+	uint32_t* table = tableMapped[frameIndex];
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		const Texture& texture = *textures[i];
+		if (texture.full.image != VK_NULL_HANDLE && texture.state.load(std::memory_order_acquire) == TextureState::Full)
+		{
+			table[i] = texture.full.sampledIndex;
+		}
+		else if (texture.preview.image != VK_NULL_HANDLE)
+		{
+			table[i] = texture.preview.sampledIndex;
+		}
+		else
+		{
+			table[i] = fallbackIndex;
+		}
+	}
+
+	// once every table has stopped pointing at a retired image, it's free when the frames submitted so far finish
+	for (RetiredImage& retired : retiredImages)
+	{
+		if (retired.tablesRemaining > 0 && !retired.tablesRewritten[frameIndex])
+		{
+			retired.tablesRewritten[frameIndex] = true;
+			retired.tablesRemaining--;
+			if (retired.tablesRemaining == 0)
+			{
+				retired.timelineValue = queue->getLastSubmittedValue();
+			}
+		}
+	}
+}
+
+VkDeviceSize TextureStreamer::evict(uint32_t heapIndex, VkDeviceSize bytes)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (logicalDevice == VK_NULL_HANDLE)
+	{
+		return 0;
+	}
+
+	// newest first, as full images stream in load order. Textures without a preview would fall back to white, so keep
+	// theirs. The memory is released with the rest of the retired images once the tables stop pointing at it
+	VkDeviceSize freed = 0;
+	for (size_t i = textures.size(); i-- > 1 && freed < bytes;)
+	{
+		Texture& texture = *textures[i];
+		if (texture.state.load(std::memory_order_acquire) != TextureState::Full || texture.full.heapIndex != heapIndex ||
+			texture.preview.image == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkDeviceSize size = texture.full.size;
+		printf("Texture %s evicted to its preview, freeing %.2f MB\n", texture.path.c_str(), size / (1024.0 * 1024.0));
+		retire(texture.full);
+		residentBytes -= size;
+		freed += size;
+		texture.state.store(TextureState::OverBudget, std::memory_order_release);
+	}
+	return freed;
+}
\ No newline at end of file
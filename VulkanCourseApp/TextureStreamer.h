@@ -0,0 +1,204 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BindlessDescriptors.h"
+#include "JobSystem.h"
+#include "TextureCompression.h"
+#include "Utilities.h"
+
+// texture handles index the texture table, object data uses NO_TEXTURE for untextured objects
+const uint32_t NO_TEXTURE = ~0u;
+const uint32_t MAX_STREAMED_TEXTURES = 4096;
+
+struct TextureStreamerSettings {
+	VkDeviceSize stagingSize = 16 * 1024 * 1024;		// upload ring, larger images are uploaded in bands of rows over several frames
+	VkDeviceSize memoryBudget = 256 * 1024 * 1024;		// for full resolution images, previews don't count against it
+	uint32_t previewSize = 64;							// largest side of the preview uploaded before the full image
+	bool compress = true;								// block compress RGBA8 KTX2 textures when the device can sample BC1/BC3
+};
+
+struct TextureStreamerStats {
+	uint32_t textureCount = 0;
+	uint32_t decoding = 0;
+	uint32_t previewResident = 0;		// sampled at preview resolution, still streaming or over budget
+	uint32_t fullResident = 0;
+	uint32_t overBudget = 0;
+	uint32_t failed = 0;
+	uint32_t compressed = 0;			// transcoded or loaded block compressed
+	VkDeviceSize residentBytes = 0;		// full resolution images
+	VkDeviceSize savedBytes = 0;		// by block compression, against the same images in RGBA8
+	VkDeviceSize uploadedBytes = 0;
+};
+
+// Textures are decoded on the job system and streamed coarse to fine through a staging ring on the graphics queue: first a
+// preview no larger than previewSize, then the full image while it fits the memory budget. Binary PPMs (RGB8) only upload
+// the top level of each image and generate the mip chain on the GPU by blitting. KTX2 files upload the levels they hold,
+// so can be block compressed: RGBA8 ones are compressed to BC1/BC3 across the job system if the device supports it, and
+// files already in a compressed format (BCn, ETC2, ASTC) go straight into compressed images. Shaders find a texture's
+// image through a per swapchain image table of bindless indices, so a texture can be sampled (as a white fallback until
+// its preview arrives) from the first frame and recorded command buffers never change as it refines. Nothing blocks:
+// staging space and replaced images are reclaimed once the queue's timeline shows the GPU has finished with them.
+// Previews stay resident under the full image, so when the memory telemetry asks for room the newest full images are
+// retired and their textures drop back to the preview
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+	~TextureStreamer();
+
+	// frameCount is the number of texture tables, one per swapchain image
+	void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, QueueTimeline* queue, uint32_t queueFamily,
+		BindlessDescriptors* bindlessDescriptors, JobSystem* jobSystem, uint32_t frameCount, bool anisotropy,
+		const TextureStreamerSettings& settings = TextureStreamerSettings());
+	// the device must be idle
+	void destroy();
+
+	// returns a handle straight away and decodes on the job system. Call from the thread that initialised the job system
+	uint32_t load(const std::string& path);
+
+	// records and submits this frame's uploads, then writes the texture table of frameIndex, whose last submission must
+	// have finished. Call before submitting the frame so it samples what was uploaded
+	void update(uint32_t frameIndex);
+
+	// bindless storage buffer index of the table for frameIndex
+	uint32_t getTableIndex(uint32_t frameIndex) const { return tableBufferIndex[frameIndex]; }
+	TextureStreamerStats getStats() const;
+	void printStats() const;
+
+private:
+	enum class TextureState {
+		Decoding,
+		Decoded,		// preview pixels ready for upload
+		Preview,		// preview sampled, the full image is streaming (or waiting for budget)
+		Full,
+		OverBudget,		// stays at the preview
+		Failed
+	};
+
+	struct TextureImage {
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint32_t sampledIndex = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		VkDeviceSize size = 0;
+		uint32_t heapIndex = 0;
+	};
+
+	struct Texture {
+		std::string path;
+		std::atomic<TextureState> state{ TextureState::Decoding };
+
+		// written by the decode job before state becomes Decoded. Either can be empty: a texture no larger than a preview
+		// has no full levels, and a compressed one without small enough mips has no preview
+		VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+		bool generateMips = false;				// only the top level is uploaded, the rest is blitted from it
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<TextureLevel> levels;
+		std::vector<TextureLevel> previewLevels;
+
+		TextureImage preview;
+		TextureImage full;
+		uint32_t uploadLevel = 0;				// of the full image, levels before it are uploaded
+		uint32_t uploadedRows = 0;				// of uploadLevel, in blocks
+
+		std::chrono::steady_clock::time_point loadStart;
+	};
+
+	// a region of the staging ring, free once the submission that copies from it has finished
+	struct StagingRegion {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint64_t timelineValue;			// 0 until submitted
+	};
+
+	// images replaced by a finer one. The slot can't be released until every table has been rewritten and the frames that
+	// read the old tables have finished
+	struct RetiredImage {
+		TextureImage image;
+		std::vector<bool> tablesRewritten;		// images are acquired out of order, so count each table once
+		uint32_t tablesRemaining;
+		uint64_t timelineValue;					// last submission when the final table was rewritten
+	};
+
+	struct UploadCommandBuffer {
+		VkCommandBuffer commandBuffer;
+		uint64_t timelineValue;
+	};
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice logicalDevice = VK_NULL_HANDLE;
+	QueueTimeline* queue;
+	BindlessDescriptors* bindlessDescriptors;
+	JobSystem* jobSystem;
+	TextureStreamerSettings settings;
+	uint32_t maxImageDimension = 0;		// larger textures fail to decode
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<UploadCommandBuffer> commandBuffers;
+	VkCommandBuffer recordingCommandBuffer = VK_NULL_HANDLE;		// this update's uploads, begun by the first one
+	size_t recordingSlot = 0;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	uint8_t* stagingMapped = nullptr;
+	VkDeviceSize stagingHead = 0;
+	std::deque<StagingRegion> stagingRegions;		// allocation order, so the oldest is at the front
+
+	// handle -> bindless sampled image index, persistently mapped
+	std::vector<VkBuffer> tableBuffers;
+	std::vector<VkDeviceMemory> tableBufferMemory;
+	std::vector<uint32_t*> tableMapped;
+	std::vector<uint32_t> tableBufferIndex;
+
+	std::vector<std::unique_ptr<Texture>> textures;		// pointers stay valid for the decode jobs as textures are added
+	std::vector<RetiredImage> retiredImages;
+	uint32_t fallbackIndex = 0;
+	JobCounter decodeJobs;
+
+	VkDeviceSize residentBytes = 0;
+	VkDeviceSize savedBytes = 0;
+	VkDeviceSize uploadedBytes = 0;
+
+	// eviction runs on whichever thread is allocating, including this one part way through an update
+	mutable std::recursive_mutex mutex;
+	uint32_t evictionHandlerId = 0;
+
+	bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features) const;
+	void decodePpm(Texture& texture);
+	void decodeKtx2(Texture& texture);
+	void choosePreview(Texture& texture);
+
+	void reclaim();
+	bool allocateStaging(VkDeviceSize size, VkDeviceSize* offset);
+	VkCommandBuffer beginUpload();
+	void submitUploads();
+
+	void createTextureImage(const Texture& texture, const TextureLevel& topLevel, uint32_t mipLevels, TextureImage& image);
+	void destroyTextureImage(TextureImage& image);
+	// both return false once the staging ring is full
+	bool uploadPreview(Texture& texture);
+	bool uploadFullLevels(Texture& texture);
+	// from every level in TRANSFER_DST to every level ready to sample
+	void recordImageCompletion(VkCommandBuffer commandBuffer, const Texture& texture, const TextureImage& image);
+	void recordMipGeneration(VkCommandBuffer commandBuffer, const TextureImage& image);
+	void retire(TextureImage& image);
+	void writeTable(uint32_t frameIndex);
+	// the memory telemetry's eviction handler, returns the bytes of the full images retired
+	VkDeviceSize evict(uint32_t heapIndex, VkDeviceSize bytes);
+};
\ No newline at end of file
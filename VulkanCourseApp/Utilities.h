@@ -5,15 +5,53 @@
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
+// GLM_FORCE_DEPTH_ZERO_TO_ONE (Vulkan clip space depth is 0 to 1, not OpenGL's -1 to 1) is defined by the project, so every
+// translation unit sees glm the same way whatever it includes first
 #include <glm/glm.hpp>
 
+#include "MemoryTelemetry.h"
+#include "Profiler.h"
+#include "QueueTimeline.h"
+
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// cameras rendered at once with multiview, matches MAX_VIEWS in the shaders
+const uint32_t MAX_VIEWS = 4;
+
 struct Vertex {
 	glm::vec3 pos;
 	glm::vec3 col;
+	glm::vec2 uv;
+};
+
+// Per-object data read by the culling and vertex shaders (std430 layout, so keep members 16 byte aligned)
+struct ObjectData {
+	glm::mat4 model;
+	glm::vec4 boundingSphere;		// xyz = centre in model space, w = radius
+	uint32_t meshIndex;
+	uint32_t texture;				// texture streamer handle, NO_TEXTURE for vertex colour only
+	uint32_t padding[2];
+};
+
+// Per-mesh draw data read by the culling shader, and by the vertex shader when it pulls vertices
+struct MeshDrawData {
+	uint32_t indexCount;
+	uint32_t firstDraw;				// first command of this mesh's region in the indirect draw buffer
+	uint32_t firstMeshlet;			// in the meshlet buffer, a mesh without meshlets is drawn whole
+	uint32_t meshletCount;
+	VkDeviceAddress positions;		// vertex streams of a pulled mesh, 0 for an interleaved one
+	VkDeviceAddress attributes;
+};
+
+// Cluster of a mesh's triangles read by the culling shader, which draws each visible one as its own index range
+struct Meshlet {
+	glm::vec4 boundingSphere;		// xyz = centre in model space, w = radius
+	glm::vec4 cone;					// xyz = average triangle normal, w = sine of the widest angle to it, 1 if it can't be culled
+	uint32_t firstIndex;			// into the mesh's index buffer
+	uint32_t indexCount;
+	uint32_t padding[2];
 };
 
 // Indices (locations) of queue families (if they even exist)
@@ -57,6 +95,22 @@ static std::vector<char> readFile(const std::string& filepath)
 	return fileBuffer;
 }
 
+static VkShaderModule createShaderModule(VkDevice logicalDevice, const std::vector<char>& code)
+{
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = code.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module!");
+	}
+	return shaderModule;
+}
+
 static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memoryProperties;
@@ -74,14 +128,50 @@ static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t al
 	return -1;
 }
 
+// telemetry category of a buffer, from what it's used for and where it lives
+static MemoryCategory getBufferMemoryCategory(VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags propertyFlags)
+{
+	// vertex streams the vertex shader pulls are the only buffers read through their address
+	if (bufferUsageFlags & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT))
+	{
+		return MemoryCategory::Vertex;
+	}
+	if (bufferUsageFlags & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+	{
+		return MemoryCategory::Index;
+	}
+	if (propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		bool shaderVisible = (bufferUsageFlags & (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)) != 0;
+		if (!shaderVisible && (bufferUsageFlags & VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
+		{
+			return MemoryCategory::Staging;
+		}
+		if (!shaderVisible && (bufferUsageFlags & VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+		{
+			return MemoryCategory::Readback;
+		}
+		return MemoryCategory::Uniform;
+	}
+	return MemoryCategory::Storage;
+}
+
+// buffers used by more than one queue family are shared concurrently between them, rather than transferred back and forth
 static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags,
-	uint32_t memoryTypeIndex, VkBuffer* buffer, VkDeviceMemory* bufferMemory)
+	uint32_t memoryTypeIndex, VkBuffer* buffer, VkDeviceMemory* bufferMemory,
+	const std::vector<uint32_t>& queueFamilies = std::vector<uint32_t>())
 {
 	VkBufferCreateInfo bufferCreateInfo = {};
 	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferCreateInfo.size = bufferSize;
 	bufferCreateInfo.usage = bufferUsageFlags;
 	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (queueFamilies.size() > 1)
+	{
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilies.data();
+	}
 
 	VkResult result = vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer);
 	if (result != VK_SUCCESS)
@@ -98,7 +188,17 @@ static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice
 	memoryAllocateInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,
 		memoryTypeIndex);
 
-	result = vkAllocateMemory(logicalDevice, &memoryAllocateInfo, nullptr, bufferMemory);
+	// buffers read through their address need memory that has one
+	VkMemoryAllocateFlagsInfo allocateFlagsInfo = {};
+	allocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+	allocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+	if (bufferUsageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+	{
+		memoryAllocateInfo.pNext = &allocateFlagsInfo;
+	}
+
+	result = MemoryTelemetry::get().allocate(logicalDevice, memoryAllocateInfo,
+		getBufferMemoryCategory(bufferUsageFlags, memoryTypeIndex), bufferMemory);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to allocate memory for vertex buffer!");
@@ -111,13 +211,21 @@ static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice
 	}
 }
 
-static void copyBuffer(VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer,
-	VkBuffer dstBuffer, VkDeviceSize bufferSize)
+// the buffer needs VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, which createBuffer gives device address memory
+static VkDeviceAddress getBufferDeviceAddress(VkDevice logicalDevice, VkBuffer buffer)
+{
+	VkBufferDeviceAddressInfo addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.buffer = buffer;
+	return vkGetBufferDeviceAddress(logicalDevice, &addressInfo);
+}
+
+static VkCommandBuffer beginCommandBuffer(VkDevice logicalDevice, VkCommandPool commandPool)
 {
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = transferCommandPool;
+	allocInfo.commandPool = commandPool;
 	allocInfo.commandBufferCount = 1;
 
 	VkCommandBuffer commandBuffer = {};
@@ -134,12 +242,11 @@ static void copyBuffer(VkDevice logicalDevice, VkQueue transferQueue, VkCommandP
 
 	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 
-		VkBufferCopy bufferCopyRegion = {};
-		bufferCopyRegion.srcOffset = 0;
-		bufferCopyRegion.dstOffset = 0;
-		bufferCopyRegion.size = bufferSize;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
+	return commandBuffer;
+}
 
+static void endAndSubmitCommandBuffer(VkDevice logicalDevice, VkCommandPool commandPool, QueueTimeline* queue, VkCommandBuffer commandBuffer)
+{
 	vkEndCommandBuffer(commandBuffer);
 
 	VkSubmitInfo submitInfo = {};
@@ -147,8 +254,110 @@ static void copyBuffer(VkDevice logicalDevice, VkQueue transferQueue, VkCommandP
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(transferQueue);
+	PROFILE_ZONE("Upload submit and wait");
+	uint64_t uploadValue = queue->submit(submitInfo);
+	PROFILE_FLOW_BEGIN("Upload submission", uploadValue);
+	{
+		// only this upload has to finish, not frames or other uploads submitted after it
+		PROFILE_ZONE("Wait for upload");
+		queue->wait(uploadValue);
+		PROFILE_FLOW_END("Upload submission", uploadValue);
+	}
+
+	vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+}
+
+static void recordCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize,
+	VkDeviceSize dstOffset = 0)
+{
+	VkBufferCopy bufferCopyRegion = {};
+	bufferCopyRegion.srcOffset = 0;
+	bufferCopyRegion.dstOffset = dstOffset;
+	bufferCopyRegion.size = bufferSize;
+	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
+}
+
+static void copyBuffer(VkDevice logicalDevice, QueueTimeline* transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer,
+	VkBuffer dstBuffer, VkDeviceSize bufferSize)
+{
+	VkCommandBuffer commandBuffer = beginCommandBuffer(logicalDevice, transferCommandPool);
+
+		recordCopyBuffer(commandBuffer, srcBuffer, dstBuffer, bufferSize);
+
+	endAndSubmitCommandBuffer(logicalDevice, transferCommandPool, transferQueue, commandBuffer);
+}
+
+// source of a copy recorded for a later submission, destroyed once that submission has finished
+struct StagingBuffer {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+};
+
+// filled through data, which stays mapped until the memory is freed
+static StagingBuffer createStagingBuffer(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize bufferSize, void** data)
+{
+	StagingBuffer stagingBuffer = {};
+	createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer.buffer, &stagingBuffer.memory);
+	vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, data);
+	return stagingBuffer;
+}
+
+static void destroyStagingBuffer(VkDevice logicalDevice, const StagingBuffer& stagingBuffer)
+{
+	vkDestroyBuffer(logicalDevice, stagingBuffer.buffer, nullptr);
+	MemoryTelemetry::get().release(logicalDevice, stagingBuffer.memory);
+}
 
-	vkFreeCommandBuffers(logicalDevice, transferCommandPool, 1, &commandBuffer);
+static void createImage(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t width, uint32_t height, uint32_t mipLevels,
+	VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkImage* image,
+	VkDeviceMemory* imageMemory)
+{
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent.width = width;
+	imageCreateInfo.extent.height = height;
+	imageCreateInfo.extent.depth = 1;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = format;
+	imageCreateInfo.tiling = tiling;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = usageFlags;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, image);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create image!");
+	}
+
+	VkMemoryRequirements memoryRequirements = {};
+	vkGetImageMemoryRequirements(logicalDevice, *image, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	memoryAllocateInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, propertyFlags);
+
+	// nothing is left behind on failure, so callers that recover from it don't leak
+	result = MemoryTelemetry::get().allocate(logicalDevice, memoryAllocateInfo, MemoryCategory::Image, imageMemory);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(logicalDevice, *image, nullptr);
+		*image = VK_NULL_HANDLE;
+		throw std::runtime_error("Failed to allocate memory for image!");
+	}
+
+	result = vkBindImageMemory(logicalDevice, *image, *imageMemory, 0);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(logicalDevice, *image, nullptr);
+		MemoryTelemetry::get().release(logicalDevice, *imageMemory);
+		*image = VK_NULL_HANDLE;
+		*imageMemory = VK_NULL_HANDLE;
+		throw std::runtime_error("Failed to bind image memory!");
+	}
 }
\ No newline at end of file
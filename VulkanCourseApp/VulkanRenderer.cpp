@@ -2,6 +2,7 @@
 #include <unordered_set>
 #include <algorithm>
 #include <array>
+#include <chrono>
 
 #include "VulkanRenderer.h"
 
@@ -16,6 +17,47 @@ const std::vector<const char*> validationLayers = {
 };
 
 const int MAX_FRAME_DRAWS = 2;
+const uint32_t MAX_PARTICLES = 1 << 20;
+const uint32_t MESHES_PER_DRAW_CHUNK = 64;
+const uint32_t ASYNC_COMPUTE_REPORT_FRAMES = 600;		// frames the async compute overlap is averaged over
+const uint32_t TIMESTAMPS_PER_IMAGE = 4;				// start and end of both parts of an async compute frame
+
+// initialised before main runs, time to first frame is measured from here
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+static double millisecondsSinceStart()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+}
+
+static bool hasVertexColours(const std::vector<Vertex>& vertices)
+{
+	for (const Vertex& vertex : vertices)
+	{
+		if (vertex.col != glm::vec3(1.f))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void recordMemoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+	VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+	VkMemoryBarrier2 memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	memoryBarrier.srcStageMask = srcStage;
+	memoryBarrier.srcAccessMask = srcAccess;
+	memoryBarrier.dstStageMask = dstStage;
+	memoryBarrier.dstAccessMask = dstAccess;
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &memoryBarrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
 
 VulkanRenderer::VulkanRenderer()
 {
@@ -27,57 +69,133 @@ VulkanRenderer::~VulkanRenderer()
 
 int VulkanRenderer::init(GLFWwindow* window)
 {
+	PROFILE_FUNCTION();
+
+	initStart = millisecondsSinceStart();
+
 	this->window = window;
 	try
 	{
-		createInstance();
-		setupDebugMessenger();
-		createSurface();
-		getPhysicalDevice();
-		createLogicalDevice();
-		createSwapchain();
-		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createFramebuffers();
-		createCommandPool();
-
-		mvp.projection = glm::perspective(glm::radians(45.f), (float)swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 100.f);
-		mvp.view = glm::lookAt(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
-		mvp.model = glm::mat4(1.f);
-
-		mvp.projection[1][1] *= -1;	// Vulkan unlike OpenGL treats y axis as a negative, so have to multiply by -1 to work with glm
-
-		std::vector<Vertex> vertices = {
-			{{0.f, -0.4f, 0.f}, {1.f, 0.f, 0.f}},
-			{{0.4f, 0.4f, 0.f}, {0.f, 1.f, 0.f}},
-			{{-0.4f, 0.4f, 0.f}, {0.f, 0.f, 1.f}}
-		};
+		jobSystem.init();
+
+		// Stages run as soon as their inputs exist. Reading SPIR-V and generating mesh data need neither the instance nor
+		// the device, so they start first on the workers while this thread creates the instance, device and swapchain
+		JobCounter shadersLoaded;
+		JobCounter meshesPrepared;
+		queueStartupStage("Load shaders", [this] {
+			ShaderCache::get().preload(jobSystem, {
+				"Shaders/vert.spv", "Shaders/vert_pulled.spv", "Shaders/frag.spv", "Shaders/cull.spv", "Shaders/depth_reduce.spv",
+				"Shaders/particle_emit.spv", "Shaders/particle_simulate.spv", "Shaders/particle_prepare.spv",
+				"Shaders/particle_vert.spv", "Shaders/particle_frag.spv"
+			});
+		}, &shadersLoaded);
+		queueStartupStage("Prepare meshes", [this] { prepareMeshData(); }, &meshesPrepared);
+
+		runStartupStage("Instance", [this] {
+			createInstance();
+			setupDebugMessenger();
+		});
+		runStartupStage("Surface", [this] { createSurface(); });
+		runStartupStage("Physical device", [this] { getPhysicalDevice(); });
+		runStartupStage("Logical device", [this] { createLogicalDevice(); });
+		runStartupStage("Swapchain", [this] {
+			createSwapchain();
+			chooseDepthFormat();
+			chooseMsaaSamples();
+
+			// render targets are sized for the largest scale, so changing the scale never recreates them
+			viewExtent = { swapchainExtent.width / viewCount, swapchainExtent.height };
+			maxRenderExtent = DynamicResolution::scaleExtent(viewExtent, dynamicResolution.getSettings().maxScale);
+			renderExtent = DynamicResolution::scaleExtent(viewExtent, dynamicResolution.getScale());
+			recordedExtents.resize(swapchainImages.size());
+			recordedCullingVersions.assign(swapchainImages.size(), 0);
+		});
+		runStartupStage("Command pools", [this] {
+			createCommandPool();
+			createCommandBuffers();
+			createTimestampQueries();
+		});
+		runStartupStage("Bindless descriptors", [this] {
+			createBindlessDescriptors();
+			particleSystem.create(mainDevice.physicalDevice, mainDevice.logicalDevice, &bindlessDescriptors, MAX_PARTICLES);
+
+			// decoding starts now, uploads start with the first frame
+			textureStreamer.create(mainDevice.physicalDevice, mainDevice.logicalDevice, &graphicsTimeline,
+				static_cast<uint32_t>(getQueueFamilies(mainDevice.physicalDevice).graphicsFamily), &bindlessDescriptors, &jobSystem,
+				static_cast<uint32_t>(swapchainImages.size()), deviceCapabilities.samplerAnisotropy, textureSettings);
+			for (const std::string& path : texturePaths)
+			{
+				textureHandles.push_back(textureStreamer.load(path));
+			}
+		});
+
+		// pipelines compile in parallel with each other and with the uploads. Everything that uses the graphics queue is
+		// one job, as the queue and the upload command pool can only be used by one thread at a time
+		JobCounter pipelinesCreated;
+		queueStartupStage("Graphics pipeline", [this, &shadersLoaded] {
+			// one pipeline per variant the meshes use, which depends on their vertex colours
+			jobSystem.wait(&shadersLoaded);
+			createGraphicsPipeline();
+		}, &pipelinesCreated, &meshesPrepared);
+		queueStartupStage("Compute pipelines", [this] { createComputePipelines(); }, &pipelinesCreated, &shadersLoaded);
+		queueStartupStage("Particle pipelines", [this] {
+			particleSystem.createPipelines(swapchainFormat, depthFormat, msaaSamples, getViewMask());
+		}, &pipelinesCreated, &shadersLoaded);
+
+		JobCounter uploadsDone;
+		queueStartupStage("Uploads", [this] {
+			runStartupStage("Scene", [this] { createScene(); });
+			runStartupStage("Depth pyramid", [this] { createDepthPyramid(); });
+			runStartupStage("Uniform buffers", [this] { createUniformBuffers(); });
+			runStartupStage("Culling buffers", [this] {
+				// the first frame goes in behind the upload on the same queue, nothing has to wait for it here
+				createCullingBuffers();
+				submitUploads();
+			});
+			runStartupStage("Particle buffers", [this] {
+				// simulated on the compute queue, drawn on the graphics queue
+				std::vector<uint32_t> particleQueueFamilies = {
+					static_cast<uint32_t>(getQueueFamilies(mainDevice.physicalDevice).graphicsFamily)
+				};
+				if (asyncCompute)
+				{
+					particleQueueFamilies.push_back(static_cast<uint32_t>(deviceCapabilities.asyncComputeFamily));
+				}
+				particleSystem.createBuffers(&graphicsTimeline, graphicsCommandPool, static_cast<uint32_t>(swapchainImages.size()),
+					particleQueueFamilies);
+			});
+		}, &uploadsDone, &meshesPrepared);
 
-		std::vector<uint32_t> indices = {
-			0, 1, 2
-		};
-		Mesh mesh = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &vertices, &indices);
-		meshes.push_back(mesh);
+		runStartupStage("Synchronisation", [this] { createSynchronisation(); });
 
-		vertices = {
-			{{0.2f, -0.2f, 0.f}, {1.f, 0.f, 0.f}},
-			{{0.6f, 0.6f, 0.f}, {0.f, 1.f, 0.f}},
-			{{-0.2f, 0.6f, 0.f}, {0.f, 0.f, 1.f}}
-		};
+		// this thread runs other stages while it waits
+		runStartupStage("Wait for pipelines", [this, &pipelinesCreated] { jobSystem.wait(&pipelinesCreated); });
+		runStartupStage("Wait for uploads", [this, &uploadsDone] { jobSystem.wait(&uploadsDone); });
+		if (startupError)
+		{
+			std::rethrow_exception(startupError);
+		}
+		ShaderCache::get().clear();
 
-		indices = {
-			0, 1, 2
-		};
-		//mesh = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &vertices, &indices);
-		//meshes.push_back(mesh);
+		runStartupStage("Draw chunks", [this] { createDrawChunks(); });
+		runStartupStage("Render graph", [this] { createRenderGraph(); });
+		runStartupStage("Bindless registration", [this] { registerBindlessResources(); });
+		runStartupStage("Record commands", [this] { recordCommands(); });
+
+		if (captureRequested)
+		{
+			runStartupStage("Frame capture", [this] {
+				frameCapture.create(mainDevice.physicalDevice, mainDevice.logicalDevice,
+					static_cast<uint32_t>(getQueueFamilies(mainDevice.physicalDevice).graphicsFamily), swapchainFormat, swapchainExtent,
+					captureRingSize, captureOutput, capturePrefix, captureConsumer);
+			});
+		}
+		if (startupError)
+		{
+			std::rethrow_exception(startupError);
+		}
 
-		createCommandBuffers();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		recordCommands();
-		createSynchronisation();
+		MemoryTelemetry::get().printSnapshot();
 	}
 	catch (const std::runtime_error& e)
 	{
@@ -85,48 +203,142 @@ int VulkanRenderer::init(GLFWwindow* window)
 		return EXIT_FAILURE;
 	}
 
+	initEnd = millisecondsSinceStart();
+
 	return 0;
 }
 
-void VulkanRenderer::updateModel(glm::mat4 newModel)
+void VulkanRenderer::draw(float deltaTime)
 {
-	mvp.model = newModel;
-}
+	PROFILE_FUNCTION();
 
-void VulkanRenderer::draw()
-{
-	vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
+	{
+		PROFILE_ZONE("Wait for frame");
+		graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+		if (frameNumber >= MAX_FRAME_DRAWS)
+		{
+			PROFILE_FLOW_END("Frame submission", frameNumber - MAX_FRAME_DRAWS);
+		}
+	}
+
+	// frames finish in submission order, so the frames still running are the newest ones. The other frame in flight has
+	// often finished too, which lets capture pick it up a frame early
+	uint64_t completedValue = graphicsTimeline.getCompletedValue();
+	uint64_t completedFrames = frameNumber;
+	for (uint64_t frameValue : frameTimelineValues)
+	{
+		if (frameValue > completedValue)
+		{
+			completedFrames--;
+		}
+	}
+	frameCapture.collect(completedFrames);
+	deletionQueue.collect();
 
 	// get next image to draw and set imageAvailable as signalled
 	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
-	if (result != VK_SUCCESS)
+	VkResult result;
+	{
+		PROFILE_ZONE("Acquire");
+		result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to acquire next available image in swapchain!");
+		}
+	}
+
+	// images can be acquired out of order, so the image's last submission may belong to the other frame in flight. It has to
+	// finish before its command buffer, timestamps and per-image buffers are touched
 	{
-		throw std::runtime_error("Failed to acquire next available image in swapchain!");
+		PROFILE_ZONE("Wait for image");
+		graphicsTimeline.wait(imageTimelineValues[imageIndex]);
 	}
 
-	updateUniformBuffer(imageIndex);
+	updateCullingBuffers();
 
-	// submit command buffer to render, waiting on imageAvailable to start and signalling renderComplete when finished
-	VkPipelineStageFlags stageFlags[] = {
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-	};
+	updateRenderScale(imageIndex);
+	updateCommandBuffer(imageIndex);
+	if (sceneGenerated)
+	{
+		PROFILE_ZONE("Generated scene update");
+		sceneGenerator.update(scene, jobSystem);
+	}
+	updateUniformBuffer(imageIndex);
+	updateObjects(imageIndex);
+	textureStreamer.update(imageIndex);
+	{
+		PROFILE_ZONE("Particle update");
+		particleSystem.update(imageIndex, deltaTime);
+	}
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];
-	submitInfo.pWaitDstStageMask = stageFlags;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderComplete[currentFrame];
-
-	result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]);
-	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to submit command buffer to graphics queue!");
+		PROFILE_ZONE("Submit");
+
+		// with async compute the simulation waits for the previous frame's graphics, which drew the particles it overwrites.
+		// The graphics passes before the particle draw go straight in behind it, then the particle draw waits for the simulation
+		VkSubmitInfo graphicsSubmitInfo = {};
+		graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		graphicsSubmitInfo.commandBufferCount = 1;
+		graphicsSubmitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		if (asyncCompute)
+		{
+			VkSemaphore graphicsSemaphore = graphicsTimeline.getSemaphore();
+			uint64_t previousFrameValue = frameTimelineValues[(currentFrame + MAX_FRAME_DRAWS - 1) % MAX_FRAME_DRAWS];
+			VkPipelineStageFlags computeStageFlags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+			VkSubmitInfo computeSubmitInfo = {};
+			computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			computeSubmitInfo.waitSemaphoreCount = 1;
+			computeSubmitInfo.pWaitSemaphores = &graphicsSemaphore;
+			computeSubmitInfo.pWaitDstStageMask = &computeStageFlags;
+			computeSubmitInfo.commandBufferCount = 1;
+			computeSubmitInfo.pCommandBuffers = &computeCommandBuffers[imageIndex];
+			uint64_t computeValue = computeTimeline.submit(computeSubmitInfo, &previousFrameValue);
+
+			graphicsTimeline.submit(graphicsSubmitInfo);
+
+			// all of the part waits, so its start timestamp is written once the simulation has finished
+			VkSemaphore computeSemaphore = computeTimeline.getSemaphore();
+			VkPipelineStageFlags particleStageFlags = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			graphicsSubmitInfo.waitSemaphoreCount = 1;
+			graphicsSubmitInfo.pWaitSemaphores = &computeSemaphore;
+			graphicsSubmitInfo.pWaitDstStageMask = &particleStageFlags;
+			graphicsSubmitInfo.pCommandBuffers = &particleDrawCommandBuffers[imageIndex];
+			graphicsTimeline.submit(graphicsSubmitInfo, &computeValue);
+		}
+		else
+		{
+			graphicsTimeline.submit(graphicsSubmitInfo);
+		}
+
+		// the upscale into the backbuffer waits on imageAvailable and signals renderComplete when finished. The capture copy
+		// runs after it, before renderComplete is signalled
+		VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		VkCommandBuffer submitCommandBuffers[] = {
+			presentCommandBuffers[imageIndex],
+			frameCapture.isEnabled() ? frameCapture.recordCapture(swapchainImages[imageIndex].image, frameNumber) : VK_NULL_HANDLE
+		};
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];
+		submitInfo.pWaitDstStageMask = &stageFlags;
+		submitInfo.commandBufferCount = submitCommandBuffers[1] != VK_NULL_HANDLE ? 2 : 1;
+		submitInfo.pCommandBuffers = submitCommandBuffers;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &renderComplete[currentFrame];
+
+		// the frame slot and the image are free again once the timeline reaches this value, which also means the image's
+		// simulation has finished
+		uint64_t frameValue = graphicsTimeline.submit(submitInfo);
+		frameTimelineValues[currentFrame] = frameValue;
+		imageTimelineValues[imageIndex] = frameValue;
+		PROFILE_FLOW_BEGIN("Frame submission", frameNumber);
+		if (timestampQueryPool != VK_NULL_HANDLE)
+		{
+			timestampsWritten[imageIndex] = true;
+		}
 	}
 
 	// present rendered image to screen, waiting on renderComplete
@@ -138,26 +350,177 @@ void VulkanRenderer::draw()
 	presentInfo.pSwapchains = &swapchain;
 	presentInfo.pImageIndices = &imageIndex;
 	
-	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
-	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to present rendered image to presentation queue!");
+		PROFILE_ZONE("Present");
+		result = vkQueuePresentKHR(presentationQueue, &presentInfo);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to present rendered image to presentation queue!");
+		}
 	}
 
 	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	frameNumber++;
+
+	if (!startupReported)
+	{
+		printStartupReport();
+		startupReported = true;
+	}
+
+	MemoryTelemetry::get().update();
+}
+
+void VulkanRenderer::setFrameCapture(FrameCaptureOutput output, const std::string& filePrefix, uint32_t ringSize,
+	std::function<void(const CapturedFrame&)> consumer)
+{
+	captureRequested = true;
+	captureOutput = output;
+	capturePrefix = filePrefix;
+	captureRingSize = ringSize;
+	captureConsumer = consumer;
+}
+
+void VulkanRenderer::setViews(uint32_t count, float separation)
+{
+	viewCount = std::max(1u, std::min(count, MAX_VIEWS));
+	viewSeparation = separation;
+}
+
+void VulkanRenderer::setMeshVisible(uint32_t meshIndex, bool visible)
+{
+	if (meshVisible[meshIndex] == visible)
+	{
+		return;
+	}
+
+	if (visible && !meshes[meshIndex].hasBuffers())
+	{
+		throw std::runtime_error("Failed to show mesh, it has been removed!");
+	}
+
+	// meshes added since the last frame don't have a chunk yet, the next frame records theirs
+	meshVisible[meshIndex] = visible;
+	if (meshIndex / MESHES_PER_DRAW_CHUNK < drawChunks.size())
+	{
+		drawChunks[meshIndex / MESHES_PER_DRAW_CHUNK].version++;
+	}
+}
+
+MeshHandle VulkanRenderer::addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	PROFILE_FUNCTION();
+
+	if (vertices.empty() || indices.empty())
+	{
+		throw std::runtime_error("Failed to add mesh, it has no triangles!");
+	}
+
+	MeshKey key = MeshCache::hashGeometry(vertices, indices);
+	MeshHandle mesh = meshCache.acquire(key);
+	if (mesh != MESH_NOT_CACHED)
+	{
+		return mesh;
+	}
+
+	// meshlets reorder the indices, the hash is of the geometry as it was given
+	std::vector<uint32_t> meshIndexData = indices;
+	std::vector<Meshlet> meshlets;
+	if (meshletCulling)
+	{
+		buildMeshlets(vertices, meshIndexData, meshlets);
+	}
+
+	// nothing waits for the upload, it's submitted with the next frame. Handles are never reused, so it always goes on the end
+	mesh = static_cast<MeshHandle>(meshes.size());
+	meshes.push_back(Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, beginUpload(false), &uploadStagingBuffers,
+		&vertices, &meshIndexData, vertexPulling ? MeshVertexLayout::Pulled : MeshVertexLayout::Interleaved));
+	if (meshletCulling)
+	{
+		meshMeshlets.push_back(meshlets);
+	}
+	meshVisible.push_back(true);
+	meshCache.insert(key, mesh);
+
+	// no draw data or draw region until updateCullingBuffers sees the upload has finished
+	meshDraws.push_back(MeshDrawData{});
+	meshDrawCapacity.push_back(0);
+	meshObjectCount.push_back(0);
+	meshUploadValues.push_back(~0ull);
+	pendingMeshes.push_back(mesh);
+
+	// a variant no mesh has used yet gets its pipeline here, between frames, so recording never has to create one
+	meshVertexColours.push_back(hasVertexColours(vertices) ? VK_TRUE : VK_FALSE);
+	getMeshPipeline(mesh);
+
+	return mesh;
+}
+
+void VulkanRenderer::removeMesh(MeshHandle mesh)
+{
+	if (!meshCache.release(mesh))
+	{
+		return;
+	}
+
+	// its upload may not have been submitted yet, and its buffers mustn't go before it
+	submitUploads();
+	pendingMeshes.erase(std::remove(pendingMeshes.begin(), pendingMeshes.end(), mesh), pendingMeshes.end());
+
+	// hiding it re-records its chunk without it before the next submission, so only the frames already submitted still use
+	// its buffers. Its objects still get culled into its draw region until they're compacted away
+	setMeshVisible(mesh, false);
+	meshes[mesh].destroyBuffers(deletionQueue);
+	if (meshletCulling)
+	{
+		meshMeshlets[mesh].clear();
+	}
+	deadObjectCount += meshObjectCount[mesh];
 }
 
 void VulkanRenderer::cleanup()
 {
+	// uploads recorded since the last frame still have to run before their staging buffers go
+	submitUploads();
 	vkDeviceWaitIdle(mainDevice.logicalDevice);
-	
-	vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, descriptorSetLayout, nullptr);
+
+	releaseCullingBuffers();
+	submitUploads();
+	deletionQueue.destroy();
+	frameCapture.destroy();
+
+	particleSystem.destroy();
+	textureStreamer.destroy();
+	bindlessDescriptors.destroy();
 
 	for (size_t i = 0; i < uniformBuffer.size(); i++)
 	{
 		vkDestroyBuffer(mainDevice.logicalDevice, uniformBuffer[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, uniformBufferMemory[i], nullptr);
+		MemoryTelemetry::get().release(mainDevice.logicalDevice, uniformBufferMemory[i]);
+	}
+
+	vkDestroySampler(mainDevice.logicalDevice, depthPyramidSampler, nullptr);
+	for (const VkImageView mipView : depthPyramidMipViews)
+	{
+		vkDestroyImageView(mainDevice.logicalDevice, mipView, nullptr);
+	}
+	vkDestroyImageView(mainDevice.logicalDevice, depthPyramidImageView, nullptr);
+	vkDestroyImage(mainDevice.logicalDevice, depthPyramidImage, nullptr);
+	MemoryTelemetry::get().release(mainDevice.logicalDevice, depthPyramidImageMemory);
+
+	renderGraph.destroy();
+	if (asyncCompute)
+	{
+		computeGraph.destroy();
+	}
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(mainDevice.logicalDevice, timestampQueryPool, nullptr);
+	}
+	if (computeTimestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(mainDevice.logicalDevice, computeTimestampQueryPool, nullptr);
 	}
 
 	for (Mesh& mesh : meshes)
@@ -169,36 +532,56 @@ void VulkanRenderer::cleanup()
 	{
 		vkDestroySemaphore(mainDevice.logicalDevice, renderComplete[i], nullptr);
 		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
-		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
+	}
+	for (const DrawChunk& chunk : drawChunks)
+	{
+		for (const VkCommandPool commandPool : chunk.commandPools)
+		{
+			vkDestroyCommandPool(mainDevice.logicalDevice, commandPool, nullptr);
+		}
+	}
+	for (const VkCommandPool commandPool : recordingCommandPools)
+	{
+		vkDestroyCommandPool(mainDevice.logicalDevice, commandPool, nullptr);
 	}
 	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
-	
-	for (const VkFramebuffer framebuffer : swapchainFramebuffers)
+	if (asyncCompute)
 	{
-		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
+		vkDestroyCommandPool(mainDevice.logicalDevice, computeCommandPool, nullptr);
 	}
 	
-	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, depthReducePipeline, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, depthReducePipelineLayout, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, cullPipelineLayout, nullptr);
+	meshPipelines.destroy(mainDevice.logicalDevice);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
-	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
 
 	for (const SwapchainImage& swapchainImage : swapchainImages)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, swapchainImage.imageView, nullptr);
 	}
 
+	MemoryTelemetry::get().shutdown();
+
 	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
+	computeTimeline.destroy();
+	graphicsTimeline.destroy();
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 	if (enableValidationLayers)
 	{
 		DebugUtilsMessenger::DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 	}
 	vkDestroyInstance(instance, nullptr);
+
+	jobSystem.shutdown();
 }
 
 void VulkanRenderer::createInstance()
 {
+	PROFILE_FUNCTION();
+
 	// check if using validation layers and if the requested layers are available
 	if (enableValidationLayers && !checkValidationLayerSupport())
 	{
@@ -267,6 +650,8 @@ void VulkanRenderer::createInstance()
 
 void VulkanRenderer::getPhysicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -278,14 +663,63 @@ void VulkanRenderer::getPhysicalDevice()
 	std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
 	vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
 
+	// an override picks the device outright, otherwise the suitable device with the highest score wins
+	printf("Devices:\n");
+	bool found = false;
+	uint64_t bestScore = 0;
 	for (const VkPhysicalDevice& device : physicalDevices)
 	{
-		if (checkDeviceSuitable(device))
+		DeviceCapabilities capabilities = queryDeviceCapabilities(device);
+		bool suitable = checkDeviceSuitable(device);
+		bool overridden = !deviceOverride.empty() && matchesDeviceOverride(capabilities, deviceOverride);
+		uint64_t score = scoreDeviceCapabilities(capabilities);
+
+		printf("  %s (%s, %llu MiB, %s): ", capabilities.name.c_str(), getDeviceTypeName(capabilities.type),
+			static_cast<unsigned long long>(capabilities.deviceLocalMemory / (1024 * 1024)), formatDeviceUuid(capabilities.uuid).c_str());
+		if (!suitable)
+		{
+			printf("unsuitable%s\n", overridden ? ", ignoring override" : "");
+			continue;
+		}
+		printf("score %llu%s\n", static_cast<unsigned long long>(score), overridden ? ", matches override" : "");
+
+		if (!deviceOverride.empty() && !overridden)
+		{
+			continue;
+		}
+		if (!found || score > bestScore)
 		{
 			mainDevice.physicalDevice = device;
-			return;
+			deviceCapabilities = capabilities;
+			bestScore = score;
+			found = true;
 		}
 	}
+
+	if (!found)
+	{
+		throw std::runtime_error(deviceOverride.empty() ? "Can't find a suitable GPU!" :
+			"Can't find a suitable GPU matching the device override!");
+	}
+
+	printf("Selected %s (%s)\n", deviceCapabilities.name.c_str(), deviceOverride.empty() ? "highest score" : "override");
+	printf("  async compute queue %s, transfer queue %s, timestamps %s\n", deviceCapabilities.asyncComputeFamily >= 0 ? "yes" : "no",
+		deviceCapabilities.transferFamily >= 0 ? "yes" : "no", deviceCapabilities.timestampValidBits > 0 ? "yes" : "no");
+	printf("  memory budget %s, anisotropy %s, BC textures %s, buffer device address %s, draw parameters %s, pipeline statistics %s\n",
+		deviceCapabilities.memoryBudget ? "yes" : "no", deviceCapabilities.samplerAnisotropy ? "yes" : "no",
+		deviceCapabilities.textureCompressionBC ? "yes" : "no", deviceCapabilities.bufferDeviceAddress ? "yes" : "no",
+		deviceCapabilities.shaderDrawParameters ? "yes" : "no", deviceCapabilities.pipelineStatisticsQuery ? "yes" : "no");
+
+	if (vertexPulling && !deviceCapabilities.bufferDeviceAddress)
+	{
+		printf("Vertex pulling needs buffer device address, using vertex buffers\n");
+		vertexPulling = false;
+	}
+	if (asyncCompute && deviceCapabilities.asyncComputeFamily < 0)
+	{
+		printf("No dedicated compute queue family, particles simulate on the graphics queue\n");
+		asyncCompute = false;
+	}
 }
 
 SwapchainDetails VulkanRenderer::getSwapchainDetails(const VkPhysicalDevice& device) const
@@ -307,9 +741,15 @@ SwapchainDetails VulkanRenderer::getSwapchainDetails(const VkPhysicalDevice& dev
 
 void VulkanRenderer::createLogicalDevice()
 {
+	PROFILE_FUNCTION();
+
 	QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::unordered_set<int> queueFamilyIndices {indices.graphicsFamily, indices.presentationFamily};
+	if (asyncCompute)
+	{
+		queueFamilyIndices.insert(deviceCapabilities.asyncComputeFamily);
+	}
 	
 	// Queues the logical device needs to create and the info to do so
 	for (int i : queueFamilyIndices)
@@ -325,13 +765,58 @@ void VulkanRenderer::createLogicalDevice()
 	}
 	
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	deviceFeatures.multiDrawIndirect = VK_TRUE;				// per-mesh indirect draws with more than one command
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE;		// culling passes the object index through firstInstance
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.drawIndirectCount = VK_TRUE;			// draw count comes from the culling shader
+	vulkan12Features.timelineSemaphore = VK_TRUE;			// submissions are tracked with one timeline per queue
+
+	// descriptor indexing, for the bindless descriptor set
+	vulkan12Features.descriptorIndexing = VK_TRUE;
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+	// the render graph records its passes with dynamic rendering and its barriers with synchronization2
+	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan13Features.dynamicRendering = VK_TRUE;
+	vulkan13Features.synchronization2 = VK_TRUE;
+	vulkan12Features.pNext = &vulkan13Features;
+
+	// optional features are enabled whenever the capability profile has them, code using them checks the profile
+	deviceFeatures.samplerAnisotropy = deviceCapabilities.samplerAnisotropy;
+	deviceFeatures.textureCompressionBC = deviceCapabilities.textureCompressionBC;
+	deviceFeatures.pipelineStatisticsQuery = deviceCapabilities.pipelineStatisticsQuery;
+	vulkan12Features.bufferDeviceAddress = deviceCapabilities.bufferDeviceAddress;
+
+	VkPhysicalDeviceVulkan11Features vulkan11Features = {};
+	vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+	vulkan11Features.multiview = VK_TRUE;			// every view is drawn by the same draws, the shaders pick the camera
+	vulkan11Features.shaderDrawParameters = deviceCapabilities.shaderDrawParameters;
+	vulkan11Features.pNext = &vulkan12Features;
+
+	// memory budget is optional, telemetry falls back to the heap sizes without it
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	if (deviceCapabilities.memoryBudget)
+	{
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan11Features;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
 	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &createInfo, nullptr, &mainDevice.logicalDevice);
@@ -341,11 +826,26 @@ void VulkanRenderer::createLogicalDevice()
 	}
 
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
+	graphicsTimeline.create(mainDevice.logicalDevice, graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+	if (asyncCompute)
+	{
+		vkGetDeviceQueue(mainDevice.logicalDevice, deviceCapabilities.asyncComputeFamily, 0, &computeQueue);
+		computeTimeline.create(mainDevice.logicalDevice, computeQueue);
+		deletionQueue.create({ &graphicsTimeline, &computeTimeline });
+	}
+	else
+	{
+		deletionQueue.create({ &graphicsTimeline });
+	}
+
+	MemoryTelemetry::get().init(mainDevice.physicalDevice, deviceCapabilities.memoryBudget);
 }
 
 void VulkanRenderer::createSurface()
 {
+	PROFILE_FUNCTION();
+
 	VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface);
 	if (result != VK_SUCCESS)
 	{
@@ -355,6 +855,8 @@ void VulkanRenderer::createSurface()
 
 void VulkanRenderer::createSwapchain()
 {
+	PROFILE_FUNCTION();
+
 	SwapchainDetails swapchainDetails = getSwapchainDetails(mainDevice.physicalDevice);
 	uint32_t imageCount = swapchainDetails.surfaceCapabilities.minImageCount + 1;
 	
@@ -365,7 +867,27 @@ void VulkanRenderer::createSwapchain()
 		imageCount = swapchainDetails.surfaceCapabilities.maxImageCount;
 	}
 
+	if ((swapchainDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0)
+	{
+		throw std::runtime_error("Swapchain images can't be transfer destinations!");
+	}
+	if (captureRequested && (swapchainDetails.surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0)
+	{
+		throw std::runtime_error("Swapchain images can't be copied for frame capture!");
+	}
+
 	VkSurfaceFormatKHR surfaceFormat = chooseBestSurfaceFormat(swapchainDetails.surfaceFormats);
+
+	// the scene renders into an image of the same format, which is blitted into the swapchain with linear filtering
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, surfaceFormat.format, &formatProperties);
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures)
+	{
+		throw std::runtime_error("Swapchain format can't be upscaled with a linear blit!");
+	}
+
 	VkExtent2D extent = chooseSwapExtent(swapchainDetails.surfaceCapabilities);
 
 	VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
@@ -376,7 +898,11 @@ void VulkanRenderer::createSwapchain()
 	swapchainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
 	swapchainCreateInfo.imageExtent = extent;
 	swapchainCreateInfo.imageArrayLayers = 1;
-	swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;		// the scene is upscaled into it
+	if (captureRequested)
+	{
+		swapchainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;		// presented images are copied back
+	}
 	swapchainCreateInfo.preTransform = swapchainDetails.surfaceCapabilities.currentTransform;
 	swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	swapchainCreateInfo.presentMode = chooseBestPresentationMode(swapchainDetails.presentationModes);
@@ -426,197 +952,649 @@ void VulkanRenderer::createSwapchain()
 	}
 }
 
-void VulkanRenderer::createRenderPass()
+void VulkanRenderer::chooseDepthFormat()
 {
-	VkAttachmentDescription colourAttachment = {};
-	colourAttachment.format = swapchainFormat;
-	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	PROFILE_FUNCTION();
 
-	// framebuffer data will be stored as an image, but images can be given different data layouts
-	// to give optimal use for certain operations
-	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	
-	VkAttachmentReference colourAttachmentReference = {};
-	colourAttachmentReference.attachment = 0;
-	colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colourAttachmentReference;
-
-	// need to determine when layout transitions can take place using subpass dependencies
-	std::array<VkSubpassDependency, 2> subpassDependencies = {};
-
-	// conversion from VK_IAMGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	// transition must happen after...
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;					// VK_SUBPASS_EXTERNAL means outside of the renderpass
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	// but before...
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
-
-	// conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	// transition must happen after...
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	// but before...
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
-
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pAttachments = &colourAttachment;
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
-	
-	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create render pass!");
-	}
+	// sampled as well as used as an attachment, the depth pyramid is built from it
+	depthFormat = chooseSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
-void VulkanRenderer::createDescriptorSetLayout()
+void VulkanRenderer::chooseMsaaSamples()
 {
-	VkDescriptorSetLayoutBinding layoutBinding = {};
-	layoutBinding.descriptorCount = 1;
-	layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	layoutBinding.binding = 0;
-	layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-	layoutBinding.pImmutableSamplers = nullptr;
+	PROFILE_FUNCTION();
 
-	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
-	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutCreateInfo.bindingCount = 1;
-	layoutCreateInfo.pBindings = &layoutBinding;
+	VkPhysicalDeviceDepthStencilResolveProperties depthResolveProperties = {};
+	depthResolveProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES;
 
-	VkResult result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &layoutCreateInfo, nullptr, &descriptorSetLayout);
-	if (result != VK_SUCCESS)
+	VkPhysicalDeviceProperties2 deviceProperties = {};
+	deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties.pNext = &depthResolveProperties;
+	vkGetPhysicalDeviceProperties2(mainDevice.physicalDevice, &deviceProperties);
+
+	// highest count up to the requested one that both the colour and depth attachments support
+	VkSampleCountFlags supportedCounts = deviceProperties.properties.limits.framebufferColorSampleCounts &
+		deviceProperties.properties.limits.framebufferDepthSampleCounts;
+
+	msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	for (uint32_t samples = VK_SAMPLE_COUNT_2_BIT; samples <= VK_SAMPLE_COUNT_64_BIT && samples <= requestedMsaaSamples; samples *= 2)
 	{
-		throw std::runtime_error("Failed to create a descriptor set layout!");
+		if ((supportedCounts & samples) != 0)
+		{
+			msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+		}
 	}
+
+	// the depth pyramid is built from the resolved depth, keeping the furthest sample keeps occlusion culling conservative.
+	// Sample zero is the only mode every device supports
+	depthResolveMode = (depthResolveProperties.supportedDepthResolveModes & VK_RESOLVE_MODE_MAX_BIT) != 0 ?
+		VK_RESOLVE_MODE_MAX_BIT : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+
+	printf("MSAA: %ux\n", static_cast<uint32_t>(msaaSamples));
 }
 
-void VulkanRenderer::createDescriptorPool()
+void VulkanRenderer::createBindlessDescriptors()
 {
-	VkDescriptorPoolSize poolSize = {};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(uniformBuffer.size());
-	
-	VkDescriptorPoolCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	createInfo.maxSets = static_cast<uint32_t>(uniformBuffer.size());
-	createInfo.poolSizeCount = 1;
-	createInfo.pPoolSizes = &poolSize;
-	
-	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &createInfo, nullptr, &descriptorPool);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create descriptor pool!");
-	}
+	PROFILE_FUNCTION();
+
+	// every pipeline uses the same single set, so the layout is needed before any pipeline is created
+	bindlessDescriptors.create(mainDevice.physicalDevice, mainDevice.logicalDevice);
 }
 
-void VulkanRenderer::createDescriptorSets()
+void VulkanRenderer::registerBindlessResources()
 {
-	descriptorSets.resize(uniformBuffer.size());
-	
-	std::vector<VkDescriptorSetLayout> setLayouts(uniformBuffer.size(), descriptorSetLayout);
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < uniformBuffer.size(); i++)
+	{
+		uniformBufferIndex.push_back(bindlessDescriptors.registerStorageBuffer(uniformBuffer[i]));
+	}
+	registerCullingBuffers();
 
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = descriptorPool;
-	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(uniformBuffer.size());
-	setAllocInfo.pSetLayouts = setLayouts.data();
+	// the depth buffer is read by the first reduction, each pyramid level is written by one reduction and read by the next
+	depthBufferSampledIndex = bindlessDescriptors.registerSampledImage(depthBufferImageView, depthPyramidSampler,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+	depthPyramidSampledIndex = bindlessDescriptors.registerSampledImage(depthPyramidImageView, depthPyramidSampler,
+		VK_IMAGE_LAYOUT_GENERAL);
 
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, descriptorSets.data());
-	if (result != VK_SUCCESS)
+	for (uint32_t i = 0; i < depthPyramidLevels; i++)
 	{
-		throw std::runtime_error("Failed to allocate descriptor sets!");
+		depthPyramidMipSampledIndex.push_back(bindlessDescriptors.registerSampledImage(depthPyramidMipViews[i], depthPyramidSampler,
+			VK_IMAGE_LAYOUT_GENERAL));
+		depthPyramidMipStorageIndex.push_back(bindlessDescriptors.registerStorageImage(depthPyramidMipViews[i]));
 	}
+}
 
-	for (size_t i = 0; i < uniformBuffer.size(); i++)
+void VulkanRenderer::registerCullingBuffers()
+{
+	objectBufferIndex.clear();
+	for (size_t i = 0; i < objectBuffer.size(); i++)
 	{
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = uniformBuffer[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(MVP);
-		
-		VkWriteDescriptorSet mvpSetWrite = {};
-		mvpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		mvpSetWrite.dstSet = descriptorSets[i];
-		mvpSetWrite.dstBinding = 0;
-		mvpSetWrite.dstArrayElement = 0;
-		mvpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		mvpSetWrite.descriptorCount = 1;
-		mvpSetWrite.pBufferInfo = &bufferInfo;
+		objectBufferIndex.push_back(bindlessDescriptors.registerStorageBuffer(objectBuffer[i]));
+	}
 
-		vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &mvpSetWrite, 0, nullptr);
+	meshDrawBufferIndex = bindlessDescriptors.registerStorageBuffer(meshDrawBuffer);
+	indirectDrawBufferIndex = bindlessDescriptors.registerStorageBuffer(indirectDrawBuffer);
+	drawCountBufferIndex = bindlessDescriptors.registerStorageBuffer(drawCountBuffer);
+	visibilityBufferIndex = bindlessDescriptors.registerStorageBuffer(visibilityBuffer);
+	if (meshletBuffer != VK_NULL_HANDLE)
+	{
+		meshletBufferIndex = bindlessDescriptors.registerStorageBuffer(meshletBuffer);
 	}
 }
 
-void VulkanRenderer::updateUniformBuffer(uint32_t imageIndex)
+void VulkanRenderer::releaseCullingBuffers()
 {
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, uniformBufferMemory[imageIndex], 0, sizeof(MVP), 0, &data);
-	memcpy(data, &mvp, sizeof(MVP));
-	vkUnmapMemory(mainDevice.logicalDevice, uniformBufferMemory[imageIndex]);
+	// the descriptors go with the buffers, once the frames in flight and the uploads reading them have finished. Freeing the
+	// memory unmaps the object buffers
+	for (size_t i = 0; i < objectBuffer.size(); i++)
+	{
+		retiredCullingBuffers.push_back({ objectBuffer[i], objectBufferMemory[i], objectBufferIndex[i] });
+	}
+	retiredCullingBuffers.push_back({ meshDrawBuffer, meshDrawBufferMemory, meshDrawBufferIndex });
+	retiredCullingBuffers.push_back({ indirectDrawBuffer, indirectDrawBufferMemory, indirectDrawBufferIndex });
+	retiredCullingBuffers.push_back({ drawCountBuffer, drawCountBufferMemory, drawCountBufferIndex });
+	retiredCullingBuffers.push_back({ visibilityBuffer, visibilityBufferMemory, visibilityBufferIndex });
+	if (meshletBuffer != VK_NULL_HANDLE)
+	{
+		retiredCullingBuffers.push_back({ meshletBuffer, meshletBufferMemory, meshletBufferIndex });
+	}
+
+	objectBuffer.clear();
+	objectBufferMemory.clear();
+	objectBufferMapped.clear();
+	objectBufferIndex.clear();
+	meshletBuffer = VK_NULL_HANDLE;
 }
 
-void VulkanRenderer::createGraphicsPipeline()
+void VulkanRenderer::rebuildCullingBuffers()
 {
-	std::vector<char> vertCode = readFile("Shaders/vert.spv");
-	std::vector<char> fragCode = readFile("Shaders/frag.spv");
+	PROFILE_FUNCTION();
 
-	VkShaderModule vertexShaderModule = createShaderModule(vertCode);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragCode);
+	// new nodes need their world matrices before their objects are created
+	scene.updateTransforms(jobSystem);
 
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexShaderCreateInfo.module = vertexShaderModule;
-	vertexShaderCreateInfo.pName = "main";
+	releaseCullingBuffers();
+	createObjects();
+	createCullingBuffers();
+	registerCullingBuffers();
 
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentShaderCreateInfo.module = fragmentShaderModule;
-	fragmentShaderCreateInfo.pName = "main";
+	// the graph's barriers only depend on how the passes use the buffers, so it just points at the new ones
+	VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * drawCapacity;
+	VkDeviceSize countsSize = sizeof(uint32_t) * meshCapacity;
+	renderGraph.setImportedBuffer(visibilityResource, visibilityBuffer);
+	for (uint32_t late = 0; late < 2; late++)
+	{
+		renderGraph.setImportedBuffer(drawResources[late], indirectDrawBuffer, drawsSize * late, drawsSize);
+		renderGraph.setImportedBuffer(drawCountResources[late], drawCountBuffer, countsSize * late, countsSize);
+	}
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+	// every mesh's draw region moved, so every chunk, and with them every image's primary, is re-recorded before it's next
+	// submitted
+	for (DrawChunk& chunk : drawChunks)
+	{
+		chunk.version++;
+	}
+	cullingVersion++;
 
+	deadObjectCount = 0;
+}
 
-	// Vertex Input
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+void VulkanRenderer::updateCullingBuffers()
+{
+	PROFILE_FUNCTION();
 
-	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions;
-	// position attribute
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);
+	// meshes whose upload, submitted with an earlier frame, has finished
+	std::vector<MeshHandle> uploadedMeshes;
+	for (size_t i = 0; i < pendingMeshes.size();)
+	{
+		if (graphicsTimeline.isComplete(meshUploadValues[pendingMeshes[i]]))
+		{
+			meshUploadValues[pendingMeshes[i]] = 0;
+			uploadedMeshes.push_back(pendingMeshes[i]);
+			pendingMeshes.erase(pendingMeshes.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	// compacting walks the whole scene, so it waits until removed meshes' objects are most of it
+	if (deadObjectCount * 2 > objects.size())
+	{
+		rebuildCullingBuffers();
+	}
+	else
+	{
+		// the uploaded meshes' draw data, with their meshlets on the end of the meshlet buffer
+		uint32_t firstNewMeshlet = meshletEnd;
+		std::vector<Meshlet> newMeshlets;
+		for (MeshHandle mesh : uploadedMeshes)
+		{
+			MeshDrawData& meshDraw = meshDraws[mesh];
+			meshDraw.indexCount = meshes[mesh].getIndexCount();
+			meshDraw.firstMeshlet = meshletEnd;
+			meshDraw.meshletCount = meshletCulling ? static_cast<uint32_t>(meshMeshlets[mesh].size()) : 0;
+			meshDraw.positions = meshes[mesh].getPositionAddress();
+			meshDraw.attributes = meshes[mesh].getAttributeAddress();
+			if (meshletCulling)
+			{
+				newMeshlets.insert(newMeshlets.end(), meshMeshlets[mesh].begin(), meshMeshlets[mesh].end());
+			}
+			meshletEnd += meshDraw.meshletCount;
+			changeMeshDraw(mesh);
+		}
+
+		// nodes added since the last frame, and the ones waiting for a mesh if one has finished uploading. Their objects go on
+		// the end, so they aren't sorted by mesh until the next rebuild
+		std::vector<uint32_t> nodes;
+		if (!uploadedMeshes.empty())
+		{
+			nodes.swap(pendingObjectNodes);
+		}
+		for (uint32_t node = objectSceneNodeCount; node < scene.getNodeCount(); node++)
+		{
+			nodes.push_back(node);
+		}
+		objectSceneNodeCount = scene.getNodeCount();
+
+		uint32_t firstNewObject = static_cast<uint32_t>(objects.size());
+		if (!nodes.empty())
+		{
+			// new nodes need their world matrices before their objects are created
+			scene.updateTransforms(jobSystem);
+			for (uint32_t node : nodes)
+			{
+				addObject(node);
+			}
+		}
+
+		// a mesh whose region is full moves to a free one with room for twice its objects, so meshes gaining objects a few at
+		// a time rarely move. Culling rewrites the draws every frame, nothing is copied
+		for (uint32_t i = firstNewObject; i < objects.size(); i++)
+		{
+			meshObjectCount[objects[i].meshIndex]++;
+		}
+		for (uint32_t i = firstNewObject; i < objects.size(); i++)
+		{
+			uint32_t meshIndex = objects[i].meshIndex;
+			uint32_t drawsPerObject = std::max(meshDraws[meshIndex].meshletCount, 1u);
+			if (meshObjectCount[meshIndex] * drawsPerObject > meshDrawCapacity[meshIndex])
+			{
+				freeDrawRegion(meshDraws[meshIndex].firstDraw, meshDrawCapacity[meshIndex]);
+				meshDrawCapacity[meshIndex] = meshObjectCount[meshIndex] * drawsPerObject * 2;
+				meshDraws[meshIndex].firstDraw = allocateDrawRegion(meshDrawCapacity[meshIndex]);
+				changeMeshDraw(meshIndex);
+			}
+		}
+
+		// a buffer that has run out is replaced by one twice the size. The draw buffers' layout and the object and mesh draw
+		// buffers' bindless indices are baked into every chunk, so growing them re-records all of them
+		bool chunksChanged = false;
+		if (objects.size() > objectCapacity)
+		{
+			uint32_t capacity = std::max(static_cast<uint32_t>(objects.size()), objectCapacity * 2);
+
+			// updateObjects writes all of an image's objects every frame, so the new buffers start out empty
+			VkDeviceSize objectBufferSize = sizeof(ObjectData) * capacity;
+			for (size_t i = 0; i < objectBuffer.size(); i++)
+			{
+				retiredCullingBuffers.push_back({ objectBuffer[i], objectBufferMemory[i], objectBufferIndex[i] });
+				createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &objectBuffer[i], &objectBufferMemory[i]);
+				vkMapMemory(mainDevice.logicalDevice, objectBufferMemory[i], 0, objectBufferSize, 0, &objectBufferMapped[i]);
+				objectBufferIndex[i] = bindlessDescriptors.registerStorageBuffer(objectBuffer[i]);
+			}
+
+			// visibility carries over, the new objects start out not visible
+			growCullingBuffer(sizeof(uint32_t) * capacity, sizeof(uint32_t) * objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&visibilityBuffer, &visibilityBufferMemory, &visibilityBufferIndex);
+			vkCmdFillBuffer(beginUpload(true), visibilityBuffer, sizeof(uint32_t) * objectCapacity, VK_WHOLE_SIZE, 0);
+
+			objectCapacity = capacity;
+			chunksChanged = true;
+		}
+		if (meshes.size() > meshCapacity)
+		{
+			uint32_t capacity = std::max(static_cast<uint32_t>(meshes.size()), meshCapacity * 2);
+
+			// the counts are reset every frame, and every mesh draw is uploaded below
+			growCullingBuffer(sizeof(MeshDrawData) * capacity, 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshDrawBuffer,
+				&meshDrawBufferMemory, &meshDrawBufferIndex);
+			growCullingBuffer(sizeof(uint32_t) * capacity * 2, 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				&drawCountBuffer, &drawCountBufferMemory, &drawCountBufferIndex);
+			changedMeshDrawStart = 0;
+			changedMeshDrawEnd = static_cast<uint32_t>(meshes.size());
+
+			meshCapacity = capacity;
+			chunksChanged = true;
+		}
+		if (drawRegionEnd > drawCapacity)
+		{
+			uint32_t capacity = std::max(drawRegionEnd, drawCapacity * 2);
+			growCullingBuffer(sizeof(VkDrawIndexedIndirectCommand) * capacity * 2, 0,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, &indirectDrawBuffer, &indirectDrawBufferMemory,
+				&indirectDrawBufferIndex);
+
+			drawCapacity = capacity;
+			chunksChanged = true;
+		}
+		if (meshletEnd > meshletCapacity)
+		{
+			uint32_t capacity = std::max(meshletEnd, meshletCapacity * 2);
+			growCullingBuffer(sizeof(Meshlet) * capacity, sizeof(Meshlet) * firstNewMeshlet, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&meshletBuffer, &meshletBufferMemory, &meshletBufferIndex);
+			meshletCapacity = capacity;
+		}
+
+		if (chunksChanged)
+		{
+			VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * drawCapacity;
+			VkDeviceSize countsSize = sizeof(uint32_t) * meshCapacity;
+			renderGraph.setImportedBuffer(visibilityResource, visibilityBuffer);
+			for (uint32_t late = 0; late < 2; late++)
+			{
+				renderGraph.setImportedBuffer(drawResources[late], indirectDrawBuffer, drawsSize * late, drawsSize);
+				renderGraph.setImportedBuffer(drawCountResources[late], drawCountBuffer, countsSize * late, countsSize);
+			}
+
+			for (DrawChunk& chunk : drawChunks)
+			{
+				chunk.version++;
+			}
+		}
+
+		// only the mesh draws that changed and the new meshlets are uploaded, the copies of the old ones above don't overlap them
+		if (changedMeshDrawStart < changedMeshDrawEnd)
+		{
+			uploadToBuffer(meshDrawBuffer, sizeof(MeshDrawData) * changedMeshDrawStart, &meshDraws[changedMeshDrawStart],
+				sizeof(MeshDrawData) * (changedMeshDrawEnd - changedMeshDrawStart));
+		}
+		uploadToBuffer(meshletBuffer, sizeof(Meshlet) * firstNewMeshlet, newMeshlets.data(), sizeof(Meshlet) * newMeshlets.size());
+
+		// the culling dispatch covers every object and reads every buffer through its bindless index
+		if (objects.size() != firstNewObject || chunksChanged || meshletEnd != firstNewMeshlet)
+		{
+			cullingVersion++;
+		}
+	}
+	changedMeshDrawStart = ~0u;
+	changedMeshDrawEnd = 0;
+
+	// new meshes fill up the last chunk and then get chunks of their own
+	uint32_t chunkedMeshes = drawChunks.empty() ? 0 : drawChunks.back().firstMesh + drawChunks.back().meshCount;
+	if (chunkedMeshes < meshes.size())
+	{
+		createDrawChunks();
+	}
+
+	// ahead of the frame, which the final barrier orders after everything uploaded
+	submitUploads();
+}
+
+void VulkanRenderer::growCullingBuffer(VkDeviceSize size, VkDeviceSize copySize, VkBufferUsageFlags usage, VkBuffer* buffer,
+	VkDeviceMemory* bufferMemory, uint32_t* bufferIndex)
+{
+	VkBuffer oldBuffer = *buffer;
+	retiredCullingBuffers.push_back({ *buffer, *bufferMemory, *bufferIndex });
+
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, size,
+		usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffer, bufferMemory);
+	if (copySize > 0)
+	{
+		recordCopyBuffer(beginUpload(true), oldBuffer, *buffer, copySize);
+	}
+	*bufferIndex = bindlessDescriptors.registerStorageBuffer(*buffer);
+}
+
+uint32_t VulkanRenderer::allocateDrawRegion(uint32_t count)
+{
+	// first fit, there are only ever a few free regions between rebuilds
+	for (size_t i = 0; i < freeDrawRegions.size(); i++)
+	{
+		DrawRegion& region = freeDrawRegions[i];
+		if (region.count >= count)
+		{
+			uint32_t first = region.first;
+			region.first += count;
+			region.count -= count;
+			if (region.count == 0)
+			{
+				freeDrawRegions.erase(freeDrawRegions.begin() + i);
+			}
+			return first;
+		}
+	}
+
+	// past the end of the draw buffer grows it
+	uint32_t first = drawRegionEnd;
+	drawRegionEnd += count;
+	return first;
+}
+
+void VulkanRenderer::freeDrawRegion(uint32_t first, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	auto next = std::lower_bound(freeDrawRegions.begin(), freeDrawRegions.end(), first,
+		[](const DrawRegion& region, uint32_t draw) { return region.first < draw; });
+	next = freeDrawRegions.insert(next, { first, count });
+
+	// merged with the free regions either side of it, and given back to the end if it reaches it
+	if (next + 1 != freeDrawRegions.end() && next->first + next->count == (next + 1)->first)
+	{
+		next->count += (next + 1)->count;
+		freeDrawRegions.erase(next + 1);
+	}
+	if (next != freeDrawRegions.begin() && (next - 1)->first + (next - 1)->count == next->first)
+	{
+		(next - 1)->count += next->count;
+		next = freeDrawRegions.erase(next) - 1;
+	}
+	if (next->first + next->count == drawRegionEnd)
+	{
+		drawRegionEnd = next->first;
+		freeDrawRegions.erase(next);
+	}
+}
+
+void VulkanRenderer::changeMeshDraw(uint32_t meshIndex)
+{
+	changedMeshDrawStart = std::min(changedMeshDrawStart, meshIndex);
+	changedMeshDrawEnd = std::max(changedMeshDrawEnd, meshIndex + 1);
+
+	// meshes added since the last frame are recorded by their new chunk
+	if (meshIndex / MESHES_PER_DRAW_CHUNK < drawChunks.size())
+	{
+		drawChunks[meshIndex / MESHES_PER_DRAW_CHUNK].version++;
+	}
+}
+
+VkCommandBuffer VulkanRenderer::beginUpload(bool overwrite)
+{
+	if (uploadCommandBuffer == VK_NULL_HANDLE)
+	{
+		uploadCommandBuffer = beginCommandBuffer(mainDevice.logicalDevice, graphicsCommandPool);
+		uploadOrdered = false;
+	}
+
+	// copies into new buffers, like an added mesh's, start straight away. Only ones over buffers the frames use wait for them
+	if (overwrite && !uploadOrdered)
+	{
+		recordMemoryBarrier(uploadCommandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+		uploadOrdered = true;
+	}
+	return uploadCommandBuffer;
+}
+
+void VulkanRenderer::uploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	void* stagingData;
+	StagingBuffer stagingBuffer = createStagingBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, size, &stagingData);
+	memcpy(stagingData, data, static_cast<size_t>(size));
+	uploadStagingBuffers.push_back(stagingBuffer);
+
+	recordCopyBuffer(beginUpload(true), stagingBuffer.buffer, buffer, size, offset);
+}
+
+void VulkanRenderer::submitUploads()
+{
+	VkCommandBuffer commandBuffer = uploadCommandBuffer;
+	if (commandBuffer != VK_NULL_HANDLE)
+	{
+		// everything submitted after it, frames and later uploads alike, sees what it wrote
+		recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+
+		VkResult result = vkEndCommandBuffer(commandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to stop recording uploads!");
+		}
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		// meshes it uploads are drawn once the timeline reaches this
+		uint64_t value = graphicsTimeline.submit(submitInfo);
+		for (MeshHandle mesh : pendingMeshes)
+		{
+			if (meshUploadValues[mesh] == ~0ull)
+			{
+				meshUploadValues[mesh] = value;
+			}
+		}
+		uploadCommandBuffer = VK_NULL_HANDLE;
+	}
+	else if (retiredCullingBuffers.empty())
+	{
+		return;
+	}
+
+	// queued after the submission, so they wait for it as well as for the frames in flight
+	VkDevice logicalDevice = mainDevice.logicalDevice;
+	VkCommandPool commandPool = graphicsCommandPool;
+	BindlessDescriptors* descriptors = &bindlessDescriptors;
+	std::vector<StagingBuffer> stagingBuffers;
+	stagingBuffers.swap(uploadStagingBuffers);
+	std::vector<RetiredBuffer> retiredBuffers;
+	retiredBuffers.swap(retiredCullingBuffers);
+	deletionQueue.push([logicalDevice, commandPool, descriptors, commandBuffer, stagingBuffers, retiredBuffers]() {
+		if (commandBuffer != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+		}
+		for (const StagingBuffer& stagingBuffer : stagingBuffers)
+		{
+			destroyStagingBuffer(logicalDevice, stagingBuffer);
+		}
+		for (const RetiredBuffer& retiredBuffer : retiredBuffers)
+		{
+			descriptors->releaseStorageBuffer(retiredBuffer.bindlessIndex);
+			vkDestroyBuffer(logicalDevice, retiredBuffer.buffer, nullptr);
+			MemoryTelemetry::get().release(logicalDevice, retiredBuffer.memory);
+		}
+	});
+}
+
+void VulkanRenderer::updateUniformBuffer(uint32_t imageIndex)
+{
+	PROFILE_FUNCTION();
+
+	void* data;
+	vkMapMemory(mainDevice.logicalDevice, uniformBufferMemory[imageIndex], 0, sizeof(MVP), 0, &data);
+	memcpy(data, &mvp, sizeof(MVP));
+	vkUnmapMemory(mainDevice.logicalDevice, uniformBufferMemory[imageIndex]);
+}
+
+void VulkanRenderer::updateObjects(uint32_t imageIndex)
+{
+	PROFILE_FUNCTION();
+
+	scene.updateTransforms(jobSystem);
+
+	// large scenes are megabytes of object data, so refresh and copy it in batches across all threads
+	ObjectData* objectData = static_cast<ObjectData*>(objectBufferMapped[imageIndex]);
+	jobSystem.parallelFor(static_cast<uint32_t>(objects.size()), 0, [this, objectData](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			if (scene.wasUpdated(objectNodes[i]))
+			{
+				objects[i].model = scene.getWorldMatrix(objectNodes[i]);
+			}
+		}
+
+		memcpy(objectData + start, objects.data() + start, sizeof(ObjectData) * (end - start));
+	});
+}
+
+void VulkanRenderer::createGraphicsPipeline()
+{
+	PROFILE_FUNCTION();
+
+	// Pipeline Layout
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawPushConstants);
+
+	VkDescriptorSetLayout bindlessLayout = bindlessDescriptors.getLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	// one pipeline per variant the startup meshes use, meshes added later create theirs in addMesh
+	for (uint32_t i = 0; i < meshVertexColours.size(); i++)
+	{
+		getMeshPipeline(i);
+	}
+}
+
+VkPipeline VulkanRenderer::getMeshPipeline(uint32_t meshIndex)
+{
+	return meshPipelines.getOrCreate(getMeshVariant(meshIndex), [this](const MeshPipelineVariant& variant) {
+		return createMeshPipeline(variant);
+	});
+}
+
+VkPipeline VulkanRenderer::createMeshPipeline(const MeshPipelineVariant& variant)
+{
+	PROFILE_FUNCTION();
+
+	// pulled meshes use a vertex shader that reads the vertex streams instead of vertex input
+	std::vector<char> vertCode = ShaderCache::get().getCode(variant.vertexPulling ? "Shaders/vert_pulled.spv" : "Shaders/vert.spv");
+	VkShaderModule vertexShaderModule = createShaderModule(mainDevice.logicalDevice, vertCode);
+	std::vector<char> fragCode = ShaderCache::get().getCode("Shaders/frag.spv");
+	VkShaderModule fragmentShaderModule = createShaderModule(mainDevice.logicalDevice, fragCode);
+
+	// the constants specialise both stages, vertex pulling only picks the shader and vertex input state
+	SpecializationConstants<MeshShaderConstants> specialization(variant.constants);
+
+	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
+	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertexShaderCreateInfo.module = vertexShaderModule;
+	vertexShaderCreateInfo.pName = "main";
+	vertexShaderCreateInfo.pSpecializationInfo = specialization.getInfo();
+
+	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
+	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragmentShaderCreateInfo.module = fragmentShaderModule;
+	fragmentShaderCreateInfo.pName = "main";
+	fragmentShaderCreateInfo.pSpecializationInfo = specialization.getInfo();
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+
+
+	// Vertex Input
+	VkVertexInputBindingDescription bindingDescription = {};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(Vertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
+	// position attribute
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(Vertex, pos);
 	// colour attribute
 	attributeDescriptions[1].binding = 0;
 	attributeDescriptions[1].location = 1;
 	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
 	attributeDescriptions[1].offset = offsetof(Vertex, col);
+	// texture coordinate attribute
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[2].offset = offsetof(Vertex, uv);
 
 	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
 	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -625,6 +1603,10 @@ void VulkanRenderer::createGraphicsPipeline()
 	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();		// list of vertex attribute descriptions (data format and where to bind to/from)
 
+	// pulled vertices bypass vertex input altogether
+	VkPipelineVertexInputStateCreateInfo pulledVertexInputCreateInfo = {};
+	pulledVertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
 
 	// Input Assembly
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
@@ -638,25 +1620,11 @@ void VulkanRenderer::createGraphicsPipeline()
 	tessellationCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
 
 
-	// Viewport & Scissor
-	VkViewport viewport = {};
-	viewport.x = 0.f;
-	viewport.y = 0.f;
-	viewport.width = (float)swapchainExtent.width;
-	viewport.height = (float)swapchainExtent.height;
-	viewport.minDepth = 0.f;
-	viewport.maxDepth = 1.f;
-
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };
-	scissor.extent = swapchainExtent;
-
+	// Viewport & Scissor (dynamic, the render graph sets them to the render resolution)
 	VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
 	viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportCreateInfo.viewportCount = 1;
-	viewportCreateInfo.pViewports = &viewport;
 	viewportCreateInfo.scissorCount = 1;
-	viewportCreateInfo.pScissors = &scissor;
 
 
 	// Rasterization
@@ -675,250 +1643,1452 @@ void VulkanRenderer::createGraphicsPipeline()
 	VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
 	multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-	multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampleCreateInfo.rasterizationSamples = msaaSamples;
+
+
+	// Depth Stencil
+	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = VK_TRUE;
+	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
+	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+
+	// Color Blend
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+
+	// blending equation uses: (srcColorBlendFactor * newColour) colorBlendOp (dstColorBlendFactor * oldColour)
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
+	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendCreateInfo.logicOpEnable = VK_FALSE;
+	colorBlendCreateInfo.attachmentCount = 1;
+	colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
+
+
+	// Dynamic
+	std::vector<VkDynamicState> dynamicStateEnables;
+	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);		// Can resize in command buffer with vkCmdSetViewport()
+	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);		// Can resize in command buffer with vkCmdSetScissor()
+
+	VkPipelineDynamicStateCreateInfo dynamicCreateInfo = {};
+	dynamicCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
+	dynamicCreateInfo.pDynamicStates = dynamicStateEnables.data();
+
+
+	// Graphics Pipeline
+	// attachment formats the pipeline will render to
+	VkPipelineRenderingCreateInfo renderingCreateInfo = {};
+	renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingCreateInfo.colorAttachmentCount = 1;
+	renderingCreateInfo.pColorAttachmentFormats = &swapchainFormat;
+	renderingCreateInfo.depthAttachmentFormat = depthFormat;
+	renderingCreateInfo.viewMask = getViewMask();
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = &renderingCreateInfo;
+	pipelineCreateInfo.stageCount = 2;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = variant.vertexPulling ? &pulledVertexInputCreateInfo : &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colorBlendCreateInfo;
+	pipelineCreateInfo.pDynamicState = &dynamicCreateInfo;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.renderPass = VK_NULL_HANDLE;		// dynamic rendering, the render graph begins rendering over its attachments
+	pipelineCreateInfo.subpass = 0;
+
+	// pipeline derivatives: can create multiple pipelines that derive from one another
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;			// existing pipeline to derive from
+	pipelineCreateInfo.basePipelineIndex = -1;						// index of pipeline being created to derive from (in case of creating multiple)
+
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
+	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create graphics pipeline!");
+	}
+	return pipeline;
+}
+
+VulkanRenderer::MeshPipelineVariant VulkanRenderer::getMeshVariant(uint32_t meshIndex) const
+{
+	// a mesh whose vertices are all white looks the same without reading their colour. Every mesh has the same vertex layout
+	MeshPipelineVariant variant = {};
+	variant.constants.vertexColour = vertexColours && meshVertexColours[meshIndex] ? VK_TRUE : VK_FALSE;
+	variant.constants.textured = getMeshTexture(meshIndex) != NO_TEXTURE ? VK_TRUE : VK_FALSE;
+	variant.vertexPulling = vertexPulling ? VK_TRUE : VK_FALSE;
+	return variant;
+}
+
+uint32_t VulkanRenderer::getMeshTexture(uint32_t meshIndex) const
+{
+	// textures are spread over the meshes
+	return textureHandles.empty() ? NO_TEXTURE : textureHandles[meshIndex % textureHandles.size()];
+}
+
+void VulkanRenderer::createComputePipelines()
+{
+	PROFILE_FUNCTION();
+
+	// Culling
+	std::vector<char> cullCode = ShaderCache::get().getCode("Shaders/cull.spv");
+	VkShaderModule cullShaderModule = createShaderModule(mainDevice.logicalDevice, cullCode);
+
+	VkPushConstantRange cullPushConstantRange = {};
+	cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullPushConstantRange.offset = 0;
+	cullPushConstantRange.size = sizeof(CullPushConstants);
+
+	VkDescriptorSetLayout bindlessLayout = bindlessDescriptors.getLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &bindlessLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &cullPushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create cull pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = cullShaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = cullPipelineLayout;
+
+	result = vkCreateComputePipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &cullPipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create cull pipeline!");
+	}
+
+	vkDestroyShaderModule(mainDevice.logicalDevice, cullShaderModule, nullptr);
+
+	// Depth Reduction
+	std::vector<char> reduceCode = ShaderCache::get().getCode("Shaders/depth_reduce.spv");
+	VkShaderModule reduceShaderModule = createShaderModule(mainDevice.logicalDevice, reduceCode);
+
+	VkPushConstantRange reducePushConstantRange = {};
+	reducePushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	reducePushConstantRange.offset = 0;
+	reducePushConstantRange.size = sizeof(DepthReducePushConstants);
+
+	pipelineLayoutCreateInfo.pPushConstantRanges = &reducePushConstantRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &depthReducePipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create depth reduce pipeline layout!");
+	}
+
+	pipelineCreateInfo.stage.module = reduceShaderModule;
+	pipelineCreateInfo.layout = depthReducePipelineLayout;
+
+	result = vkCreateComputePipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &depthReducePipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create depth reduce pipeline!");
+	}
+
+	vkDestroyShaderModule(mainDevice.logicalDevice, reduceShaderModule, nullptr);
+}
+
+void VulkanRenderer::createCommandPool()
+{
+	PROFILE_FUNCTION();
+
+	QueueFamilyIndices queueFamilyIndices = getQueueFamilies(mainDevice.physicalDevice);
+	
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+
+	VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &commandPoolCreateInfo, nullptr, &graphicsCommandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create command pool!");
+	}
+
+	// command pools can't be used from two threads at once, so each swapchain image records from its own
+	recordingCommandPools.resize(swapchainImages.size());
+	for (size_t i = 0; i < recordingCommandPools.size(); i++)
+	{
+		result = vkCreateCommandPool(mainDevice.logicalDevice, &commandPoolCreateInfo, nullptr, &recordingCommandPools[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create command pool!");
+		}
+	}
+
+	// compute command buffers are recorded once, all from one thread
+	if (asyncCompute)
+	{
+		commandPoolCreateInfo.queueFamilyIndex = deviceCapabilities.asyncComputeFamily;
+		result = vkCreateCommandPool(mainDevice.logicalDevice, &commandPoolCreateInfo, nullptr, &computeCommandPool);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute command pool!");
+		}
+	}
+}
+
+void VulkanRenderer::createCommandBuffers()
+{
+	PROFILE_FUNCTION();
+
+	commandBuffers.resize(swapchainImages.size());
+	presentCommandBuffers.resize(swapchainImages.size());
+	
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+	// an image's parts come from the same pool, so they are reset and re-recorded together
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+	{
+		commandBufferAllocateInfo.commandPool = recordingCommandPools[i];
+
+		VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &commandBuffers[i]);
+		if (result == VK_SUCCESS)
+		{
+			result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &presentCommandBuffers[i]);
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate command buffers!");
+		}
+	}
+
+	if (!asyncCompute)
+	{
+		return;
+	}
+
+	particleDrawCommandBuffers.resize(swapchainImages.size());
+	computeCommandBuffers.resize(swapchainImages.size());
+	for (size_t i = 0; i < computeCommandBuffers.size(); i++)
+	{
+		commandBufferAllocateInfo.commandPool = recordingCommandPools[i];
+		VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &particleDrawCommandBuffers[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate command buffers!");
+		}
+
+		commandBufferAllocateInfo.commandPool = computeCommandPool;
+		result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &computeCommandBuffers[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate compute command buffers!");
+		}
+	}
+}
+
+void VulkanRenderer::createSynchronisation()
+{
+	PROFILE_FUNCTION();
+
+	imageAvailable.resize(MAX_FRAME_DRAWS);
+	renderComplete.resize(MAX_FRAME_DRAWS);
+	frameTimelineValues.assign(MAX_FRAME_DRAWS, 0);		// 0 is already reached, nothing to wait for
+	imageTimelineValues.assign(swapchainImages.size(), 0);
+	
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	
+	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	{
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderComplete[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create semaphore!");
+		}
+	}
+}
+
+void VulkanRenderer::createTimestampQueries()
+{
+	PROFILE_FUNCTION();
+
+	uint32_t validBits = deviceCapabilities.timestampValidBits;
+	if (validBits == 0)
+	{
+		// still renders, just at a fixed scale
+		printf("Graphics queue doesn't support timestamps, dynamic resolution disabled\n");
+		return;
+	}
+	timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (1ull << validBits) - 1;
+	timestampPeriod = deviceCapabilities.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = static_cast<uint32_t>(swapchainImages.size()) * TIMESTAMPS_PER_IMAGE;
+
+	VkResult result = vkCreateQueryPool(mainDevice.logicalDevice, &queryPoolCreateInfo, nullptr, &timestampQueryPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+	timestampsWritten.assign(swapchainImages.size(), false);
+
+	// overlap is only measured when both queues write timestamps, differences are taken with the fewer valid bits
+	uint32_t computeValidBits = deviceCapabilities.asyncComputeTimestampValidBits;
+	if (!asyncCompute || computeValidBits == 0)
+	{
+		return;
+	}
+	if (computeValidBits < validBits)
+	{
+		timestampMask = (1ull << computeValidBits) - 1;
+	}
+
+	queryPoolCreateInfo.queryCount = static_cast<uint32_t>(swapchainImages.size()) * 2;
+	result = vkCreateQueryPool(mainDevice.logicalDevice, &queryPoolCreateInfo, nullptr, &computeTimestampQueryPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+}
+
+void VulkanRenderer::prepareMeshData()
+{
+	PROFILE_FUNCTION();
+
+	if (!sceneGenerated)
+	{
+		meshVertices = { {
+			{{0.f, -0.4f, 0.f}, {1.f, 0.f, 0.f}, {0.5f, 0.f}},
+			{{0.4f, 0.4f, 0.f}, {0.f, 1.f, 0.f}, {1.f, 1.f}},
+			{{-0.4f, 0.4f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 1.f}}
+		} };
+
+		meshIndices = { {
+			0, 1, 2
+		} };
+	}
+	else
+	{
+		const SceneGeneratorSettings& settings = sceneGenerator.getSettings();
+		printf("Generating scene: seed %u, %u meshes of %u triangles, %u instances, %.1f%% churn, density %.2f\n", settings.seed,
+			settings.meshCount, settings.trianglesPerMesh, settings.instanceCount, settings.churn * 100.f, settings.density);
+
+		// every mesh only depends on the seed and its index
+		meshVertices.resize(settings.meshCount);
+		meshIndices.resize(settings.meshCount);
+		jobSystem.parallelFor(settings.meshCount, 0, [this](uint32_t start, uint32_t end) {
+			for (uint32_t i = start; i < end; i++)
+			{
+				sceneGenerator.generateMesh(i, meshVertices[i], meshIndices[i]);
+			}
+		});
+	}
+
+	// so meshes added later with the same geometry find these. Hashed before meshlets reorder the indices, like added meshes
+	meshKeys.resize(meshVertices.size());
+	meshVertexColours.resize(meshVertices.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(meshVertices.size()), 0, [this](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			meshKeys[i] = MeshCache::hashGeometry(meshVertices[i], meshIndices[i]);
+			meshVertexColours[i] = hasVertexColours(meshVertices[i]) ? VK_TRUE : VK_FALSE;
+		}
+	});
+
+	if (!meshletCulling)
+	{
+		return;
+	}
+
+	// reorders each mesh's indices into meshlet ranges before they're uploaded
+	meshMeshlets.resize(meshVertices.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(meshVertices.size()), 0, [this](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			buildMeshlets(meshVertices[i], meshIndices[i], meshMeshlets[i]);
+		}
+	});
+
+	size_t meshletCount = 0;
+	size_t triangleCount = 0;
+	for (size_t i = 0; i < meshMeshlets.size(); i++)
+	{
+		meshletCount += meshMeshlets[i].size();
+		triangleCount += meshIndices[i].size() / 3;
+	}
+	printf("Built %zu meshlets for %zu meshes, %.1f triangles per meshlet\n", meshletCount, meshMeshlets.size(),
+		meshletCount > 0 ? static_cast<double>(triangleCount) / meshletCount : 0.0);
+}
+
+void VulkanRenderer::createScene()
+{
+	PROFILE_FUNCTION();
+
+	// uploads go through the graphics queue one at a time
+	std::vector<glm::vec4> meshBounds;
+	for (size_t i = 0; i < meshVertices.size(); i++)
+	{
+		Mesh mesh = Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, &graphicsTimeline, graphicsCommandPool, &meshVertices[i],
+			&meshIndices[i], vertexPulling ? MeshVertexLayout::Pulled : MeshVertexLayout::Interleaved);
+		meshes.push_back(mesh);
+		meshBounds.push_back(mesh.getBoundingSphere());
+		meshCache.insert(meshKeys[i], static_cast<MeshHandle>(i));
+	}
+	meshVertices.clear();
+	meshIndices.clear();
+	meshKeys.clear();
+	meshUploadValues.assign(meshes.size(), 0);
+
+	// each view gets its slice of the window
+	float aspect = (float)viewExtent.width / (float)viewExtent.height;
+	glm::mat4 projection = glm::perspective(glm::radians(45.f), aspect, 0.1f, 100.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+	mvp.model = glm::mat4(1.f);
+
+	// every mesh hangs off one root node, which the application animates unless the scene is generated
+	sceneRoot = scene.addNode(SCENE_NO_PARENT, glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+
+	if (!sceneGenerated)
+	{
+		scene.addNode(sceneRoot, glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f), 0, meshBounds[0]);
+	}
+	else
+	{
+		sceneGenerator.populate(scene, sceneRoot, meshBounds);
+
+		// look at the whole placement volume from outside it
+		float radius = sceneGenerator.getRadius();
+		float distance = radius / std::sin(glm::radians(22.5f)) + 0.5f;
+		view = glm::lookAt(glm::vec3(0.f, 0.f, distance), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+		projection = glm::perspective(glm::radians(45.f), aspect, 0.1f, distance + radius + 1.f);
+	}
+
+	projection[1][1] *= -1;	// Vulkan unlike OpenGL treats y axis as a negative, so have to multiply by -1 to work with glm
+
+	// parallel cameras spaced along x, centred on the one above, left to right in view order
+	mvp.viewCount = viewCount;
+	for (uint32_t i = 0; i < viewCount; i++)
+	{
+		float offset = (static_cast<float>(i) - static_cast<float>(viewCount - 1) * 0.5f) * viewSeparation;
+		mvp.projection[i] = projection;
+		mvp.view[i] = glm::translate(glm::mat4(1.f), glm::vec3(-offset, 0.f, 0.f)) * view;
+	}
+
+	scene.updateTransforms(jobSystem);
+	createObjects();
+}
+
+void VulkanRenderer::createObjects()
+{
+	PROFILE_FUNCTION();
+
+	// one culling object per scene node with a mesh
+	objects.clear();
+	objectNodes.clear();
+	pendingObjectNodes.clear();
+	for (uint32_t node = 0; node < scene.getNodeCount(); node++)
+	{
+		addObject(node);
+	}
+	objectSceneNodeCount = scene.getNodeCount();
+
+	sortObjectsByMesh();
+}
+
+void VulkanRenderer::addObject(uint32_t node)
+{
+	uint32_t meshIndex = scene.getMesh(node);
+	if (meshIndex == SCENE_NO_MESH)
+	{
+		return;
+	}
+	if (meshIndex >= meshes.size())
+	{
+		throw std::runtime_error("Failed to create object, its scene node uses a mesh that doesn't exist!");
+	}
+	if (!meshes[meshIndex].hasBuffers())
+	{
+		return;
+	}
+	if (meshUploadValues[meshIndex] != 0)
+	{
+		pendingObjectNodes.push_back(node);
+		return;
+	}
+
+	ObjectData object = {};
+	object.model = scene.getWorldMatrix(node);
+	object.boundingSphere = scene.getLocalBounds(node);
+	object.meshIndex = meshIndex;
+	object.texture = getMeshTexture(meshIndex);
+	objects.push_back(object);
+	objectNodes.push_back(node);
+}
+
+void VulkanRenderer::createUniformBuffers()
+{
+	PROFILE_FUNCTION();
+
+	VkDeviceSize bufferSize = sizeof(MVP);
+
+	uniformBuffer.resize(swapchainImages.size());
+	uniformBufferMemory.resize(swapchainImages.size());
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		// bindless buffers are all storage buffers, MVP is read the same way as everything else
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer[i], &uniformBufferMemory[i]);
+	}
+}
+
+void VulkanRenderer::createCullingBuffers()
+{
+	PROFILE_FUNCTION();
+
+	// each mesh gets a contiguous region of the indirect draw buffer, big enough for every object that uses it to draw
+	// every one of its meshlets. Meshes still uploading, or removed, have no draw data
+	meshDraws.assign(meshes.size(), MeshDrawData{});
+	meshDrawCapacity.assign(meshes.size(), 0);
+	meshObjectCount.assign(meshes.size(), 0);
+	for (const ObjectData& object : objects)
+	{
+		meshObjectCount[object.meshIndex]++;
+	}
+
+	std::vector<Meshlet> meshlets;
+	uint32_t firstDraw = 0;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (!meshes[i].hasBuffers() || meshUploadValues[i] != 0)
+		{
+			continue;
+		}
+
+		meshDraws[i].indexCount = meshes[i].getIndexCount();
+		meshDraws[i].firstDraw = firstDraw;
+		meshDraws[i].firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		meshDraws[i].meshletCount = meshletCulling ? static_cast<uint32_t>(meshMeshlets[i].size()) : 0;
+		meshDraws[i].positions = meshes[i].getPositionAddress();
+		meshDraws[i].attributes = meshes[i].getAttributeAddress();
+		if (meshletCulling)
+		{
+			meshlets.insert(meshlets.end(), meshMeshlets[i].begin(), meshMeshlets[i].end());
+		}
+
+		meshDrawCapacity[i] = meshObjectCount[i] * std::max(meshDraws[i].meshletCount, 1u);
+		firstDraw += meshDrawCapacity[i];
+	}
+	freeDrawRegions.clear();
+	drawRegionEnd = firstDraw;
+	meshletEnd = static_cast<uint32_t>(meshlets.size());
+
+	// exactly what's used, they double when they run out. Removing meshes can leave no objects, buffers still need a size
+	drawCapacity = std::max(firstDraw, 1u);
+	objectCapacity = std::max(static_cast<uint32_t>(objects.size()), 1u);
+	meshCapacity = std::max(static_cast<uint32_t>(meshes.size()), 1u);
+	meshletCapacity = std::max(meshletEnd, 1u);
+
+	// object data can change every frame, so like the uniform buffers there is a host visible copy per swapchain image
+	VkDeviceSize objectBufferSize = sizeof(ObjectData) * objectCapacity;
+
+	objectBuffer.resize(swapchainImages.size());
+	objectBufferMemory.resize(swapchainImages.size());
+	objectBufferMapped.resize(swapchainImages.size());
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &objectBuffer[i], &objectBufferMemory[i]);
+		vkMapMemory(mainDevice.logicalDevice, objectBufferMemory[i], 0, objectBufferSize, 0, &objectBufferMapped[i]);
+	}
+
+	// mesh draw data and meshlets only change as meshes finish uploading, which patches them. Everything is uploaded by the
+	// batch submitted after this, the buffers are also the sources of the copies when they grow
+	VkBufferUsageFlags transferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, sizeof(MeshDrawData) * meshCapacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshDrawBuffer, &meshDrawBufferMemory);
+	uploadToBuffer(meshDrawBuffer, 0, meshDraws.data(), sizeof(MeshDrawData) * meshDraws.size());
+
+	if (meshletCulling)
+	{
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, sizeof(Meshlet) * meshletCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshletBuffer, &meshletBufferMemory);
+		uploadToBuffer(meshletBuffer, 0, meshlets.data(), sizeof(Meshlet) * meshlets.size());
+	}
+
+	// early draws/counts in the first half, late draws/counts in the second half
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, sizeof(VkDrawIndexedIndirectCommand) * drawCapacity * 2,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | transferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirectDrawBuffer, &indirectDrawBufferMemory);
+
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, sizeof(uint32_t) * meshCapacity * 2,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | transferUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawCountBuffer, &drawCountBufferMemory);
+
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, sizeof(uint32_t) * objectCapacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transferUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&visibilityBuffer, &visibilityBufferMemory);
+
+	// nothing was visible "last frame", so the first early pass draws nothing and the late pass picks everything up
+	vkCmdFillBuffer(beginUpload(false), visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+}
+
+void VulkanRenderer::createDepthPyramid()
+{
+	PROFILE_FUNCTION();
+
+	// largest power of two that fits in the swapchain, so that every level is exactly half the size of the one before
+	depthPyramidWidth = 1;
+	while (depthPyramidWidth * 2 <= swapchainExtent.width)
+	{
+		depthPyramidWidth *= 2;
+	}
+
+	depthPyramidHeight = 1;
+	while (depthPyramidHeight * 2 <= swapchainExtent.height)
+	{
+		depthPyramidHeight *= 2;
+	}
+
+	depthPyramidLevels = 1;
+	while ((std::max(depthPyramidWidth, depthPyramidHeight) >> depthPyramidLevels) > 0)
+	{
+		depthPyramidLevels++;
+	}
+
+	createImage(mainDevice.physicalDevice, mainDevice.logicalDevice, depthPyramidWidth, depthPyramidHeight, depthPyramidLevels,
+		VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthPyramidImage, &depthPyramidImageMemory);
+
+	// whole chain for culling to sample from, single levels for the reduction to write to
+	depthPyramidImageView = createImageView(depthPyramidImage, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramidLevels);
+
+	depthPyramidMipViews.resize(depthPyramidLevels);
+	for (uint32_t i = 0; i < depthPyramidLevels; i++)
+	{
+		depthPyramidMipViews[i] = createImageView(depthPyramidImage, VK_FORMAT_R32G32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+	}
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.minLod = 0.f;
+	samplerCreateInfo.maxLod = static_cast<float>(depthPyramidLevels);
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+	VkResult result = vkCreateSampler(mainDevice.logicalDevice, &samplerCreateInfo, nullptr, &depthPyramidSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create depth pyramid sampler!");
+	}
+
+	// the pyramid is both written as a storage image and sampled, so it lives in VK_IMAGE_LAYOUT_GENERAL for good
+	VkCommandBuffer commandBuffer = beginCommandBuffer(mainDevice.logicalDevice, graphicsCommandPool);
+
+	VkImageMemoryBarrier2 imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+	imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = depthPyramidImage;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel = 0;
+	imageBarrier.subresourceRange.levelCount = depthPyramidLevels;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount = 1;
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+	endAndSubmitCommandBuffer(mainDevice.logicalDevice, graphicsCommandPool, &graphicsTimeline, commandBuffer);
+}
+
+void VulkanRenderer::createDrawChunks()
+{
+	PROFILE_FUNCTION();
+
+	// meshes added since the last call are visible until told otherwise
+	meshVisible.resize(meshes.size(), true);
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = getQueueFamilies(mainDevice.physicalDevice).graphicsFamily;
+
+	// new meshes fill up the last chunk before getting chunks of their own
+	uint32_t firstMesh = 0;
+	if (!drawChunks.empty())
+	{
+		DrawChunk& lastChunk = drawChunks.back();
+		lastChunk.meshCount = std::min(MESHES_PER_DRAW_CHUNK, static_cast<uint32_t>(meshes.size()) - lastChunk.firstMesh);
+		lastChunk.version++;
+		firstMesh = lastChunk.firstMesh + MESHES_PER_DRAW_CHUNK;
+	}
+
+	for (; firstMesh < meshes.size(); firstMesh += MESHES_PER_DRAW_CHUNK)
+	{
+		DrawChunk chunk = {};
+		chunk.firstMesh = firstMesh;
+		chunk.meshCount = std::min(MESHES_PER_DRAW_CHUNK, static_cast<uint32_t>(meshes.size()) - firstMesh);
+		chunk.version = 1;
+		chunk.commandPools.resize(swapchainImages.size());
+		chunk.commandBuffers.resize(swapchainImages.size() * 2);
+		chunk.recordedVersions.assign(swapchainImages.size(), 0);
+		chunk.recordedExtents.assign(swapchainImages.size(), VkExtent2D{ 0, 0 });
+
+		for (size_t i = 0; i < swapchainImages.size(); i++)
+		{
+			VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &commandPoolCreateInfo, nullptr, &chunk.commandPools[i]);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create command pool!");
+			}
+
+			VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.commandPool = chunk.commandPools[i];
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			commandBufferAllocateInfo.commandBufferCount = 2;
+
+			result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &chunk.commandBuffers[i * 2]);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate command buffers!");
+			}
+		}
+
+		drawChunks.push_back(chunk);
+	}
+}
+
+void VulkanRenderer::createRenderGraph()
+{
+	PROFILE_FUNCTION();
+
+	renderGraph.init(mainDevice.physicalDevice, mainDevice.logicalDevice);
+
+	std::vector<VkImage> swapchainImageHandles;
+	std::vector<VkImageView> swapchainImageViews;
+	for (const SwapchainImage& swapchainImage : swapchainImages)
+	{
+		swapchainImageHandles.push_back(swapchainImage.image);
+		swapchainImageViews.push_back(swapchainImage.imageView);
+	}
+
+	RenderGraphResource backbuffer = renderGraph.importImage("Backbuffer", swapchainFormat, swapchainExtent, swapchainImageHandles,
+		swapchainImageViews, false, RenderGraphAccess::Present);
+
+	// the scene renders into the top left of images big enough for the largest render scale, and is then upscaled into the
+	// backbuffer. With multiview every image has a layer per view
+	RenderGraphResource sceneColour = renderGraph.createImage("Scene colour", swapchainFormat, maxRenderExtent,
+		VK_SAMPLE_COUNT_1_BIT, viewCount);
+
+	// with MSAA the scene renders into multisampled transients: colour is resolved into the scene colour by the last pass,
+	// and the early pass's depth is resolved for the depth pyramid. Neither multisampled image is stored at the end of the frame
+	bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+	RenderGraphResource colour = multisampled ?
+		renderGraph.createImage("MSAA colour", swapchainFormat, maxRenderExtent, msaaSamples, viewCount) : sceneColour;
+	RenderGraphResource depth = renderGraph.createImage("Depth", depthFormat, maxRenderExtent, msaaSamples, viewCount);
+
+	// the depth pyramid only covers one camera, so occlusion culling is off with multiview and the late pass just draws what
+	// the early pass's frustum test missed
+	bool occlusionCulling = viewCount == 1;
+	RenderGraphResource resolvedDepth = multisampled && occlusionCulling ?
+		renderGraph.createImage("Resolved depth", depthFormat, maxRenderExtent) : depth;
+	RenderGraphResource depthPyramid = renderGraph.importImage("Depth pyramid", VK_FORMAT_R32G32_SFLOAT,
+		{ depthPyramidWidth, depthPyramidHeight }, { depthPyramidImage }, { depthPyramidImageView }, true);
+
+	// early and late halves are separate resources, so one pass's draws don't wait on the other's
+	VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * drawCapacity;
+	VkDeviceSize countsSize = sizeof(uint32_t) * meshCapacity;
+	visibilityResource = renderGraph.importBuffer("Visibility", visibilityBuffer);
+	drawResources[0] = renderGraph.importBuffer("Early draws", indirectDrawBuffer, 0, drawsSize);
+	drawResources[1] = renderGraph.importBuffer("Late draws", indirectDrawBuffer, drawsSize, drawsSize);
+	drawCountResources[0] = renderGraph.importBuffer("Early draw counts", drawCountBuffer, 0, countsSize);
+	drawCountResources[1] = renderGraph.importBuffer("Late draw counts", drawCountBuffer, countsSize, countsSize);
+
+	// particles only depend on their own last frame, so simulate them first, or on the compute queue alongside the frame
+	if (asyncCompute)
+	{
+		computeGraph.init(mainDevice.physicalDevice, mainDevice.logicalDevice);
+		particleSystem.addSimulationPasses(computeGraph);
+		computeGraph.compile();
+	}
+	else
+	{
+		particleSystem.addSimulationPasses(renderGraph);
+	}
+
+	VkClearValue colourClear = {};
+	colourClear.color = { {0.1f, 0.3f, 0.4f, 1.f} };
+	VkClearValue depthClear = {};
+	depthClear.depthStencil.depth = 1.f;
+
+	// early: draw what was visible last frame, late: test everything against the depth the early pass produced and draw
+	// what it missed
+	for (uint32_t late = 0; late < 2; late++)
+	{
+		bool latePass = late == 1;
+
+		RenderGraphPass pass = renderGraph.addPass(latePass ? "Reset late draw counts" : "Reset early draw counts",
+			RenderGraphPassType::Transfer, [this, latePass](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+			// the count buffer grows as meshes are added
+			VkDeviceSize countsSize = sizeof(uint32_t) * meshCapacity;
+			vkCmdFillBuffer(commandBuffer, drawCountBuffer, latePass ? countsSize : 0, countsSize, 0);
+		});
+		renderGraph.write(pass, drawCountResources[late], RenderGraphAccess::TransferWrite);
+
+		pass = renderGraph.addPass(latePass ? "Late cull" : "Early cull", RenderGraphPassType::Compute,
+			[this, latePass](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+			recordCulling(commandBuffer, imageIndex, latePass);
+		});
+		if (latePass)
+		{
+			if (occlusionCulling)
+			{
+				renderGraph.read(pass, depthPyramid, RenderGraphAccess::ComputeRead);
+			}
+			renderGraph.write(pass, visibilityResource, RenderGraphAccess::ComputeWrite);
+		}
+		else
+		{
+			renderGraph.read(pass, visibilityResource, RenderGraphAccess::ComputeRead);
+		}
+		renderGraph.write(pass, drawResources[late], RenderGraphAccess::ComputeWrite);
+		renderGraph.write(pass, drawCountResources[late], RenderGraphAccess::ComputeWrite);
+
+		// the draws themselves are in the chunks' secondary command buffers
+		pass = renderGraph.addPass(latePass ? "Late draw" : "Early draw", RenderGraphPassType::Raster,
+			[this, latePass](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+			std::vector<VkCommandBuffer> chunkCommandBuffers;
+			for (const DrawChunk& chunk : drawChunks)
+			{
+				chunkCommandBuffers.push_back(chunk.commandBuffers[imageIndex * 2 + (latePass ? 1 : 0)]);
+			}
+			if (!chunkCommandBuffers.empty())
+			{
+				vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkCommandBuffers.size()), chunkCommandBuffers.data());
+			}
+		});
+		renderGraph.setSecondaryContents(pass);
+		renderGraph.setViewMask(pass, getViewMask());
+		renderGraph.read(pass, drawResources[late], RenderGraphAccess::IndirectRead);
+		renderGraph.read(pass, drawCountResources[late], RenderGraphAccess::IndirectRead);
+		renderGraph.write(pass, colour, RenderGraphAccess::ColourAttachment, latePass ? nullptr : &colourClear);
+		renderGraph.write(pass, depth, RenderGraphAccess::DepthAttachment, latePass ? nullptr : &depthClear);
+
+		if (!latePass && occlusionCulling)
+		{
+			if (multisampled)
+			{
+				renderGraph.resolve(pass, depth, resolvedDepth, depthResolveMode);
+			}
+
+			pass = renderGraph.addPass("Depth pyramid", RenderGraphPassType::Compute, [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+				recordDepthPyramid(commandBuffer, imageIndex);
+			});
+			renderGraph.read(pass, resolvedDepth, RenderGraphAccess::ComputeSampled);
+			renderGraph.write(pass, depthPyramid, RenderGraphAccess::ComputeWrite);
+		}
+	}
+
+	RenderGraphPass lastPass = particleSystem.addDrawPass(renderGraph, colour, depth, &uniformBufferIndex);
+	renderGraph.setViewMask(lastPass, getViewMask());
+	if (multisampled)
+	{
+		renderGraph.resolve(lastPass, colour, sceneColour);
+	}
+	computeWaitPass = lastPass;
+
+	// the extent the command buffer was recorded with decides how much of the scene colour is valid. Each view's layer goes
+	// side by side into the backbuffer
+	upscalePass = renderGraph.addPass("Upscale", RenderGraphPassType::Transfer,
+		[this, sceneColour](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+		std::vector<VkImageBlit> regions(viewCount);
+		for (uint32_t i = 0; i < viewCount; i++)
+		{
+			VkImageBlit& region = regions[i];
+			region = {};
+			region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.baseArrayLayer = i;
+			region.srcSubresource.layerCount = 1;
+			region.srcOffsets[1] = { static_cast<int32_t>(recordedExtents[imageIndex].width),
+				static_cast<int32_t>(recordedExtents[imageIndex].height), 1 };
+			region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.dstSubresource.layerCount = 1;
+			region.dstOffsets[0] = { static_cast<int32_t>(viewExtent.width * i), 0, 0 };
+			region.dstOffsets[1] = { static_cast<int32_t>(viewExtent.width * (i + 1)), static_cast<int32_t>(viewExtent.height), 1 };
+		}
 
+		vkCmdBlitImage(commandBuffer, renderGraph.getImage(sceneColour, imageIndex), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			swapchainImages[imageIndex].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+			regions.data(), VK_FILTER_LINEAR);
+	});
+	renderGraph.read(upscalePass, sceneColour, RenderGraphAccess::TransferRead);
+	renderGraph.write(upscalePass, backbuffer, RenderGraphAccess::TransferWrite);
 
-	// Depth Stencil (todo: setup depth stencil testing)
-	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	renderGraph.compile();
 
+	depthBufferImageView = renderGraph.getImageView(resolvedDepth);
+}
 
-	// Color Blend
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-		VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_TRUE;
+void VulkanRenderer::sortObjectsByMesh()
+{
+	// neighbouring culling threads then append to the same mesh's draw count, and draws of a mesh read contiguous object data
+	std::vector<uint64_t> sortKeys(objects.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(objects.size()), 0, [this, &sortKeys](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			sortKeys[i] = (static_cast<uint64_t>(objects[i].meshIndex) << 32) | i;
+		}
+	});
 
-	// blending equation uses: (srcColorBlendFactor * newColour) colorBlendOp (dstColorBlendFactor * oldColour)
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	std::sort(sortKeys.begin(), sortKeys.end());
 
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	std::vector<ObjectData> sortedObjects(objects.size());
+	std::vector<uint32_t> sortedObjectNodes(objects.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(objects.size()), 0,
+		[this, &sortKeys, &sortedObjects, &sortedObjectNodes](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			uint32_t objectIndex = static_cast<uint32_t>(sortKeys[i]);
+			sortedObjects[i] = objects[objectIndex];
+			sortedObjectNodes[i] = objectNodes[objectIndex];
+		}
+	});
 
-	VkPipelineColorBlendStateCreateInfo colorBlendCreateInfo = {};
-	colorBlendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendCreateInfo.logicOpEnable = VK_FALSE;
-	colorBlendCreateInfo.attachmentCount = 1;
-	colorBlendCreateInfo.pAttachments = &colorBlendAttachment;
+	objects.swap(sortedObjects);
+	objectNodes.swap(sortedObjectNodes);
+}
+
+void VulkanRenderer::runStartupStage(const char* name, const std::function<void()>& function)
+{
+	{
+		std::lock_guard<std::mutex> lock(startupMutex);
+		if (startupError)
+		{
+			return;
+		}
+	}
 
+	StartupStage stage = {};
+	stage.name = name;
+	stage.thread = jobSystem.getThreadIndex();
+	stage.start = millisecondsSinceStart();
 
-	// Dynamic (todo: setup to make window resizable)
-	/*
-	std::vector<VkDynamicState> dynamicStateEnables;
-	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);		// Can resize in command buffer with vkCmdSetViewport()
-	dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);		// Can resize in command buffer with vkCmdSetScissor()
+	try
+	{
+		PROFILE_ZONE(name);
+		function();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(startupMutex);
+		if (!startupError)
+		{
+			startupError = std::current_exception();
+		}
+	}
 
-	VkPipelineDynamicStateCreateInfo dynamicCreateInfo = {};
-	dynamicCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-	dynamicCreateInfo.pDynamicStates = dynamicStateEnables.data();
-	*/
+	stage.duration = millisecondsSinceStart() - stage.start;
 
+	std::lock_guard<std::mutex> lock(startupMutex);
+	startupStages.push_back(stage);
+}
 
-	// Pipeline Layout
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = 1;
-	pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+void VulkanRenderer::queueStartupStage(const char* name, std::function<void()> function, JobCounter* counter,
+	const JobCounter* dependency)
+{
+	// jobs must not throw, runStartupStage keeps the exception for init
+	jobSystem.run([this, name, function]() {
+		runStartupStage(name, function);
+	}, counter, dependency);
+}
 
-	VkResult result = vkCreatePipelineLayout(mainDevice.logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
-	if (result != VK_SUCCESS)
+void VulkanRenderer::printStartupReport()
+{
+	std::vector<StartupStage> stages;
 	{
-		throw std::runtime_error("Failed to create pipeline layout!");
+		std::lock_guard<std::mutex> lock(startupMutex);
+		stages = startupStages;
+	}
+	std::sort(stages.begin(), stages.end(), [](const StartupStage& a, const StartupStage& b) { return a.start < b.start; });
+
+	// stage times overlap, the init time is what they add up to on the critical path
+	printf("Startup: first frame presented %.1f ms after process start, init took %.1f ms on %u threads\n",
+		millisecondsSinceStart(), initEnd - initStart, jobSystem.getThreadCount());
+	for (const StartupStage& stage : stages)
+	{
+		printf("  %-22s start %8.1f ms  duration %8.1f ms  thread %u\n", stage.name, stage.start, stage.duration, stage.thread);
 	}
+}
 
+void VulkanRenderer::updateRenderScale(uint32_t imageIndex)
+{
+	PROFILE_FUNCTION();
 
-	// Graphics Pipeline
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;
-	pipelineCreateInfo.pStages = shaderStages;
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
-	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-	pipelineCreateInfo.pTessellationState = nullptr;
-	pipelineCreateInfo.pViewportState = &viewportCreateInfo;
-	pipelineCreateInfo.pRasterizationState = &rasterizationCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = nullptr;
-	pipelineCreateInfo.pColorBlendState = &colorBlendCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.layout = pipelineLayout;
-	pipelineCreateInfo.renderPass = renderPass;
-	pipelineCreateInfo.subpass = 0;
+	// the image's last submission has finished, so its timestamps are available without waiting. Without async compute the
+	// scene is one part
+	if (timestampQueryPool != VK_NULL_HANDLE && timestampsWritten[imageIndex])
+	{
+		uint64_t timestamps[TIMESTAMPS_PER_IMAGE];
+		uint32_t timestampCount = asyncCompute ? 4 : 2;
+		VkResult result = vkGetQueryPoolResults(mainDevice.logicalDevice, timestampQueryPool, imageIndex * TIMESTAMPS_PER_IMAGE,
+			timestampCount, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			uint64_t ticks = 0;
+			for (uint32_t i = 0; i < timestampCount; i += 2)
+			{
+				ticks += (timestamps[i + 1] - timestamps[i]) & timestampMask;
+			}
+			float gpuFrameTime = static_cast<float>(ticks) * timestampPeriod / 1000000.f;
+			if (dynamicResolution.update(gpuFrameTime))
+			{
+				renderExtent = DynamicResolution::scaleExtent(viewExtent, dynamicResolution.getScale());
+				printf("Render scale %.2f (%ux%u), GPU frame %.2f ms\n", dynamicResolution.getScale(), renderExtent.width,
+					renderExtent.height, dynamicResolution.getSmoothedFrameTime());
+			}
 
-	// pipeline derivatives: can create multiple pipelines that derive from one another
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;			// existing pipeline to derive from
-	pipelineCreateInfo.basePipelineIndex = -1;						// index of pipeline being created to derive from (in case of creating multiple)
-	
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
+			if (computeTimestampQueryPool != VK_NULL_HANDLE)
+			{
+				updateAsyncComputeOverlap(imageIndex, timestamps[0], timestamps[timestampCount - 1]);
+			}
+		}
+	}
+}
+
+void VulkanRenderer::updateAsyncComputeOverlap(uint32_t imageIndex, uint64_t frameStart, uint64_t frameEnd)
+{
+	// the image's graphics submission waited for its compute submission, so these are available too
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(mainDevice.logicalDevice, computeTimestampQueryPool, imageIndex * 2, 2, sizeof(timestamps),
+		timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create graphics pipeline!");
+		return;
 	}
 
-	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
+	// ticks from the start of the graphics frame, negative if the compute work started first
+	auto sinceFrameStart = [this, frameStart](uint64_t timestamp) {
+		uint64_t ticks = (timestamp - frameStart) & timestampMask;
+		return ticks > timestampMask / 2 ? -static_cast<double>((frameStart - timestamp) & timestampMask) : static_cast<double>(ticks);
+	};
+	double graphicsEnd = static_cast<double>((frameEnd - frameStart) & timestampMask);
+	double computeStart = sinceFrameStart(timestamps[0]);
+	double computeEnd = sinceFrameStart(timestamps[1]);
+	double overlap = std::max(0.0, std::min(graphicsEnd, computeEnd) - std::max(0.0, computeStart));
+
+	computeTime += (computeEnd - computeStart) * timestampPeriod / 1000000.0;
+	overlapTime += overlap * timestampPeriod / 1000000.0;
+	if (++overlapFrames < ASYNC_COMPUTE_REPORT_FRAMES)
+	{
+		return;
+	}
+
+	printf("Async compute %.3f ms per frame, %.0f%% overlapped with graphics\n", computeTime / overlapFrames,
+		computeTime > 0.0 ? overlapTime / computeTime * 100.0 : 0.0);
+	computeTime = 0.0;
+	overlapTime = 0.0;
+	overlapFrames = 0;
 }
 
-void VulkanRenderer::createFramebuffers()
+void VulkanRenderer::updateCommandBuffer(uint32_t imageIndex)
 {
-	swapchainFramebuffers.resize(swapchainImages.size());
+	PROFILE_FUNCTION();
 
-	for (size_t i = 0; i < swapchainFramebuffers.size(); i++)
+	// the scale only moves in steps and meshes rarely change visibility, so usually nothing is re-recorded
+	std::vector<uint32_t> staleChunks;
+	for (uint32_t i = 0; i < drawChunks.size(); i++)
 	{
-		std::array<VkImageView, 1> attachment {
-			swapchainImages[i].imageView 
-		};
-		
-		VkFramebufferCreateInfo framebufferCreateInfo = {};
-		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo.renderPass = renderPass;
-		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachment.size());
-		framebufferCreateInfo.pAttachments = attachment.data();
-		framebufferCreateInfo.width = swapchainExtent.width;
-		framebufferCreateInfo.height = swapchainExtent.height;
-		framebufferCreateInfo.layers = 1;
-		
-		VkResult result = vkCreateFramebuffer(mainDevice.logicalDevice, &framebufferCreateInfo, nullptr, &swapchainFramebuffers[i]);
+		const DrawChunk& chunk = drawChunks[i];
+		if (chunk.recordedVersions[imageIndex] != chunk.version || chunk.recordedExtents[imageIndex].width != renderExtent.width ||
+			chunk.recordedExtents[imageIndex].height != renderExtent.height)
+		{
+			staleChunks.push_back(i);
+		}
+	}
+
+	jobSystem.parallelFor(static_cast<uint32_t>(staleChunks.size()), 1, [this, &staleChunks, imageIndex](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			recordDrawChunk(staleChunks[i], imageIndex);
+		}
+	});
+
+	// re-recording a secondary invalidates the primary executing it, as do new objects or culling buffers for the culling
+	// dispatch. The primary is only barriers and a few commands per pass and chunk, so that's cheap
+	if (!staleChunks.empty() || recordedCullingVersions[imageIndex] != cullingVersion ||
+		recordedExtents[imageIndex].width != renderExtent.width || recordedExtents[imageIndex].height != renderExtent.height)
+	{
+		VkResult result = vkResetCommandPool(mainDevice.logicalDevice, recordingCommandPools[imageIndex], 0);
 		if (result != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create framebuffer!");
+			throw std::runtime_error("Failed to reset command pool!");
 		}
+		recordCommandBuffer(imageIndex);
 	}
 }
 
-void VulkanRenderer::createCommandPool()
+void VulkanRenderer::recordCommands()
 {
-	QueueFamilyIndices queueFamilyIndices = getQueueFamilies(mainDevice.physicalDevice);
-	
-	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
-	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+	PROFILE_FUNCTION();
 
-	VkResult result = vkCreateCommandPool(mainDevice.logicalDevice, &commandPoolCreateInfo, nullptr, &graphicsCommandPool);
-	if (result != VK_SUCCESS)
+	// every chunk records into its own pool for each image, so all of them can be recorded in parallel
+	uint32_t imageCount = static_cast<uint32_t>(commandBuffers.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(drawChunks.size()) * imageCount, 0, [this, imageCount](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			recordDrawChunk(i / imageCount, i % imageCount);
+		}
+	});
+
+	// as does every image's primary
+	jobSystem.parallelFor(imageCount, 1, [this](uint32_t start, uint32_t end) {
+		for (uint32_t i = start; i < end; i++)
+		{
+			recordCommandBuffer(i);
+		}
+	});
+
+	// compute command buffers share a pool, and never change after this
+	for (uint32_t i = 0; i < computeCommandBuffers.size(); i++)
 	{
-		throw std::runtime_error("Failed to create command pool!");
+		recordComputeCommandBuffer(i);
 	}
 }
 
-void VulkanRenderer::createCommandBuffers()
+void VulkanRenderer::recordCommandBuffer(uint32_t imageIndex)
 {
-	commandBuffers.resize(swapchainFramebuffers.size());
-	
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-	commandBufferAllocateInfo.commandPool = graphicsCommandPool;
-	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	PROFILE_FUNCTION();
 
-	VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, commandBuffers.data());
-	if (result != VK_SUCCESS)
+	recordedExtents[imageIndex] = renderExtent;
+	recordedCullingVersions[imageIndex] = cullingVersion;
+
+	// with async compute the scene is split before the particle draw pass, and the second part waits for the simulation
+	if (asyncCompute)
+	{
+		recordFramePart(commandBuffers[imageIndex], imageIndex, 0, computeWaitPass, 0);
+		recordFramePart(particleDrawCommandBuffers[imageIndex], imageIndex, computeWaitPass, upscalePass, 2);
+	}
+	else
 	{
-		throw std::runtime_error("Failed to allocate command buffers!");
+		recordFramePart(commandBuffers[imageIndex], imageIndex, 0, upscalePass, 0);
 	}
+	recordFramePart(presentCommandBuffers[imageIndex], imageIndex, upscalePass, UINT32_MAX, UINT32_MAX);
 }
 
-void VulkanRenderer::createSynchronisation()
+void VulkanRenderer::recordFramePart(VkCommandBuffer commandBuffer, uint32_t imageIndex, RenderGraphPass firstPass,
+	RenderGraphPass endPass, uint32_t timestamp)
 {
-	imageAvailable.resize(MAX_FRAME_DRAWS);
-	renderComplete.resize(MAX_FRAME_DRAWS);
-	drawFences.resize(MAX_FRAME_DRAWS);
-	
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	if (result != VK_SUCCESS)
 	{
-		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderComplete[i]) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create semaphore!");
-		}
+		throw std::runtime_error("Failed to start recording to command buffer!");
+	}
 
-		if (vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]) != VK_SUCCESS)
+	// the first part resets all of the image's queries. The start waits for everything submitted before it, including the
+	// simulation this part's submission waits for
+	bool timed = timestampQueryPool != VK_NULL_HANDLE && timestamp != UINT32_MAX;
+	if (timed)
+	{
+		if (timestamp == 0)
 		{
-			throw std::runtime_error("Failed to create fence!");
+			vkCmdResetQueryPool(commandBuffer, timestampQueryPool, imageIndex * TIMESTAMPS_PER_IMAGE, TIMESTAMPS_PER_IMAGE);
 		}
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timestampQueryPool,
+			imageIndex * TIMESTAMPS_PER_IMAGE + timestamp);
+	}
+
+	renderGraph.execute(commandBuffer, imageIndex, renderExtent, firstPass, endPass);
+
+	if (timed)
+	{
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timestampQueryPool,
+			imageIndex * TIMESTAMPS_PER_IMAGE + timestamp + 1);
+	}
+
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end recording to command buffer!");
 	}
 }
 
-void VulkanRenderer::createUniformBuffers()
+void VulkanRenderer::recordComputeCommandBuffer(uint32_t imageIndex)
 {
-	VkDeviceSize bufferSize = sizeof(MVP);
+	PROFILE_FUNCTION();
 
-	uniformBuffer.resize(swapchainImages.size());
-	uniformBufferMemory.resize(swapchainImages.size());
+	VkCommandBuffer commandBuffer = computeCommandBuffers[imageIndex];
 
-	for (size_t i = 0; i < swapchainImages.size(); i++)
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	if (result != VK_SUCCESS)
 	{
-		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer[i], &uniformBufferMemory[i]);
+		throw std::runtime_error("Failed to start recording to compute command buffer!");
+	}
+
+	if (computeTimestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, computeTimestampQueryPool, imageIndex * 2, 2);
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_NONE, computeTimestampQueryPool, imageIndex * 2);
+	}
+
+	computeGraph.execute(commandBuffer, imageIndex);
+
+	if (computeTimestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, computeTimestampQueryPool, imageIndex * 2 + 1);
+	}
+
+	result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end recording to compute command buffer!");
 	}
 }
 
-void VulkanRenderer::recordCommands()
+void VulkanRenderer::recordCulling(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool latePass)
+{
+	uint32_t objectCount = static_cast<uint32_t>(objects.size());
+	CullPushConstants pushConstants = {};
+	pushConstants.objectCount = objectCount;
+	pushConstants.meshCount = meshCapacity;
+	pushConstants.latePass = latePass ? 1 : 0;
+	pushConstants.pyramidLevels = depthPyramidLevels;
+	pushConstants.pyramidSize = glm::vec2(static_cast<float>(depthPyramidWidth), static_cast<float>(depthPyramidHeight));
+	pushConstants.mvpBuffer = uniformBufferIndex[imageIndex];
+	pushConstants.objectBuffer = objectBufferIndex[imageIndex];
+	pushConstants.meshDrawBuffer = meshDrawBufferIndex;
+	pushConstants.drawBuffer = indirectDrawBufferIndex;
+	pushConstants.drawCountBuffer = drawCountBufferIndex;
+	pushConstants.visibilityBuffer = visibilityBufferIndex;
+	pushConstants.depthPyramid = depthPyramidSampledIndex;
+	pushConstants.meshletBuffer = meshletBufferIndex;
+	pushConstants.drawCapacity = drawCapacity;
+
+	VkDescriptorSet bindlessSet = bindlessDescriptors.getSet();
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+}
+
+void VulkanRenderer::recordDepthPyramid(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	// the render graph orders this after the early pass and before late culling, but each level is read by the reduction
+	// of the next, so the levels need barriers between them
+	VkImageMemoryBarrier2 imageBarrier = {};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	imageBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = depthPyramidImage;
+	imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.levelCount = 1;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount = 1;
+
+	VkDependencyInfo dependencyInfo = {};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &imageBarrier;
+
+	VkDescriptorSet bindlessSet = bindlessDescriptors.getSet();
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+
+	for (uint32_t i = 0; i < depthPyramidLevels; i++)
+	{
+		DepthReducePushConstants pushConstants = {};
+		pushConstants.outSize = glm::uvec2(std::max(depthPyramidWidth >> i, 1u), std::max(depthPyramidHeight >> i, 1u));
+		// only the rendered part of the depth buffer, so the pyramid always covers the whole view
+		pushConstants.inSize = i == 0 ? glm::uvec2(recordedExtents[imageIndex].width, recordedExtents[imageIndex].height) :
+			glm::uvec2(std::max(depthPyramidWidth >> (i - 1), 1u), std::max(depthPyramidHeight >> (i - 1), 1u));
+		pushConstants.sourceIsDepth = i == 0 ? 1 : 0;
+		pushConstants.sourceImage = i == 0 ? depthBufferSampledIndex : depthPyramidMipSampledIndex[i - 1];
+		pushConstants.destinationImage = depthPyramidMipStorageIndex[i];
+
+		vkCmdPushConstants(commandBuffer, depthReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthReducePushConstants),
+			&pushConstants);
+		vkCmdDispatch(commandBuffer, (pushConstants.outSize.x + 7) / 8, (pushConstants.outSize.y + 7) / 8, 1);
+
+		imageBarrier.subresourceRange.baseMipLevel = i;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+}
+
+void VulkanRenderer::recordDrawChunk(uint32_t chunkIndex, uint32_t imageIndex)
 {
+	PROFILE_FUNCTION();
+
+	DrawChunk& chunk = drawChunks[chunkIndex];
+
+	VkResult result = vkResetCommandPool(mainDevice.logicalDevice, chunk.commandPools[imageIndex], 0);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to reset command pool!");
+	}
+
+	// must match the early and late draw passes' attachments
+	VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo = {};
+	inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	inheritanceRenderingInfo.colorAttachmentCount = 1;
+	inheritanceRenderingInfo.pColorAttachmentFormats = &swapchainFormat;
+	inheritanceRenderingInfo.depthAttachmentFormat = depthFormat;
+	inheritanceRenderingInfo.rasterizationSamples = msaaSamples;
+	inheritanceRenderingInfo.viewMask = getViewMask();
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = &inheritanceRenderingInfo;
+
 	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
 	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-	std::array<VkClearValue, 1> clearValues {
-		//{0.6f, 0.65f, 0.4f, 1.f}
-		{0.1f, 0.3f, 0.4f, 1.f}
-	};
+	// the draw passes render to the top left renderExtent of the attachments
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
 
-	VkRenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = renderPass;
-	renderPassBeginInfo.renderArea.offset = { 0,0 };
-	renderPassBeginInfo.renderArea.extent = swapchainExtent;
-	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderPassBeginInfo.pClearValues = clearValues.data();								// todo: add depth attachment clear values
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
 
-	for (size_t i = 0; i < commandBuffers.size(); i++)
+	for (uint32_t late = 0; late < 2; late++)
 	{
-		renderPassBeginInfo.framebuffer = swapchainFramebuffers[i];
-		
-		VkResult result = vkBeginCommandBuffer(commandBuffers[i], &commandBufferBeginInfo);
+		VkCommandBuffer commandBuffer = chunk.commandBuffers[imageIndex * 2 + late];
+
+		result = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 		if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to start recording to command buffer!");
 		}
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-				VkDeviceSize offsets[] = { 0 };
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			recordMeshDraws(commandBuffer, imageIndex, late == 1, chunk.firstMesh, chunk.meshCount);
 
-				for (const Mesh& mesh : meshes)
-				{
-					VkBuffer vertexBuffers[] = { mesh.getVertexBuffer() };
-					vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-					vkCmdBindIndexBuffer(commandBuffers[i], mesh.getIndexBuffer(), offsets[0], VK_INDEX_TYPE_UINT32);
+		result = vkEndCommandBuffer(commandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to end recording to command buffer!");
+		}
+	}
 
-					vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i],
-						0, nullptr);
+	chunk.recordedVersions[imageIndex] = chunk.version;
+	chunk.recordedExtents[imageIndex] = renderExtent;
+}
 
-					vkCmdDrawIndexed(commandBuffers[i], mesh.getIndexCount(), 1, 0, 0, 0);
-				}
+void VulkanRenderer::recordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool latePass, uint32_t firstMesh,
+	uint32_t meshCount)
+{
+	DrawPushConstants pushConstants = {};
+	pushConstants.mvpBuffer = uniformBufferIndex[imageIndex];
+	pushConstants.objectBuffer = objectBufferIndex[imageIndex];
+	pushConstants.textureTable = textureStreamer.getTableIndex(imageIndex);
+	pushConstants.meshDrawBuffer = meshDrawBufferIndex;
+
+	VkDescriptorSet bindlessSet = bindlessDescriptors.getSet();
+
+	// the set and push constants stay bound across pipeline changes, the layout is shared by every variant
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &bindlessSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &pushConstants);
+
+	VkDeviceSize offsets[] = { 0 };
+	VkDeviceSize drawStride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize drawBase = latePass ? drawCapacity : 0;
+	VkDeviceSize countBase = latePass ? meshCapacity : 0;
+
+	// meshes sharing a variant are adjacent in practice, so the pipeline is only rebound when it changes
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (uint32_t i = firstMesh; i < firstMesh + meshCount; i++)
+	{
+		if (meshDrawCapacity[i] == 0 || !meshVisible[i])
+		{
+			continue;
+		}
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+		VkPipeline pipeline = meshPipelines.find(getMeshVariant(i));
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("Failed to find the graphics pipeline variant of a mesh!");
+		}
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
 
-		result = vkEndCommandBuffer(commandBuffers[i]);
-		if (result != VK_SUCCESS)
+		// pulled meshes are found through the mesh draw data, only their indices are bound
+		if (meshes[i].getVertexLayout() == MeshVertexLayout::Interleaved)
 		{
-			throw std::runtime_error("Failed to end recording to command buffer!");
+			VkBuffer vertexBuffers[] = { meshes[i].getVertexBuffer() };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 		}
+		vkCmdBindIndexBuffer(commandBuffer, meshes[i].getIndexBuffer(), offsets[0], VK_INDEX_TYPE_UINT32);
+
+		// culling decides how many of the mesh's draws (one per visible object, or visible meshlet) are actually executed
+		vkCmdDrawIndexedIndirectCount(commandBuffer, indirectDrawBuffer, (drawBase + meshDraws[i].firstDraw) * drawStride,
+			drawCountBuffer, (countBase + i) * sizeof(uint32_t), meshDrawCapacity[i], static_cast<uint32_t>(drawStride));
 	}
 }
 
@@ -947,6 +3117,8 @@ void VulkanRenderer::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreat
 
 void VulkanRenderer::setupDebugMessenger()
 {
+	PROFILE_FUNCTION();
+
 	if (!enableValidationLayers)
 		return;
 
@@ -1010,20 +3182,40 @@ VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
 	}
 }
 
-VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkFormat VulkanRenderer::chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags) const
+{
+	for (VkFormat format : formats)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(mainDevice.physicalDevice, format, &properties);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & featureFlags) == featureFlags)
+		{
+			return format;
+		}
+		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & featureFlags) == featureFlags)
+		{
+			return format;
+		}
+	}
+	throw std::runtime_error("Failed to find a matching format!");
+}
+
+VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel,
+	uint32_t mipLevels)
 {
 	VkImageViewCreateInfo imageViewCreateInfo = {};
 	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewCreateInfo.image = image;
 	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	imageViewCreateInfo.format = swapchainFormat;
+	imageViewCreateInfo.format = format;
 	imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 	imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags;
-	imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-	imageViewCreateInfo.subresourceRange.levelCount = 1;
+	imageViewCreateInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
 	imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
 	imageViewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -1036,22 +3228,6 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkIm
 	return imageView;
 }
 
-VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
-{
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create shader module!");
-	}
-	return shaderModule;
-}
-
 bool VulkanRenderer::checkInstanceExtensionSupport(const std::vector<const char*>& extensionsToCheck) const
 {
 	// first, get number of extensions so we know what size to set for our vector
@@ -1116,7 +3292,10 @@ bool VulkanRenderer::checkDeviceSuitable(const VkPhysicalDevice& device) const
 	SwapchainDetails swapchainDetails = getSwapchainDetails(device);
 	swapchainValid = !swapchainDetails.surfaceFormats.empty() && !swapchainDetails.presentationModes.empty();
 
-	return indices.isValid() && extensionsSupported && swapchainValid;
+	// features for GPU driven culling, the bindless descriptor set, the render graph and timeline synchronisation
+	bool featuresSupported = queryDeviceCapabilities(device).hasRequiredFeatures();
+
+	return indices.isValid() && extensionsSupported && swapchainValid && featuresSupported;
 }
 
 bool VulkanRenderer::checkValidationLayerSupport() const
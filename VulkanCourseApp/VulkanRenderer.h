@@ -6,10 +6,28 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "BindlessDescriptors.h"
+#include "DeviceCapabilities.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "JobSystem.h"
+#include "ParticleSystem.h"
+#include "PipelineVariants.h"
+#include "RenderGraph.h"
+#include "Scene.h"
+#include "SceneGenerator.h"
+#include "ShaderCache.h"
+#include "TextureStreamer.h"
 #include "Utilities.h"
 #include "DebugUtilsMessenger.h"
 
@@ -20,33 +38,150 @@ public:
 	~VulkanRenderer();
 
 public:
-	int init(GLFWwindow* window);
+	// picks the GPU by UUID or part of its name instead of by score, call before init
+	void setDeviceOverride(const std::string& device) { deviceOverride = device; }
+	// highest supported sample count up to this is used, call before init
+	void setMsaaSamples(uint32_t samples) { requestedMsaaSamples = samples; }
+	// render scale limits and the GPU frame time it aims for, call before init
+	void setDynamicResolution(const DynamicResolutionSettings& settings) { dynamicResolution.init(settings); }
+	// copies every presented frame back to the CPU, call before init
+	void setFrameCapture(FrameCaptureOutput output, const std::string& filePrefix, uint32_t ringSize = 4,
+		std::function<void(const CapturedFrame&)> consumer = nullptr);
+	// replaces the default scene with a generated one, call before init
+	void setSceneGenerator(const SceneGeneratorSettings& settings) { sceneGenerator.init(settings); sceneGenerated = true; }
+	// textures are streamed in after startup and spread over the meshes, call before init
+	void addTexture(const std::string& path) { texturePaths.push_back(path); }
+	void setTextureStreaming(const TextureStreamerSettings& settings) { textureSettings = settings; }
+	// false shades meshes with their texture alone, call before init
+	void setVertexColours(bool enabled) { vertexColours = enabled; }
+	// vertex shader reads packed vertex streams through buffer device addresses instead of vertex buffers, if the device
+	// supports it. Call before init
+	void setVertexPulling(bool enabled) { vertexPulling = enabled; }
+	// meshes are split into meshlets, culled by frustum and normal cone after their object passes. Call before init
+	void setMeshletCulling(bool enabled) { meshletCulling = enabled; }
+	// particles simulate on a dedicated compute queue family, overlapping the frame's graphics work, if the device has one.
+	// Call before init
+	void setAsyncCompute(bool enabled) { asyncCompute = enabled; }
+	// renders count views side by side in the window with one multiview pass, their cameras separation apart along x (a
+	// stereo pair's eyes, for two). Call before init
+	void setViews(uint32_t count, float separation = 0.064f);
 
-	void updateModel(glm::mat4 newModel);
+	int init(GLFWwindow* window);
 
-	void draw();
+	void draw(float deltaTime);
 	void cleanup();
 
+	// hidden meshes aren't drawn, only the draw chunk holding the mesh is re-recorded. Call after init
+	void setMeshVisible(uint32_t meshIndex, bool visible);
+	// records the geometry's upload unless an identical mesh is already loaded, which gains a reference instead. The upload is
+	// submitted with the next frame and nothing waits for it, the mesh is drawn from the first frame after it has finished.
+	// Scene nodes take the handle as their mesh, nodes added since the last frame are picked up by the next one. Call after init
+	MeshHandle addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	// drops a reference. The last one hides the mesh for good and frees its buffers once the frames in flight finish, without
+	// waiting for them. Nodes still using it draw nothing. Call after init
+	void removeMesh(MeshHandle mesh);
+	// model space bounding sphere, for the nodes using the mesh
+	glm::vec4 getMeshBounds(MeshHandle mesh) const { return meshes[mesh].getBoundingSphere(); }
+	const MeshCache& getMeshCache() const { return meshCache; }
+
+	JobSystem& getJobSystem() { return jobSystem; }
+	const DeviceCapabilities& getDeviceCapabilities() const { return deviceCapabilities; }
+	// for anything else released mid-session, e.g. buffers or pipelines the frames in flight may still use
+	DeletionQueue& getDeletionQueue() { return deletionQueue; }
+	Scene& getScene() { return scene; }
+	uint32_t getSceneRoot() const { return sceneRoot; }
+	bool isSceneGenerated() const { return sceneGenerated; }
+
 private:
+	// specialization constants of shader.vert and shader.frag, in constant_id order
+	struct MeshShaderConstants {
+		VkBool32 vertexColour;		// colour from the vertices, otherwise white
+		VkBool32 textured;			// sample the object's texture, otherwise skip the texture table and sampling entirely
+	};
+
+	struct MeshPipelineVariant {
+		MeshShaderConstants constants;
+		VkBool32 vertexPulling;		// picks vert_pulled.spv and no vertex input state
+	};
+
 	void createInstance();
 	void createLogicalDevice();
 	void createSurface();
 	void createSwapchain();
-	void createRenderPass();
-	void createDescriptorSetLayout();
+	void chooseDepthFormat();
+	void chooseMsaaSamples();
+	void createBindlessDescriptors();
 	void createGraphicsPipeline();
-	void createFramebuffers();
+	// creates the mesh's variant the first time it's used. Not while recording, lookups then don't lock
+	VkPipeline getMeshPipeline(uint32_t meshIndex);
+	VkPipeline createMeshPipeline(const MeshPipelineVariant& variant);
+	MeshPipelineVariant getMeshVariant(uint32_t meshIndex) const;
+	uint32_t getMeshTexture(uint32_t meshIndex) const;
+	uint32_t getViewMask() const { return viewCount > 1 ? (1u << viewCount) - 1 : 0; }
+	void createComputePipelines();
 	void createCommandPool();
 	void createCommandBuffers();
 	void createSynchronisation();
+	void prepareMeshData();
+	void createScene();
+	void createObjects();
+	// a culling object for the node, unless its mesh is still uploading (it waits for it) or has been removed
+	void addObject(uint32_t node);
+	void createTimestampQueries();
 
 	void createUniformBuffers();
-	void createDescriptorPool();
-	void createDescriptorSets();
+	void createCullingBuffers();
+	void createDepthPyramid();
+	void createDrawChunks();
+	void createRenderGraph();
+	void registerBindlessResources();
+	void registerCullingBuffers();
+	// the old buffers go through the deletion queue, so frames in flight keep theirs
+	void releaseCullingBuffers();
+	void rebuildCullingBuffers();
+	// picks up uploaded meshes and new scene nodes, patching only what they change, or compacts away removed meshes' objects.
+	// Submits the uploads ahead of the frame
+	void updateCullingBuffers();
+	// copies what the frames so far wrote into a bigger buffer, the old one goes once the copy has run
+	void growCullingBuffer(VkDeviceSize size, VkDeviceSize copySize, VkBufferUsageFlags usage, VkBuffer* buffer,
+		VkDeviceMemory* bufferMemory, uint32_t* bufferIndex);
+	uint32_t allocateDrawRegion(uint32_t count);
+	void freeDrawRegion(uint32_t first, uint32_t count);
+	// its draw data is uploaded, and its chunk re-recorded, by the end of the update
+	void changeMeshDraw(uint32_t meshIndex);
+
+	// overwrite: the copies write buffers the frames in flight may still use, so they wait for them
+	VkCommandBuffer beginUpload(bool overwrite);
+	void uploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+	// submits what was recorded since the last call ahead of the next frame, without waiting, then queues the staging and
+	// replaced buffers for destruction once it has run
+	void submitUploads();
 
 	void updateUniformBuffer(uint32_t imageIndex);
+	void updateObjects(uint32_t imageIndex);
+
+	void sortObjectsByMesh();
+	void updateRenderScale(uint32_t imageIndex);
+	void updateAsyncComputeOverlap(uint32_t imageIndex, uint64_t frameStart, uint64_t frameEnd);
+	void updateCommandBuffer(uint32_t imageIndex);
+
+	// times a startup stage on the calling thread. An exception is kept for init to rethrow, and later stages are skipped
+	void runStartupStage(const char* name, const std::function<void()>& function);
+	void queueStartupStage(const char* name, std::function<void()> function, JobCounter* counter,
+		const JobCounter* dependency = nullptr);
+	void printStartupReport();
 
 	void recordCommands();
+	void recordCommandBuffer(uint32_t imageIndex);
+	// the graph's passes [firstPass, endPass) into one of the image's command buffers, between the pair of timestamps starting
+	// at timestamp unless it's UINT32_MAX
+	void recordFramePart(VkCommandBuffer commandBuffer, uint32_t imageIndex, RenderGraphPass firstPass, RenderGraphPass endPass,
+		uint32_t timestamp);
+	void recordComputeCommandBuffer(uint32_t imageIndex);
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool latePass);
+	void recordDepthPyramid(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordDrawChunk(uint32_t chunkIndex, uint32_t imageIndex);
+	void recordMeshDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool latePass, uint32_t firstMesh, uint32_t meshCount);
 
 	void getPhysicalDevice();
 	SwapchainDetails getSwapchainDetails(const VkPhysicalDevice& device) const;
@@ -58,8 +193,10 @@ private:
 	VkPresentModeKHR chooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentationModes) const;
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) const;
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	VkFormat chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags) const;
+
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0,
+		uint32_t mipLevels = 1);
 
 	bool checkInstanceExtensionSupport(const std::vector<const char*>& extensionsToCheck) const;
 	bool checkDeviceExtensionSupport(const VkPhysicalDevice& device) const;
@@ -71,34 +208,279 @@ private:
 private:
 	std::vector<Mesh> meshes;
 
+	// added meshes find identical geometry here. A removed mesh's objects and draw region stay, unused, until more than half
+	// of the objects are dead and a frame compacts them by rebuilding the objects and culling buffers through the upload batch
+	MeshCache meshCache;
+	uint32_t deadObjectCount = 0;
+	uint32_t objectSceneNodeCount = 0;		// scene nodes whose objects have been created, or are waiting for their mesh
+
+	// Meshes added after init are uploaded by the batch submitted ahead of the next frame. Until the timeline reaches the
+	// batch's value they have no draw data, and objects of their nodes wait in pendingObjectNodes
+	std::vector<uint64_t> meshUploadValues;		// per mesh, 0 once uploaded, ~0 until the batch is submitted
+	std::vector<MeshHandle> pendingMeshes;
+	std::vector<uint32_t> pendingObjectNodes;
+
+	// copies recorded between frames, into new buffers or over ones the frames use, and the buffers to free after them
+	struct RetiredBuffer {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		uint32_t bindlessIndex;
+	};
+	VkCommandBuffer uploadCommandBuffer = VK_NULL_HANDLE;
+	bool uploadOrdered = false;		// the frames in flight have been waited for
+	std::vector<StagingBuffer> uploadStagingBuffers;
+	std::vector<RetiredBuffer> retiredCullingBuffers;
+
+	// mesh data generated on the workers while the device is created, uploaded and released by createScene
+	std::vector<std::vector<Vertex>> meshVertices;
+	std::vector<std::vector<uint32_t>> meshIndices;
+	std::vector<MeshKey> meshKeys;
+	std::vector<std::vector<Meshlet>> meshMeshlets;		// uploaded by createCullingBuffers, kept for rebuilds
+	bool meshletCulling = false;
+
+	Scene scene;
+	uint32_t sceneRoot;
+
+	SceneGenerator sceneGenerator;
+	bool sceneGenerated = false;
+
+	// a camera per view, std430 to match the shaders
 	struct MVP {
-		glm::mat4 projection;
-		glm::mat4 view;
+		glm::mat4 projection[MAX_VIEWS];
+		glm::mat4 view[MAX_VIEWS];
 		glm::mat4 model;
+		uint32_t viewCount;
+		uint32_t padding[3];
 	} mvp;
 
-	VkDescriptorSetLayout descriptorSetLayout;
-	
-	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	// resources are referenced by their index in the bindless descriptor set
+	struct DrawPushConstants {
+		uint32_t mvpBuffer;
+		uint32_t objectBuffer;
+		uint32_t textureTable;
+		uint32_t meshDrawBuffer;
+	};
+
+	struct CullPushConstants {
+		glm::vec2 pyramidSize;
+		uint32_t objectCount;
+		uint32_t meshCount;
+		uint32_t latePass;
+		uint32_t pyramidLevels;
+		uint32_t mvpBuffer;
+		uint32_t objectBuffer;
+		uint32_t meshDrawBuffer;
+		uint32_t drawBuffer;
+		uint32_t drawCountBuffer;
+		uint32_t visibilityBuffer;
+		uint32_t depthPyramid;
+		uint32_t meshletBuffer;
+		uint32_t drawCapacity;		// size of each half of the draw buffer
+	};
+
+	struct DepthReducePushConstants {
+		glm::uvec2 outSize;
+		glm::uvec2 inSize;
+		uint32_t sourceIsDepth;
+		uint32_t sourceImage;
+		uint32_t destinationImage;
+	};
+
+	JobSystem jobSystem;
+	BindlessDescriptors bindlessDescriptors;
+
+	// milliseconds since the process started, recorded by runStartupStage for the report after the first present
+	struct StartupStage {
+		const char* name;
+		double start;
+		double duration;
+		uint32_t thread;
+	};
+	std::vector<StartupStage> startupStages;
+	std::mutex startupMutex;
+	std::exception_ptr startupError;
+	double initStart = 0.0;
+	double initEnd = 0.0;
+	bool startupReported = false;
 	
+	// MVP data per swapchain image, read as a (bindless) storage buffer
 	std::vector<VkBuffer> uniformBuffer;
 	std::vector<VkDeviceMemory> uniformBufferMemory;
+	std::vector<uint32_t> uniformBufferIndex;
+
+	// GPU culling: objects are tested against the frustum and last frame's visibility (early pass), then against the
+	// depth pyramid built from the early pass (late pass). Survivors are compacted into per-mesh indirect draw regions, as
+	// one draw of the whole mesh or, with meshlet culling, one draw per meshlet that passes its own tests
+	std::vector<ObjectData> objects;
+	std::vector<uint32_t> objectNodes;		// scene node each object was created from
+	std::vector<MeshDrawData> meshDraws;
+	std::vector<uint32_t> meshDrawCapacity;		// size of each mesh's draw region, at least its objects times its meshlets
+	std::vector<uint32_t> meshObjectCount;
+	uint32_t drawCapacity = 0;					// of all meshes, the size of each pass's half of the draw buffer
+	std::vector<bool> meshVisible;
+
+	// Objects of new nodes go on the end, and a mesh whose draw region fills up moves to a free one twice the size, so only
+	// its chunk is re-recorded. A buffer that runs out is replaced by one twice the size, which re-records every chunk
+	struct DrawRegion {
+		uint32_t first;
+		uint32_t count;
+	};
+	std::vector<DrawRegion> freeDrawRegions;		// in draw order, neighbours merged
+	uint32_t drawRegionEnd = 0;					// nothing is allocated from here on
+	uint32_t objectCapacity = 0;
+	uint32_t meshCapacity = 0;					// of the mesh draw buffer and each half of the draw count buffer
+	uint32_t meshletEnd = 0;					// meshlets are appended as meshes finish uploading
+	uint32_t meshletCapacity = 0;
+	uint32_t changedMeshDrawStart = ~0u;		// mesh draws to upload
+	uint32_t changedMeshDrawEnd = 0;
+	uint64_t cullingVersion = 1;				// bumped when the culling dispatch the primaries record changes
+
+	// Mesh draws are recorded in chunks of consecutive meshes, into a secondary command buffer per image and pass. A chunk is
+	// only re-recorded when its version or the render extent changes, and the primary just executes the cached buffers
+	struct DrawChunk {
+		uint32_t firstMesh;
+		uint32_t meshCount;
+		uint64_t version;								// bumped whenever the chunk's draws change
+		std::vector<VkCommandPool> commandPools;		// one per image, so chunks can be recorded in parallel
+		std::vector<VkCommandBuffer> commandBuffers;	// early and late pass for each image
+		std::vector<uint64_t> recordedVersions;			// per image, 0 until first recorded
+		std::vector<VkExtent2D> recordedExtents;
+	};
+	std::vector<DrawChunk> drawChunks;
+
+	std::vector<VkBuffer> objectBuffer;
+	std::vector<VkDeviceMemory> objectBufferMemory;
+	std::vector<void*> objectBufferMapped;		// persistently mapped, written in parallel every frame
+	std::vector<uint32_t> objectBufferIndex;
+	uint32_t meshDrawBufferIndex;
+	uint32_t indirectDrawBufferIndex;
+	uint32_t drawCountBufferIndex;
+	uint32_t visibilityBufferIndex;
+	uint32_t meshletBufferIndex = 0;
+	VkBuffer meshDrawBuffer;
+	VkDeviceMemory meshDrawBufferMemory;
+	VkBuffer indirectDrawBuffer;
+	VkDeviceMemory indirectDrawBufferMemory;
+	VkBuffer drawCountBuffer;
+	VkDeviceMemory drawCountBufferMemory;
+	VkBuffer visibilityBuffer;
+	VkDeviceMemory visibilityBufferMemory;
+	VkBuffer meshletBuffer = VK_NULL_HANDLE;		// only with meshlet culling
+	VkDeviceMemory meshletBufferMemory;
+
+	// GPU simulated particles, drawn over the scene
+	ParticleSystem particleSystem;
+
+	// Async compute: the particle simulation is its own graph, submitted to the compute queue. It waits for the previous
+	// frame's graphics (which drew the particles it overwrites), and the graphics frame is split before the particle draw
+	// pass so only the part from there on waits for the simulation. Everything before it overlaps
+	bool asyncCompute = true;
+	VkQueue computeQueue;
+	QueueTimeline computeTimeline;
+	VkCommandPool computeCommandPool;
+	std::vector<VkCommandBuffer> computeCommandBuffers;			// per image, recorded once
+	std::vector<VkCommandBuffer> particleDrawCommandBuffers;	// per image, the graphics passes from computeWaitPass to upscalePass
+	RenderGraph computeGraph;
+	RenderGraphPass computeWaitPass;
+
+	// textures stream in while the scene is already drawing, objects keep their handle as the image behind it refines
+	TextureStreamer textureStreamer;
+	TextureStreamerSettings textureSettings;
+	std::vector<std::string> texturePaths;
+	std::vector<uint32_t> textureHandles;
+
+	// what getMeshVariant builds the mesh pipelines from, along with each mesh's texture
+	bool vertexColours = true;
+	bool vertexPulling = false;
+	std::vector<VkBool32> meshVertexColours;		// per mesh, false if every vertex is white
+
+	// readback of presented frames, only created when requested
+	FrameCapture frameCapture;
+	bool captureRequested = false;
+	FrameCaptureOutput captureOutput;
+	std::string capturePrefix;
+	uint32_t captureRingSize;
+	std::function<void(const CapturedFrame&)> captureConsumer;
+
+	// the frame's passes, their resources and the synchronisation between them
+	RenderGraph renderGraph;
+	// culling buffers imported into the graph, pointed at the new buffers when they're rebuilt
+	RenderGraphResource visibilityResource;
+	RenderGraphResource drawResources[2];		// early and late
+	RenderGraphResource drawCountResources[2];
+
+	VkImageView depthBufferImageView;		// owned by the render graph, single sampled (resolved when using MSAA)
+	VkFormat depthFormat;
+
+	// views render into the layers of the scene's targets at once, with multiview, and are blitted side by side
+	uint32_t viewCount = 1;
+	float viewSeparation = 0.064f;
+
+	// the scene renders into the top left renderExtent of targets sized for the largest scale, then is blitted to the
+	// swapchain. Command buffers remember the extent they were recorded with and are re-recorded when the scale changes
+	DynamicResolution dynamicResolution;
+	VkExtent2D viewExtent;			// each view's slice of the swapchain, what the render extents are scaled from
+	VkExtent2D renderExtent;
+	VkExtent2D maxRenderExtent;
+	std::vector<VkExtent2D> recordedExtents;
+	std::vector<uint64_t> recordedCullingVersions;
+
+	// only the upscale writes the backbuffer, so it goes in a submission of its own which waits for the acquire. The scene
+	// before it renders without waiting for the swapchain
+	RenderGraphPass upscalePass;
+	std::vector<VkCommandBuffer> presentCommandBuffers;		// per image, the passes from upscalePass on
+
+	// start and end of each command buffer that renders the scene, read back the next time the image is drawn. A part's start
+	// waits for the work submitted before it, so the parts add up to the rendering alone, without the waits for the swapchain
+	// or the simulation
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+	float timestampPeriod;				// nanoseconds per tick
+	uint64_t timestampMask;				// only the valid bits of a timestamp are meaningful
+	std::vector<bool> timestampsWritten;
+
+	// start and end of every image's compute command buffer. Compared with the graphics timestamps, which relies on the
+	// queues sharing a clock as they do on desktop GPUs, to report how much of the compute work overlapped graphics
+	VkQueryPool computeTimestampQueryPool = VK_NULL_HANDLE;
+	double computeTime = 0.0;			// milliseconds, summed since the last report
+	double overlapTime = 0.0;
+	uint32_t overlapFrames = 0;
+
+	uint32_t requestedMsaaSamples = 4;
+	VkSampleCountFlagBits msaaSamples;
+	VkResolveModeFlagBits depthResolveMode;
+
+	// hierarchical depth: min/max of the early pass depth, each level half the size of the previous
+	VkImage depthPyramidImage;
+	VkDeviceMemory depthPyramidImageMemory;
+	VkImageView depthPyramidImageView;
+	std::vector<VkImageView> depthPyramidMipViews;
+	VkSampler depthPyramidSampler;
+	uint32_t depthBufferSampledIndex;
+	uint32_t depthPyramidSampledIndex;
+	std::vector<uint32_t> depthPyramidMipSampledIndex;		// reduction source for the next level
+	std::vector<uint32_t> depthPyramidMipStorageIndex;		// reduction destination
+	uint32_t depthPyramidWidth;
+	uint32_t depthPyramidHeight;
+	uint32_t depthPyramidLevels;
 	
 	GLFWwindow* window;
 
 	int currentFrame = 0;
+	uint64_t frameNumber = 0;		// frames submitted so far
 
 	VkInstance instance;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapchain;
 	std::vector<SwapchainImage> swapchainImages;
-	std::vector<VkFramebuffer> swapchainFramebuffers;
 	std::vector<VkCommandBuffer> commandBuffers;
-	VkRenderPass renderPass;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	PipelineVariantCache<MeshPipelineVariant> meshPipelines;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+	VkPipelineLayout depthReducePipelineLayout;
+	VkPipeline depthReducePipeline;
 	VkCommandPool graphicsCommandPool;
+	std::vector<VkCommandPool> recordingCommandPools;		// one per swapchain image, so images can be recorded on different threads
 	VkDebugUtilsMessengerEXT debugMessenger;
 
 	VkFormat swapchainFormat;
@@ -109,10 +491,16 @@ private:
 		VkDevice logicalDevice;
 	} mainDevice;
 
+	std::string deviceOverride;
+	DeviceCapabilities deviceCapabilities;		// of the selected physical device
+
 	VkQueue graphicsQueue;
+	QueueTimeline graphicsTimeline;		// everything submitted to the graphics queue goes through this
+	DeletionQueue deletionQueue;		// waits on the graphics and, with async compute, the compute timeline
 	VkQueue presentationQueue;
 
 	std::vector<VkSemaphore> imageAvailable;
 	std::vector<VkSemaphore> renderComplete;
-	std::vector<VkFence> drawFences;
+	std::vector<uint64_t> frameTimelineValues;		// graphics timeline value of the last submission from each frame slot
+	std::vector<uint64_t> imageTimelineValues;		// and of the last submission using each swapchain image
 };
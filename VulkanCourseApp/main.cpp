@@ -1,11 +1,16 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <stdexcept>
+#include <string>
 
 #include "VulkanRenderer.h"
+#include "Benchmarks.h"
 
 GLFWwindow* window;
 VulkanRenderer vulkanRenderer;
@@ -20,9 +25,345 @@ void initWindow(const std::string& windowName = "Test Window", const int width =
 	window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
 }
 
-int main()
+// empty if the variable isn't set
+std::string getEnvironmentVariable(const char* name)
 {
-	initWindow();
+#ifdef _MSC_VER
+	char* value = nullptr;
+	size_t length = 0;
+	std::string result;
+	if (_dupenv_s(&value, &length, name) == 0 && value != nullptr)
+	{
+		result = value;
+		free(value);
+	}
+	return result;
+#else
+	const char* value = getenv(name);
+	return value != nullptr ? value : "";
+#endif
+}
+
+// optional counts are only taken from the next argument if it's a number, so it can be another option instead
+bool isNumber(const char* text)
+{
+	return isdigit(static_cast<unsigned char>(text[0])) || (text[0] == '.' && isdigit(static_cast<unsigned char>(text[1])));
+}
+
+// the whole of value has to be the number, otherwise it says which option was wrong and returns false
+bool parseNumber(const std::string& option, const std::string& value, uint32_t* result)
+{
+	try
+	{
+		size_t length = 0;
+		unsigned long number = std::stoul(value, &length);
+		if (length == value.size() && value[0] != '-' && number <= std::numeric_limits<uint32_t>::max())
+		{
+			*result = static_cast<uint32_t>(number);
+			return true;
+		}
+	}
+	catch (const std::logic_error&)
+	{
+	}
+	printf("Invalid value for %s: %s\n", option.c_str(), value.c_str());
+	return false;
+}
+
+bool parseNumber(const std::string& option, const std::string& value, int* result)
+{
+	try
+	{
+		size_t length = 0;
+		int number = std::stoi(value, &length);
+		if (length == value.size())
+		{
+			*result = number;
+			return true;
+		}
+	}
+	catch (const std::logic_error&)
+	{
+	}
+	printf("Invalid value for %s: %s\n", option.c_str(), value.c_str());
+	return false;
+}
+
+bool parseNumber(const std::string& option, const std::string& value, float* result)
+{
+	try
+	{
+		size_t length = 0;
+		float number = std::stof(value, &length);
+		if (length == value.size())
+		{
+			*result = number;
+			return true;
+		}
+	}
+	catch (const std::logic_error&)
+	{
+	}
+	printf("Invalid value for %s: %s\n", option.c_str(), value.c_str());
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	int windowWidth = 800;
+	int windowHeight = 600;
+
+	std::string tracePath;
+
+	// any --scene-* option switches to a generated scene
+	SceneGeneratorSettings sceneSettings;
+	bool generateScene = false;
+
+	TextureStreamerSettings textureSettings;
+
+	// GPU to use, by UUID or part of its name. --device takes precedence
+	vulkanRenderer.setDeviceOverride(getEnvironmentVariable("VULKAN_COURSE_APP_DEVICE"));
+
+	for (int i = 1; i < argc; i++)
+	{
+		// --benchmark-jobs [max threads]
+		if (std::string(argv[i]) == "--benchmark-jobs")
+		{
+			uint32_t maxThreads = 0;
+			if (i + 1 < argc && isNumber(argv[i + 1]) && !parseNumber(argv[i], argv[i + 1], &maxThreads))
+			{
+				return EXIT_FAILURE;
+			}
+			runJobSystemBenchmark(maxThreads);
+			return 0;
+		}
+
+		// --benchmark-scene [node count]
+		if (std::string(argv[i]) == "--benchmark-scene")
+		{
+			uint32_t nodeCount = 1000000;
+			if (i + 1 < argc && isNumber(argv[i + 1]) && !parseNumber(argv[i], argv[i + 1], &nodeCount))
+			{
+				return EXIT_FAILURE;
+			}
+			runSceneBenchmark(nodeCount);
+			return 0;
+		}
+
+		// --benchmark-textures [size]
+		if (std::string(argv[i]) == "--benchmark-textures")
+		{
+			uint32_t size = 2048;
+			if (i + 1 < argc && isNumber(argv[i + 1]) && !parseNumber(argv[i], argv[i + 1], &size))
+			{
+				return EXIT_FAILURE;
+			}
+			runTextureCompressionBenchmark(size);
+			return 0;
+		}
+
+		// --device <UUID or part of the device name>
+		if (std::string(argv[i]) == "--device" && i + 1 < argc)
+		{
+			vulkanRenderer.setDeviceOverride(argv[++i]);
+		}
+
+		// --msaa <samples>
+		if (std::string(argv[i]) == "--msaa" && i + 1 < argc)
+		{
+			uint32_t samples;
+			if (!parseNumber(argv[i], argv[i + 1], &samples))
+			{
+				return EXIT_FAILURE;
+			}
+			vulkanRenderer.setMsaaSamples(samples);
+			i++;
+		}
+
+		// --scene-meshes, --scene-triangles, --scene-instances, --scene-seed <count>, --scene-churn <fraction of instances
+		// per frame>, --scene-density <instances per unit cube>
+		std::string option = argv[i];
+		if (option.compare(0, 8, "--scene-") == 0 && i + 1 < argc)
+		{
+			std::string value = argv[++i];
+			bool valid;
+			if (option == "--scene-meshes")
+				valid = parseNumber(option, value, &sceneSettings.meshCount);
+			else if (option == "--scene-triangles")
+				valid = parseNumber(option, value, &sceneSettings.trianglesPerMesh);
+			else if (option == "--scene-instances")
+				valid = parseNumber(option, value, &sceneSettings.instanceCount);
+			else if (option == "--scene-seed")
+				valid = parseNumber(option, value, &sceneSettings.seed);
+			else if (option == "--scene-churn")
+				valid = parseNumber(option, value, &sceneSettings.churn);
+			else if (option == "--scene-density")
+				valid = parseNumber(option, value, &sceneSettings.density);
+			else
+			{
+				printf("Unknown option %s\n", option.c_str());
+				return EXIT_FAILURE;
+			}
+			if (!valid)
+			{
+				return EXIT_FAILURE;
+			}
+			generateScene = true;
+			continue;
+		}
+
+		// --texture <binary PPM or KTX2 path>, can be repeated. Textures are spread over the meshes
+		if (std::string(argv[i]) == "--texture" && i + 1 < argc)
+		{
+			vulkanRenderer.addTexture(argv[++i]);
+		}
+
+		// --texture-budget <MB of full resolution textures>
+		if (std::string(argv[i]) == "--texture-budget" && i + 1 < argc)
+		{
+			uint32_t megabytes;
+			if (!parseNumber(argv[i], argv[i + 1], &megabytes))
+			{
+				return EXIT_FAILURE;
+			}
+			textureSettings.memoryBudget = static_cast<VkDeviceSize>(megabytes) * 1024 * 1024;
+			i++;
+		}
+
+		// --no-texture-compression, RGBA8 KTX2 textures upload uncompressed
+		if (std::string(argv[i]) == "--no-texture-compression")
+		{
+			textureSettings.compress = false;
+		}
+
+		// --no-vertex-colours, meshes are shaded by their texture alone
+		if (std::string(argv[i]) == "--no-vertex-colours")
+		{
+			vulkanRenderer.setVertexColours(false);
+		}
+
+		// --vertex-pulling, vertices are read from storage buffers through buffer device addresses
+		if (std::string(argv[i]) == "--vertex-pulling")
+		{
+			vulkanRenderer.setVertexPulling(true);
+		}
+
+		// --meshlets, meshes are culled and drawn in clusters of up to 64 vertices and 124 triangles
+		if (std::string(argv[i]) == "--meshlets")
+		{
+			vulkanRenderer.setMeshletCulling(true);
+		}
+
+		// --no-async-compute, particles simulate on the graphics queue even when there's a compute queue family
+		if (std::string(argv[i]) == "--no-async-compute")
+		{
+			vulkanRenderer.setAsyncCompute(false);
+		}
+
+		// --views <count> [eye separation], renders side by side views of the scene in one pass with multiview
+		if (std::string(argv[i]) == "--views" && i + 1 < argc)
+		{
+			uint32_t count;
+			if (!parseNumber(argv[i], argv[i + 1], &count))
+			{
+				return EXIT_FAILURE;
+			}
+			i++;
+
+			float separation;
+			if (i + 1 < argc && isNumber(argv[i + 1]))
+			{
+				if (!parseNumber("--views", argv[++i], &separation))
+				{
+					return EXIT_FAILURE;
+				}
+				vulkanRenderer.setViews(count, separation);
+			}
+			else
+			{
+				vulkanRenderer.setViews(count);
+			}
+		}
+
+		// --capture <ppm|raw> <file prefix>
+		if (std::string(argv[i]) == "--capture" && i + 2 < argc)
+		{
+			std::string format = argv[++i];
+			vulkanRenderer.setFrameCapture(format == "raw" ? FrameCaptureOutput::Raw : FrameCaptureOutput::Ppm, argv[++i]);
+		}
+
+		// --window <width> <height>
+		if (std::string(argv[i]) == "--window" && i + 2 < argc)
+		{
+			if (!parseNumber(argv[i], argv[i + 1], &windowWidth) || !parseNumber(argv[i], argv[i + 2], &windowHeight))
+			{
+				return EXIT_FAILURE;
+			}
+			i += 2;
+		}
+
+		// --trace <Chrome trace JSON path>, written on exit. The profiler records nothing without it
+		if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+		{
+			tracePath = argv[++i];
+#ifdef ENABLE_PROFILER
+			Profiler::setEnabled(true);
+#endif
+		}
+
+		// --memory-log <seconds between memory telemetry lines, 0 disables them>
+		if (std::string(argv[i]) == "--memory-log" && i + 1 < argc)
+		{
+			float seconds;
+			if (!parseNumber(argv[i], argv[i + 1], &seconds))
+			{
+				return EXIT_FAILURE;
+			}
+			MemoryTelemetry::get().setLogInterval(seconds);
+			i++;
+		}
+
+		// --resolution-scale <min> <max> <target GPU ms>
+		if (std::string(argv[i]) == "--resolution-scale" && i + 3 < argc)
+		{
+			DynamicResolutionSettings settings;
+			if (!parseNumber(argv[i], argv[i + 1], &settings.minScale) || !parseNumber(argv[i], argv[i + 2], &settings.maxScale) ||
+				!parseNumber(argv[i], argv[i + 3], &settings.targetFrameTime))
+			{
+				return EXIT_FAILURE;
+			}
+			try
+			{
+				vulkanRenderer.setDynamicResolution(settings);
+			}
+			catch (const std::runtime_error& e)
+			{
+				printf("ERROR: %s", e.what());
+				return EXIT_FAILURE;
+			}
+			i += 3;
+		}
+	}
+
+	// named once recording may have been enabled
+	PROFILE_THREAD_NAME("Main");
+
+	if (generateScene)
+	{
+		try
+		{
+			vulkanRenderer.setSceneGenerator(sceneSettings);
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("ERROR: %s", e.what());
+			return EXIT_FAILURE;
+		}
+	}
+
+	vulkanRenderer.setTextureStreaming(textureSettings);
+
+	initWindow("Test Window", windowWidth, windowHeight);
 
 	if (vulkanRenderer.init(window) == EXIT_FAILURE)
 	{
@@ -45,8 +386,13 @@ int main()
 		if (angle > 360.f)
 			angle -= 360.f;
 
-		vulkanRenderer.updateModel(glm::rotate(glm::mat4(1.f), glm::radians(angle), glm::vec3(0.f, 0.f, 1.f)));
-		vulkanRenderer.draw();
+		// generated scenes animate their own instances, so every run of a benchmark does the same work
+		if (!vulkanRenderer.isSceneGenerated())
+		{
+			Scene& scene = vulkanRenderer.getScene();
+			scene.setLocalRotation(vulkanRenderer.getSceneRoot(), glm::angleAxis(glm::radians(angle), glm::vec3(0.f, 0.f, 1.f)));
+		}
+		vulkanRenderer.draw(deltaTime);
 	}
 
 	vulkanRenderer.cleanup();
@@ -54,5 +400,15 @@ int main()
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
+	if (!tracePath.empty())
+	{
+#ifdef ENABLE_PROFILER
+		Profiler::writeChromeTrace(tracePath);
+		Profiler::shutdown();
+#else
+		printf("Not writing %s, the profiler is compiled out (ENABLE_PROFILER isn't defined)\n", tracePath.c_str());
+#endif
+	}
+
 	return 0;
 }
\ No newline at end of file